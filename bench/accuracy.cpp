@@ -0,0 +1,122 @@
+#include "accuracy.hpp"
+
+#include <climits>
+
+// ==================================================
+
+// uniform in [lo, hi), the same on every platform unlike the distributions
+static double uniform(mt19937_64& rng, double lo, double hi)
+{
+	//
+	return lo + (hi - lo) * ((rng() >> 11) / 9007199254740992.0);
+}
+
+// any positive double, subnormals and the largest ones included
+static double positive(mt19937_64& rng)
+{
+	//
+	return mathlib::from_bits((rng() >> 1) % 0x7ff0000000000000ull);
+}
+
+// doubles in the order of their bits, so that neighbours differ by one
+static int64_t ordered(double x)
+{
+	int64_t i = (int64_t)mathlib::bits(x);
+	return i < 0 ? INT64_MIN - i : i;
+}
+
+static double ulp(double got, double want)
+{
+	if(isnan(got) || isnan(want)) return isnan(got) && isnan(want) ? 0 : INFINITY;
+	if(got == want) return 0;
+	return fabs((double)(ordered(got) - ordered(want)));
+}
+
+double accuracy::max_ulp(const Function& f, size_t samples, uint seed)
+{
+	mt19937_64 rng(seed);
+	vector<vector<double>> columns(f.arity, vector<double>(samples));
+	vector<const double*> args;
+	for(auto& c : columns) args.push_back(c.data());
+
+	double row[4];
+	for(size_t i = 0; i < samples; i++)
+	{
+		f.inputs(rng, row);
+		for(uint a = 0; a < f.arity; a++) columns[a][i] = row[a];
+	}
+
+	vector<double> out(samples);
+	f.columns(out.data(), args.data(), samples);
+
+	double worst = 0;
+	for(size_t i = 0; i < samples; i++)
+	{
+		for(uint a = 0; a < f.arity; a++) row[a] = columns[a][i];
+		worst = max(worst, ulp(out[i], f.reference(row)));
+	}
+	return worst;
+}
+
+// ==================================================
+
+#pragma region functions
+#define REFERENCE(name) static double reference_##name(const double* x)
+#define INPUTS(name) static void inputs_##name(mt19937_64& rng, double* x)
+
+// min and max propagate NaN, unlike fmin and fmax
+REFERENCE(sqrt) { return sqrt(x[0]); }
+REFERENCE(exp) { return exp(x[0]); }
+REFERENCE(log) { return log(x[0]); }
+REFERENCE(pow) { return pow(x[0], x[1]); }
+REFERENCE(sin) { return sin(x[0]); }
+REFERENCE(cos) { return cos(x[0]); }
+REFERENCE(abs) { return fabs(x[0]); }
+REFERENCE(min) { return isnan(x[0]) || isnan(x[1]) ? NAN : fmin(x[0], x[1]); }
+REFERENCE(max) { return isnan(x[0]) || isnan(x[1]) ? NAN : fmax(x[0], x[1]); }
+REFERENCE(floor) { return floor(x[0]); }
+REFERENCE(clamp) { return isnan(x[0]) || isnan(x[1]) || isnan(x[2]) ? NAN : fmin(fmax(x[0], x[1]), x[2]); }
+
+INPUTS(sqrt) { x[0] = positive(rng); }
+INPUTS(exp) { x[0] = uniform(rng, -746, 710); }
+INPUTS(log) { x[0] = rng() % 2 ? positive(rng) : uniform(rng, 0.5, 2); }
+INPUTS(abs) { x[0] = mathlib::from_bits(rng()); }
+
+// the results stay finite, a quarter with negative bases and integral exponents
+INPUTS(pow)
+{
+	x[0] = exp(uniform(rng, -8, 8));
+	x[1] = uniform(rng, -700, 700) / fabs(log(x[0]));
+	if(rng() % 4 == 0) { x[0] = -x[0]; x[1] = round(x[1]); }
+}
+
+// half over the whole reduced range, half near zero
+INPUTS(sin) { x[0] = rng() % 2 ? uniform(rng, -MATHLIB_TRIG_LIMIT, MATHLIB_TRIG_LIMIT) : uniform(rng, -10, 10); }
+INPUTS(cos) { inputs_sin(rng, x); }
+
+INPUTS(min) { x[0] = uniform(rng, -1e3, 1e3); x[1] = rng() % 8 ? uniform(rng, -1e3, 1e3) : x[0]; }
+INPUTS(max) { inputs_min(rng, x); }
+INPUTS(floor) { x[0] = rng() % 2 ? uniform(rng, -1e17, 1e17) : uniform(rng, -4, 4); }
+INPUTS(clamp) { x[0] = uniform(rng, -10, 10); x[1] = uniform(rng, -5, 0); x[2] = uniform(rng, 0, 5); }
+
+#undef REFERENCE
+#undef INPUTS
+#pragma endregion
+
+// ==================================================
+
+#define FUNCTION(name, arity, bound) { #name, arity, &mathlib::name, &reference_##name, &inputs_##name, bound }
+vector<accuracy::Function> accuracy::all = {
+	FUNCTION(sqrt, 1, 0),
+	FUNCTION(exp, 1, 1),
+	FUNCTION(log, 1, 1),
+	FUNCTION(pow, 2, 1),
+	FUNCTION(sin, 1, 1),
+	FUNCTION(cos, 1, 1),
+	FUNCTION(abs, 1, 0),
+	FUNCTION(min, 2, 0),
+	FUNCTION(max, 2, 0),
+	FUNCTION(floor, 1, 0),
+	FUNCTION(clamp, 3, 0),
+};
+#undef FUNCTION
@@ -0,0 +1,34 @@
+#ifndef ACCURACY_H
+#define ACCURACY_H
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "mathlib.hpp"
+
+using namespace std;
+
+// The math actions against libm: random inputs for every function over the
+// ranges that matter, and the distance of the results in units in the last
+// place, which must stay within the bounds documented in mathlib.hpp.
+
+namespace accuracy {
+
+	typedef struct
+	{
+		const char* name;
+		uint arity;
+		mathlib::Columns columns;
+		double (*reference)(const double* args); // libm, for one row
+		void (*inputs)(mt19937_64& rng, double* args);
+		double bound; // in ULP
+	} Function;
+
+	extern vector<Function> all;
+
+	// the largest distance from libm over the given number of inputs
+	double max_ulp(const Function& f, size_t samples, uint seed);
+}
+
+#endif
@@ -0,0 +1,462 @@
+#define ARGP_NO_EXIT
+
+#include <argp.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sys/stat.h>
+
+#include "common.hpp"
+#include "tools.hpp"
+
+#include "parser.hpp"
+#include "printer.hpp"
+#include "solver.hpp"
+#include "optimizer.hpp"
+#include "inference.hpp"
+#include "batch.hpp"
+#include "gradient.hpp"
+
+#include "workloads.hpp"
+#include "accuracy.hpp"
+#include "load.hpp"
+
+// ================= arg stuff =======================
+
+// rows of the batch stages, one solve per row
+#define BENCH_BATCH_ROWS 1024
+
+// addresses of the gradient stage
+#define BENCH_GRADIENT_DIRECTIONS 16
+
+// inputs per math function for the accuracy check, and per timed run
+#define BENCH_MATH_SAMPLES (1 << 20)
+#define BENCH_MATH_VALUES (1 << 12)
+
+const char *argp_program_version = APP_NAME "-bench " APP_VERSION;
+static char args_doc[] = "file...";
+static char doc[] = APP_NAME "-bench -- times every stage of the interpreter.\v"
+	"Each stage is run --warmup times untimed and --runs times timed. Results are written "
+	"as one JSON record per workload and stage. With --baseline the medians are compared "
+	"against an earlier result file and the exit status is non-zero on regressions. With --math "
+	"the math actions are checked against libm and timed as the workload \"mathlib\". With --serve "
+	"every workload is also served by a solve process, and --requests single requests to it are timed.";
+
+struct arguments
+{
+	vector<char*> files;
+	char *generate_dir = nullptr;
+	uint scale = 1;
+	uint seed = 1;
+	uint warmup = 3;
+	uint runs = 20;
+	char *out_file = nullptr;
+	char *baseline_file = nullptr;
+	double threshold = 10;
+	bool math = false;
+	char *solve_app = nullptr;
+	uint requests = 10000;
+};
+
+#define ARG_GENERATE 1
+#define ARG_SCALE 2
+#define ARG_SEED 3
+#define ARG_WARMUP 4
+#define ARG_RUNS 5
+#define ARG_OUT 6
+#define ARG_BASELINE 7
+#define ARG_THRESHOLD 8
+#define ARG_MATH 9
+#define ARG_SERVE 10
+#define ARG_REQUESTS 11
+
+static struct argp_option options[] =
+{
+	{"generate",	ARG_GENERATE,	"DIR",	0, "Write the generated workloads to DIR and exit."},
+	{"scale",		ARG_SCALE,		"N",	0, "Size multiplier for generated workloads (default 1)."},
+	{"seed",		ARG_SEED,		"N",	0, "Seed for generated workloads (default 1)."},
+	{"warmup",		ARG_WARMUP,		"N",	0, "Untimed runs per stage (default 3)."},
+	{"runs",		ARG_RUNS,		"N",	0, "Timed runs per stage (default 20)."},
+	{"out",			ARG_OUT,		"FILE",	0, "Write results to FILE instead of stdout."},
+	{"baseline",	ARG_BASELINE,	"FILE",	0, "Compare medians against the results in FILE."},
+	{"threshold",	ARG_THRESHOLD,	"PCT",	0, "Slowdown in percent flagged as regression (default 10)."},
+	{"math",		ARG_MATH,		0,		0, "Also check the math actions against libm and time them."},
+	{"serve",		ARG_SERVE,		"SOLVE",	0, "Also time requests to the solve binary SOLVE running with --serve."},
+	{"requests",	ARG_REQUESTS,	"N",	0, "Timed requests per workload with --serve (default 10000)."},
+
+	{0}
+};
+
+static error_t parse_opt(int key, char *arg, struct argp_state *state)
+{
+	struct arguments *arguments = (struct arguments*)state->input;
+
+	switch (key)
+	{
+	case ARG_GENERATE: arguments->generate_dir = arg; break;
+	case ARG_SCALE: arguments->scale = atoi(arg); break;
+	case ARG_SEED: arguments->seed = atoi(arg); break;
+	case ARG_WARMUP: arguments->warmup = atoi(arg); break;
+	case ARG_RUNS: arguments->runs = max(1, atoi(arg)); break;
+	case ARG_OUT: arguments->out_file = arg; break;
+	case ARG_BASELINE: arguments->baseline_file = arg; break;
+	case ARG_THRESHOLD: arguments->threshold = atof(arg); break;
+	case ARG_MATH: arguments->math = true; break;
+	case ARG_SERVE: arguments->solve_app = arg; break;
+	case ARG_REQUESTS: arguments->requests = max(1, atoi(arg)); break;
+
+	case ARGP_KEY_ARG: arguments->files.push_back(arg); break;
+	case ARGP_KEY_END:
+		if(!arguments->generate_dir && !arguments->math && arguments->files.empty()) argp_usage(state);
+		break;
+	default: return ARGP_ERR_UNKNOWN;
+	}
+	return 0;
+}
+
+static struct argp argp = {options, parse_opt, args_doc, doc};
+
+// ================= measuring =======================
+
+typedef struct
+{
+	string workload;
+	string stage;
+	uint runs;
+	double min, p50, p90, p99, max, mean; // nanoseconds
+} Result;
+
+static uint64_t now()
+{
+	auto t = chrono::steady_clock::now().time_since_epoch();
+	return chrono::duration_cast<chrono::nanoseconds>(t).count();
+}
+
+// nearest-rank percentile of sorted samples
+static double percentile(vector<uint64_t>& sorted, double p)
+{
+	size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+	return sorted[rank ? rank - 1 : 0];
+}
+
+template<typename F>
+static Result measure(string workload, string stage, struct arguments& args, F run)
+{
+	for(uint i = 0; i < args.warmup; i++) run();
+
+	vector<uint64_t> samples;
+	for(uint i = 0; i < args.runs; i++)
+	{
+		uint64_t start = now();
+		run();
+		samples.push_back(now() - start);
+	}
+
+	sort(samples.begin(), samples.end());
+	double sum = 0;
+	for(auto s : samples) sum += s;
+
+	return Result{workload, stage, args.runs,
+		(double)samples.front(), percentile(samples, 50), percentile(samples, 90),
+		percentile(samples, 99), (double)samples.back(), sum / samples.size()};
+}
+
+static Symbol* find_main(Environment& env)
+{
+	for(auto it = env.symbols.rbegin(); it != env.symbols.rend(); it++)
+		if((*it)->target.name == "main" && !(*it)->target.has_params) return *it;
+	return nullptr;
+}
+
+// the latency of requests to a long-lived server, each updating the first numeric binding and solving
+static void bench_serve(string name, string path, Batch& batch, struct arguments& args, vector<Result>& results)
+{
+	load::Server server;
+	if(!server.start(args.solve_app, path)) { ERR("Cannot start \"" << args.solve_app << "\"."); return; }
+
+	vector<string> requests;
+	for(size_t r = 0; r < batch.rows; r++) requests.push_back(batch.addrs.empty() ? "solve\n"
+		: tools::fstr("0x%x -> %.17g\nsolve\n", batch.addrs[0], batch.columns[0][r]));
+
+	struct arguments serve_args = args;
+	serve_args.runs = args.requests;
+	size_t next = 0, failed = 0;
+	string answer;
+
+	Result result = measure(name, "serve", serve_args, [&]()
+	{
+		if(!server.request(requests[next++ % requests.size()], answer) || !answer.compare(0, 5, "error")) failed++;
+	});
+
+	if(failed) { ERR(failed << " requests to \"" << args.solve_app << "\" failed for \"" << path << "\"."); return; }
+	MSG(tools::fstr("Served %-16s p50 %8.0f ns, p99 %8.0f ns per request", name.c_str(), result.p50, result.p99));
+	results.push_back(result);
+}
+
+static void bench_file(string path, struct arguments& args, vector<Result>& results)
+{
+	string name = path.substr(path.find_last_of(PATH_SEPARATOR) + 1);
+	name = name.substr(0, name.find_last_of('.'));
+
+	string text = tools::readf(path);
+	CCP source = text.c_str();
+	string filename = path;
+
+	results.push_back(measure(name, "scan", args, [&]()
+	{
+		Scanner scanner = Scanner(&filename, source);
+		while(scanner.scanToken().type != TOKEN_EOF);
+	}));
+
+	Environment env;
+	results.push_back(measure(name, "parse", args, [&]()
+	{
+		env = {};
+		Parser().parse(path, source, &env);
+	}));
+
+	Symbol* main_symbol = find_main(env);
+	if(!main_symbol) { ERR("No symbol 'main' in \"" << path << "\"."); return; }
+
+	// every run starts from the parsed bodies
+	vector<ExprNode*> parsed, optimized, fast;
+	for(auto s : env.symbols) parsed.push_back(s->body);
+
+	results.push_back(measure(name, "optimize", args, [&]()
+	{
+		for(size_t i = 0; i < parsed.size(); i++) env.symbols[i]->body = parsed[i];
+		Optimizer().optimize(&env, STRATEGY_LAZY);
+	}));
+
+	for(size_t i = 0; i < parsed.size(); i++)
+	{
+		optimized.push_back(env.symbols[i]->body);
+		env.symbols[i]->body = parsed[i];
+	}
+
+	// the same with the rewrites that may change rounding, like Horner form
+	Optimizer fast_optimizer = Optimizer();
+	fast_optimizer.fast_math = true;
+	fast_optimizer.optimize(&env, STRATEGY_LAZY);
+	for(size_t i = 0; i < parsed.size(); i++)
+	{
+		fast.push_back(env.symbols[i]->body);
+		env.symbols[i]->body = parsed[i];
+	}
+
+	results.push_back(measure(name, "print", args, [&]()
+	{
+		Printer().print(main_symbol);
+	}));
+
+	// the bodies share nodes, so the types are inferred again for every set of bodies
+	TypeInference inference = TypeInference();
+	inference.infer(&env);
+	results.push_back(measure(name, "solve", args, [&]()
+	{
+		Solver().solve(&env, main_symbol);
+	}));
+
+	for(size_t i = 0; i < optimized.size(); i++) env.symbols[i]->body = optimized[i];
+	inference.infer(&env);
+	results.push_back(measure(name, "solve-opt", args, [&]()
+	{
+		Solver().solve(&env, main_symbol);
+	}));
+
+	// every numeric binding varies over the rows of a batch
+	Batch batch;
+	batch.rows = BENCH_BATCH_ROWS;
+	for(auto& b : env.bindings) if(b.second.type == BoundValue::NUMBER)
+	{
+		batch.addrs.push_back(b.first);
+		batch.columns.emplace_back();
+		for(size_t r = 0; r < batch.rows; r++) batch.columns.back().push_back(b.second.as.num * (1 + r * 1e-3));
+	}
+
+	results.push_back(measure(name, "batch", args, [&]()
+	{
+		BatchSolver<double>().solve(&env, main_symbol, batch);
+	}));
+
+	results.push_back(measure(name, "batch-f32", args, [&]()
+	{
+		BatchSolver<float>().solve(&env, main_symbol, batch);
+	}));
+
+	// with respect to the first of them at once
+	vector<uint> directions(batch.addrs.begin(), batch.addrs.begin() + min(batch.addrs.size(), (size_t)BENCH_GRADIENT_DIRECTIONS));
+	results.push_back(measure(name, "gradient", args, [&]()
+	{
+		GradientSolver().solve(&env, main_symbol, directions);
+	}));
+
+	for(size_t i = 0; i < fast.size(); i++) env.symbols[i]->body = fast[i];
+	inference.infer(&env);
+	results.push_back(measure(name, "solve-fast", args, [&]()
+	{
+		Solver().solve(&env, main_symbol);
+	}));
+
+	if(args.solve_app) bench_serve(name, path, batch, args, results);
+}
+
+// returns false if a function is less accurate than documented
+static bool bench_math(struct arguments& args, vector<Result>& results)
+{
+	bool accurate = true;
+	MSG("Distance of the math actions from libm:");
+
+	for(auto& f : accuracy::all)
+	{
+		double ulp = accuracy::max_ulp(f, BENCH_MATH_SAMPLES, args.seed);
+		accurate &= ulp <= f.bound;
+		MSG("    " << tools::fstr("%-8s %6g ULP, at most %g", f.name, ulp, f.bound)
+			<< (ulp > f.bound ? COLOR_RED "  TOO INACCURATE" COLOR_NONE : ""));
+
+		// the columns at once against libm one row at a time
+		mt19937_64 rng(args.seed);
+		vector<vector<double>> columns(f.arity, vector<double>(BENCH_MATH_VALUES));
+		vector<const double*> in;
+		for(auto& c : columns) in.push_back(c.data());
+		vector<double> out(BENCH_MATH_VALUES);
+
+		double row[4];
+		for(size_t i = 0; i < BENCH_MATH_VALUES; i++)
+		{
+			f.inputs(rng, row);
+			for(uint a = 0; a < f.arity; a++) columns[a][i] = row[a];
+		}
+
+		results.push_back(measure("mathlib", f.name, args, [&]()
+		{
+			f.columns(out.data(), in.data(), BENCH_MATH_VALUES);
+		}));
+
+		results.push_back(measure("mathlib", string(f.name) + "-libm", args, [&]()
+		{
+			for(size_t i = 0; i < BENCH_MATH_VALUES; i++)
+			{
+				for(uint a = 0; a < f.arity; a++) row[a] = columns[a][i];
+				out[i] = f.reference(row);
+			}
+		}));
+	}
+
+	return accurate;
+}
+
+// ================= reporting =======================
+
+#define RESULT_FORMAT "{\"workload\":\"%s\",\"stage\":\"%s\",\"runs\":%u,\"min_ns\":%.0f,\"p50_ns\":%.0f," \
+	"\"p90_ns\":%.0f,\"p99_ns\":%.0f,\"max_ns\":%.0f,\"mean_ns\":%.0f}"
+
+static void write_results(vector<Result>& results, ostream& out)
+{
+	out << "[\n";
+	for(auto& r : results)
+	{
+		out << tools::fstr(RESULT_FORMAT, r.workload.c_str(), r.stage.c_str(), r.runs,
+			r.min, r.p50, r.p90, r.p99, r.max, r.mean);
+		out << (&r != &results.back() ? ",\n" : "\n");
+	}
+	out << "]" << endl;
+}
+
+// reads back a file written by write_results()
+static vector<Result> read_results(string path)
+{
+	vector<Result> results;
+	for(auto line : tools::split_string(tools::readf(path), "\n"))
+	{
+		char workload[256], stage[64];
+		Result r;
+		if(sscanf(line.c_str(), "{\"workload\":\"%255[^\"]\",\"stage\":\"%63[^\"]\",\"runs\":%u,\"min_ns\":%lf,"
+			"\"p50_ns\":%lf,\"p90_ns\":%lf,\"p99_ns\":%lf,\"max_ns\":%lf,\"mean_ns\":%lf",
+			workload, stage, &r.runs, &r.min, &r.p50, &r.p90, &r.p99, &r.max, &r.mean) != 9) continue;
+
+		r.workload = workload;
+		r.stage = stage;
+		results.push_back(r);
+	}
+	return results;
+}
+
+// returns the number of regressions
+static int compare_results(vector<Result>& results, vector<Result>& baseline, double threshold)
+{
+	int regressions = 0;
+	MSG("Comparison of medians against baseline:");
+
+	for(auto& r : results)
+	{
+		Result* base = nullptr;
+		for(auto& b : baseline) if(b.workload == r.workload && b.stage == r.stage) { base = &b; break; }
+
+		string what = tools::fstr("%-16s %-10s", r.workload.c_str(), r.stage.c_str());
+		if(!base) { MSG("    " << what << "  (not in baseline)"); continue; }
+
+		double change = (r.p50 - base->p50) / base->p50 * 100;
+		bool regressed = change > threshold;
+		regressions += regressed;
+
+		MSG("    " << what << tools::fstr("  %12.0f ns -> %12.0f ns  %+7.1f%%", base->p50, r.p50, change)
+			<< (regressed ? COLOR_RED "  REGRESSION" COLOR_NONE : ""));
+	}
+
+	return regressions;
+}
+
+// ================================
+
+int main(int argc, char **argv)
+{
+	struct arguments args;
+	if(argp_parse(&argp, argc, argv, 0, 0, &args)) ABORT(STATUS_CLI_ERROR);
+
+	// generate workloads
+	if(args.generate_dir)
+	{
+		mkdir(args.generate_dir, 0755);
+		for(auto& w : workloads::all)
+		{
+			string path = string(args.generate_dir) + PATH_SEPARATOR + w.name + ".slv";
+			tools::writef(path, w.generator(args.scale, args.seed));
+			MSG("Generated " << w.description << " in \"" << path << "\".");
+		}
+		return STATUS_SUCCESS;
+	}
+
+	vector<Result> results;
+	for(auto file : args.files) bench_file(file, args, results);
+
+	bool accurate = !args.math || bench_math(args, results);
+
+	if(args.out_file)
+	{
+		ofstream out(args.out_file);
+		write_results(results, out);
+		MSG("Results written to \"" << args.out_file << "\".");
+	}
+	else write_results(results, cout);
+
+	if(!accurate)
+	{
+		ERR("The math actions are less accurate than documented.");
+		return EXIT_FAILURE;
+	}
+
+	if(args.baseline_file)
+	{
+		vector<Result> baseline = read_results(args.baseline_file);
+		int regressions = compare_results(results, baseline, args.threshold);
+		if(regressions)
+		{
+			ERR(regressions << " stage" << (regressions == 1 ? "" : "s") << " regressed by more than "
+				<< args.threshold << "%.");
+			return EXIT_FAILURE;
+		}
+	}
+
+	return STATUS_SUCCESS;
+}
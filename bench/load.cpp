@@ -0,0 +1,71 @@
+#include "load.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <unistd.h>
+#include <sys/wait.h>
+
+namespace load {
+
+	bool Server::start(string solve, string file)
+	{
+		int requests[2], answers[2];
+		if(pipe(requests)) return false;
+		if(pipe(answers)) { close(requests[0]); close(requests[1]); return false; }
+
+		// a server that exits early must not kill the generator
+		signal(SIGPIPE, SIG_IGN);
+
+		_pid = fork();
+		if(_pid == 0)
+		{
+			dup2(requests[0], STDIN_FILENO);
+			dup2(answers[1], STDOUT_FILENO);
+			close(requests[0]); close(requests[1]);
+			close(answers[0]); close(answers[1]);
+
+			execl(solve.c_str(), solve.c_str(), "--serve", file.c_str(), (char*)nullptr);
+			_exit(127);
+		}
+
+		close(requests[0]);
+		close(answers[1]);
+		_requests = requests[1];
+		_answers = answers[0];
+		return _pid > 0;
+	}
+
+	bool Server::request(const string& lines, string& answer)
+	{
+		for(size_t sent = 0; sent < lines.size();)
+		{
+			ssize_t n = write(_requests, lines.data() + sent, lines.size() - sent);
+			if(n < 0 && errno == EINTR) continue;
+			if(n <= 0) return false;
+			sent += n;
+		}
+
+		size_t newline;
+		while((newline = _buffer.find('\n')) == string::npos)
+		{
+			char data[4096];
+			ssize_t n = read(_answers, data, sizeof(data));
+			if(n < 0 && errno == EINTR) continue;
+			if(n <= 0) return false;
+			_buffer.append(data, n);
+		}
+
+		answer = _buffer.substr(0, newline);
+		_buffer.erase(0, newline + 1);
+		return true;
+	}
+
+	Server::~Server()
+	{
+		// the end of its input ends the server
+		if(_requests >= 0) close(_requests);
+		if(_answers >= 0) close(_answers);
+		if(_pid > 0) waitpid(_pid, nullptr, 0);
+	}
+}
@@ -0,0 +1,37 @@
+#ifndef LOAD_H
+#define LOAD_H
+
+#include <string>
+#include <sys/types.h>
+
+using namespace std;
+
+// A load generator for the request mode: a solve process started with
+// --serve, which is sent requests over a pipe and answers over another one.
+// Requests are sent one at a time, each waiting for its answer, so that the
+// time of a request is its latency through the process.
+
+namespace load {
+
+	class Server
+	{
+	public:
+
+		~Server();
+
+		// runs "solve --serve file", false if it cannot be started
+		bool start(string solve, string file);
+
+		// sends lines of requests, the last one a solve, and returns its answer without the newline
+		bool request(const string& lines, string& answer);
+
+	private:
+
+		pid_t _pid = -1;
+		int _requests = -1; // stdin of the process
+		int _answers = -1; // and its stdout
+		string _buffer;
+	};
+}
+
+#endif
@@ -0,0 +1,241 @@
+#include "workloads.hpp"
+#include "tools.hpp"
+
+#include <random>
+#include <sstream>
+
+// ==================================================
+
+// mt19937 output is fixed by the standard, the distributions are not
+#define RAND(n) (rng() % (n))
+#define RAND_NUM() tools::fstr("%u.%u", (uint)RAND(100), (uint)RAND(100))
+#define RAND_OP() (ops[RAND(4)])
+
+static const char* ops[] = {" + ", " - ", " * ", " / "};
+
+#pragma region generators
+#define GENERATOR(name) static string gen_##name(uint scale, uint seed)
+
+GENERATOR(deep_nesting) // one expression nested in parentheses
+{
+	mt19937 rng(seed);
+	uint depth = 400 * scale;
+
+	stringstream prefix, suffix;
+	for(uint i = 0; i < depth; i++)
+	{
+		prefix << "(" << RAND_NUM() << (i % 2 ? " + " : " * ");
+		suffix << ")";
+	}
+
+	return "main = " + prefix.str() + "1" + suffix.str() + "\n";
+}
+
+GENERATOR(operator_chain) // long flat chains of binary operators
+{
+	mt19937 rng(seed);
+	uint terms = 4000 * scale;
+
+	stringstream out;
+	out << "c = 1.5\n\nmain = 1";
+	for(uint i = 0; i < terms; i++)
+	{
+		out << RAND_OP() << (RAND(4) ? RAND_NUM() : "c");
+		if(i % 16 == 15) out << "\n\t";
+	}
+	out << "\n";
+	return out.str();
+}
+
+GENERATOR(symbol_versions) // many redefinitions of the same symbols
+{
+	mt19937 rng(seed);
+	uint versions = 2000 * scale;
+
+	stringstream out;
+	out << "x = 1\ny = 2\n";
+	for(uint i = 0; i < versions; i++)
+	{
+		if(RAND(2)) out << "x = x * 0.5 + y.0 - " << RAND_NUM() << "\n";
+		else out << "y = y + x.0 * " << RAND_NUM() << "\n";
+	}
+	out << "\nmain = x + y\n";
+	return out.str();
+}
+
+GENERATOR(param_calls) // nested calls to helpers using their parameters repeatedly
+{
+	mt19937 rng(seed);
+	uint helpers = 20;
+	uint trees = 8 * scale;
+	uint depth = 5;
+
+	stringstream out;
+	for(uint i = 0; i < helpers; i++)
+		out << tools::fstr("h%u(a, b, c) = a * b - c + a / (b + %s)\n", i, RAND_NUM().c_str());
+
+	// build complete call trees bottom up
+	out << "\nmain = 0";
+	for(uint t = 0; t < trees; t++)
+	{
+		vector<string> level;
+		for(uint i = 0; i < 1u << depth; i++) level.push_back(RAND_NUM());
+
+		for(uint d = 0; d < depth; d++)
+		{
+			vector<string> next;
+			for(uint i = 0; i + 1 < level.size(); i += 2)
+				next.push_back(tools::fstr("h%u(%s, %s, %s)", (uint)RAND(helpers),
+					level[i].c_str(), level[i + 1].c_str(), RAND_NUM().c_str()));
+			level = next;
+		}
+		out << "\n\t+ " << level[0];
+	}
+	out << "\n";
+	return out.str();
+}
+
+GENERATOR(bindings) // huge binding tables
+{
+	mt19937 rng(seed);
+	uint count = 20000 * scale;
+
+	stringstream out;
+	for(uint i = 0; i < count; i++)
+	{
+		if(i % 10 == 9) out << tools::fstr("0x%x -> \"value %u\"\n", i, i);
+		else out << tools::fstr("0x%x -> %s\n", i, RAND_NUM().c_str());
+	}
+
+	out << "\nmain = 0";
+	for(uint i = 0; i < 500; i++)
+	{
+		uint addr = RAND(count);
+		if(addr % 10 == 9) addr--;
+		out << tools::fstr(" + @get[0x%x]", addr);
+	}
+	out << "\n";
+	return out.str();
+}
+
+GENERATOR(wide) // many long single-line definitions
+{
+	mt19937 rng(seed);
+	uint symbols = 500 * scale;
+	uint width = 200;
+
+	stringstream out;
+	for(uint i = 0; i < symbols; i++)
+	{
+		out << "w" << i << " = " << RAND_NUM();
+		for(uint j = 0; j < width; j++) out << RAND_OP() << RAND_NUM();
+		out << "\n";
+	}
+
+	out << "main = 0";
+	for(uint i = 0; i < symbols; i++) out << " + w" << i;
+	out << "\n";
+	return out.str();
+}
+
+GENERATOR(polynomials) // polynomials written out as products of their variable
+{
+	mt19937 rng(seed);
+	uint polys = 20;
+	uint degree = 8;
+	uint calls = 200 * scale;
+
+	stringstream out;
+	out << "0x0 -> 0.75\n\n";
+	for(uint i = 0; i < polys; i++)
+	{
+		out << "p" << i << "(x) = " << RAND_NUM();
+		for(uint d = 1; d <= degree; d++)
+		{
+			out << (RAND(2) ? " + " : " - ") << RAND_NUM();
+			for(uint k = 0; k < d; k++) out << " * x";
+		}
+		out << "\n";
+	}
+
+	// the bound value keeps the calls from being folded
+	out << "\nmain = 0";
+	for(uint i = 0; i < calls; i++)
+	{
+		out << tools::fstr(" + p%u(@get[0] * %s)", (uint)RAND(polys), RAND_NUM().c_str());
+		if(i % 8 == 7) out << "\n\t";
+	}
+	out << "\n";
+	return out.str();
+}
+
+GENERATOR(roots) // roots of cubics that depend on a bound value
+{
+	mt19937 rng(seed);
+	uint functions = 20;
+	uint searches = 50 * scale;
+
+	// negative at 0 and positive at 10, so that every root is bracketed
+	stringstream out;
+	out << "0x0 -> 0.75\n\n";
+	for(uint i = 0; i < functions; i++)
+		out << tools::fstr("r%u(x) = x * x * x + %s * x - @get[0] * %u.5\n", i, RAND_NUM().c_str(), (uint)RAND(99));
+
+	out << "\nmain = 0";
+	for(uint i = 0; i < searches; i++)
+	{
+		out << tools::fstr(" + @root[r%u, 0, 10]", (uint)RAND(functions));
+		if(i % 8 == 7) out << "\n\t";
+	}
+	out << "\n";
+	return out.str();
+}
+
+GENERATOR(math) // the math actions on a bound value
+{
+	mt19937 rng(seed);
+	uint functions = 20;
+	uint calls = 200 * scale;
+
+	stringstream out;
+	out << "0x0 -> 0.75\n\n";
+	for(uint i = 0; i < functions; i++)
+		out << tools::fstr("m%u(x) = @sqrt[x * %s] + @exp[x - 1.5] * @sin[x * %s] - @log[x + %s]"
+			" + @pow[x, 1.%u] + @clamp[@cos[x], -0.5, 0.5]\n", i, RAND_NUM().c_str(), RAND_NUM().c_str(),
+			RAND_NUM().c_str(), (uint)RAND(100));
+
+	out << "\nmain = 0";
+	for(uint i = 0; i < calls; i++)
+	{
+		out << tools::fstr(" + m%u(@get[0] * 0.%02u)", (uint)RAND(functions), (uint)RAND(100));
+		if(i % 8 == 7) out << "\n\t";
+	}
+	out << "\n";
+	return out.str();
+}
+
+#undef GENERATOR
+#pragma endregion
+
+// ==================================================
+
+#define WORKLOAD(name, description) { #name, description, &gen_##name }
+vector<workloads::Workload> workloads::all = {
+	WORKLOAD(deep_nesting, "deeply parenthesized expression"),
+	WORKLOAD(operator_chain, "long chains of binary operators"),
+	WORKLOAD(symbol_versions, "many versions of the same symbols"),
+	WORKLOAD(param_calls, "nested calls reusing their parameters"),
+	WORKLOAD(bindings, "huge binding table"),
+	WORKLOAD(wide, "many very long lines"),
+	WORKLOAD(polynomials, "polynomials as naive products"),
+	WORKLOAD(roots, "root searches through bound cubics"),
+	WORKLOAD(math, "math actions on a bound value"),
+};
+#undef WORKLOAD
+
+workloads::Workload* workloads::get(string name)
+{
+	for(auto it = all.begin(); it != all.end(); it++)
+		if(it->name == name) return &(*it);
+	return nullptr;
+}
@@ -0,0 +1,28 @@
+#ifndef WORKLOADS_H
+#define WORKLOADS_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Deterministic generators for benchmark programs. The same kind, scale
+// and seed always produce the same source text on every platform.
+
+namespace workloads {
+
+	typedef string (*Generator)(uint scale, uint seed);
+
+	typedef struct
+	{
+		const char* name;
+		const char* description;
+		Generator generator;
+	} Workload;
+
+	extern vector<Workload> all;
+
+	Workload* get(string name);
+}
+
+#endif
@@ -5,25 +5,54 @@
 #include "scanner.hpp"
 #include "pch"
 
+// Actions take one row of arguments, or optionally n rows at once as one span
+// of values per argument, writing a span of n results. Evaluators that solve
+// many rows call the span handler wherever there is one and the handler once
+// per row otherwise. Span handlers must not be integral, and are only called
+// for pure actions in an order that matches the rows.
+typedef void (*SpanHandler)(Token*, struct _Environment*, const double* const* args, double* out, size_t n);
+
 typedef struct _Action
 {
 	string name;
 	uint arity;
+	bool pure; // no side effects, may be cached
+	bool integral; // always returns a 32-bit integer
+	bool numeric; // depends on its arguments only, constant ones are folded
 	double (*handler)(Token*, struct _Environment*, double*);
+	SpanHandler span = nullptr; // optional, the handler for n rows at once
+	void (*partials)(const double* args, double value, double* out) = nullptr; // optional, the derivative by every argument
+	bool random = false; // draws from the sample of the environment, batches pass columns of samples and paths after the arguments
 } Action;
 
+typedef struct
+{
+	double* data; // contiguous, for the reductions to run over
+	size_t size;
+} BoundArray;
+
+// consecutive addresses from base on, bound to the values of a mapped bind file
+typedef struct
+{
+	uint base;
+	size_t count;
+	const double* values;
+} BoundBlock;
+
 typedef struct _BoundValue
 {
 	union _as
 	{
 		double num;
 		char* str;
+		BoundArray arr;
 	} as;
 
 	enum _type
 	{
 		NUMBER,
 		STRING,
+		ARRAY,
 	} type;
 
 	string to_string(bool debug);
@@ -33,4 +62,13 @@ extern vector<Action> actions;
 
 Action* get_action(string name);
 
+// whether a value is bound to an address, by the program, a bind file or, if asked, the resolver
+bool is_bound(struct _Environment* env, uint addr, bool resolve = true);
+
+// the array bound to an address, aborts with a runtime error at tok if there is none
+BoundArray get_bound_array(Token* tok, struct _Environment* env, double addr);
+
+// adds the actions of a plugin to the table, which must happen before parsing; false on errors
+bool load_plugin(string path);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef ALLOCSTATS_H
+#define ALLOCSTATS_H
+
+#include "common.hpp"
+#include "pch"
+
+#include <cstdint>
+
+using namespace std;
+
+// Heap allocation accounting. The global operator new/delete and the
+// malloc family are replaced by counting wrappers (glibc only); counts are
+// kept per thread and only while enabled.
+
+namespace allocstats {
+
+	typedef struct
+	{
+		uint64_t allocations;
+		uint64_t bytes;
+	} Counts;
+
+	extern bool enabled;
+
+	void enable();
+	Counts counts();
+	void add(const char* phase, Counts& start, Counts& end);
+	void report();
+
+	// accumulates the allocations from construction to destruction
+	class Scope
+	{
+	public:
+		Scope(const char* phase): _phase(phase)
+			{ if(enabled) _start = counts(); }
+		~Scope()
+			{ if(enabled) { Counts end = counts(); add(_phase, _start, end); } }
+
+	private:
+		const char* _phase;
+		Counts _start;
+	};
+}
+
+#define __ALLOC_CAT(a, b) a##b
+#define __ALLOC_NAME(line) __ALLOC_CAT(_alloc_scope_, line)
+#define ALLOC_SCOPE(phase) allocstats::Scope __ALLOC_NAME(__LINE__)(phase)
+
+#endif
@@ -12,28 +12,45 @@
 // forward declarate nodes
 class AssignNode;
 class BinaryNode;
+class LogicalNode;
 class UnaryNode;
 class GroupingNode;
+class ConditionalNode;
+class PolynomialNode;
 class NumberNode;
 class VariableNode;
 class CallNode;
 class ActionNode;
+class RootNode;
+class MapNode;
 
 // visitor class
 class Visitor
 {
 public:
+	virtual ~Visitor() {}
 	#define VISIT(_node) virtual void visit(_node* node) = 0
 	#include "visits.def"
 	#undef VISIT
 };
 
+// total number of nodes ever allocated (traced)
+extern size_t ast_node_count;
+
+// numeric type of the value of a node, as proven by the type inference
+typedef enum
+{
+	TYPE_FLOAT,	// any double
+	TYPE_INT,	// an integer that fits in 64 bits
+} NumType;
+
 // astnode class (visited by visitor)
 class ExprNode
 {
 	public:
-	ExprNode(Token token): _token(token) {}
+	ExprNode(Token token): _token(token) { ast_node_count++; }
 	Token _token;
+	NumType _type = TYPE_FLOAT;
 	virtual void accept(Visitor* v) = 0;
 };
 
@@ -67,6 +84,20 @@ class BinaryNode: public ExprNode
 	ExprNode* _right;
 };
 
+// short-circuiting 'and' and 'or', the right operand is only evaluated if needed
+class LogicalNode: public ExprNode
+{
+	public:
+
+	LogicalNode(Token token, TokenType optype, ExprNode* left, ExprNode* right):
+		ExprNode(token), _optype(optype), _left(left), _right(right) {}
+	ACCEPT
+
+	TokenType _optype;
+	ExprNode* _left;
+	ExprNode* _right;
+};
+
 class UnaryNode: public ExprNode
 {
 	public:
@@ -90,6 +121,34 @@ class GroupingNode: public ExprNode
 	ExprNode* _expr;
 };
 
+// @if[cond, then, else], only the taken branch is evaluated
+class ConditionalNode: public ExprNode
+{
+	public:
+
+	ConditionalNode(Token token, ExprNode* cond, ExprNode* then, ExprNode* otherwise):
+		ExprNode(token), _cond(cond), _then(then), _else(otherwise) {}
+	ACCEPT
+
+	ExprNode* _cond;
+	ExprNode* _then;
+	ExprNode* _else;
+};
+
+// coefs[0] + coefs[1] * x + ... + coefs[n] * x^n, built by the optimizer
+// and evaluated in Horner form, with x evaluated only once
+class PolynomialNode: public ExprNode
+{
+	public:
+
+	PolynomialNode(Token token, ExprNode* var, vector<double> coefs):
+		ExprNode(token), _var(var), _coefs(coefs) {}
+	ACCEPT
+
+	ExprNode* _var;
+	vector<double> _coefs;
+};
+
 class NumberNode: public ExprNode
 {
 	public:
@@ -136,6 +195,33 @@ class ActionNode: public ExprNode
 	vector<ExprNode*> _args;
 };
 
+// @root[f, lo, hi], a root of the one-parameter function f between lo and hi
+class RootNode: public ExprNode
+{
+	public:
+
+	RootNode(Token token, Symbol* symbol, ExprNode* lo, ExprNode* hi):
+		ExprNode(token), _symbol(symbol), _lo(lo), _hi(hi) {}
+	ACCEPT
+
+	Symbol* _symbol;
+	ExprNode* _lo;
+	ExprNode* _hi;
+};
+
+// @map[f, a], the sum of the one-parameter function f over the values of the array bound to a
+class MapNode: public ExprNode
+{
+	public:
+
+	MapNode(Token token, Symbol* symbol, ExprNode* array):
+		ExprNode(token), _symbol(symbol), _array(array) {}
+	ACCEPT
+
+	Symbol* _symbol;
+	ExprNode* _array;
+};
+
 #undef ACCEPT
 #pragma endregion
 
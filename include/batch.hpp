@@ -0,0 +1,157 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "ast.hpp"
+#include "symbol.hpp"
+#include "solver.hpp"
+#include "root.hpp"
+#include "pch"
+
+using namespace std;
+
+// rows evaluated together, a column of one block fits easily into the L1 cache
+#define BATCH_LANES 256
+
+// input rows, every column holds the values of one bind address
+typedef struct
+{
+	vector<uint> addrs;
+	vector<vector<double>> columns;
+	size_t rows = 0;
+	uint64_t first = 0; // sample of the first row, the random actions draw for the sample of every row
+} Batch;
+
+// reads a CSV file with a header of bind addresses, returns false on errors
+bool read_batch(string path, Batch& batch);
+
+// values of a bind address from start to stop, both included, in equal steps
+typedef struct
+{
+	uint addr;
+	double start;
+	double stop;
+	double step;
+} SweepAxis;
+
+// rows a sweep may have, its grid and results are held in memory at once
+#define SWEEP_MAX_ROWS (1 << 24)
+
+// number of values of an axis, 0 if there are more than SWEEP_MAX_ROWS
+size_t sweep_points(const SweepAxis& axis);
+
+// a batch of every combination of the values of the axes, the last one varying fastest
+Batch sweep_grid(const vector<SweepAxis>& axes);
+
+// Solves a symbol for every row of a batch, with the row's values bound to the
+// batch's addresses. Every node is evaluated for a block of rows at once into a
+// column of T, or of int64_t for integral nodes, so that the operators compile
+// to loops over the lanes. Conditionals and short-circuiting operators only
+// evaluate their operands for the lanes that take them. Actions with a span
+// handler, like @get, the math and the random actions, get all lanes at once.
+// Roots are searched for all lanes in lockstep with secant steps, every lane
+// stops once its own search is done. T is double, or float for twice the lanes
+// per vector. With several threads every thread solves a part of the blocks
+// with a solver of its own, and the limits hold for every part. @map evaluates
+// f for a block of the array's values at once, the same way, within the budget
+// of its caller. Several symbols are solved for every block in turn, within one
+// epoch, so that with STRATEGY_MEMO the symbols they share are evaluated once
+// per block.
+template<typename T>
+class BatchSolver: public Visitor
+{
+public:
+
+	BatchSolver();
+	~BatchSolver();
+	Status solve(Environment* env, Symbol* symbol, const Batch& batch);
+	Status solve(Environment* env, const vector<Symbol*>& symbols, const Batch& batch);
+	Status map_sum(Environment* env, Symbol* f, BoundArray values, const map<uint, const double*>& bound, uint64_t sample, uint32_t path, Budget& budget, double& sum);
+	vector<double> results;
+	Limits limits;
+	Strategy strategy = STRATEGY_LAZY;
+	RootControls root_controls;
+	RootStats root_stats = RootStats{0, 0, 0};
+	uint threads = 1;
+
+private:
+
+	#define VISIT(_node) void visit(_node* node)
+	#include "visits.def"
+	#undef VISIT
+
+	// lanes of the block that are evaluated, all lanes up to count if dense
+	typedef struct
+	{
+		const uint16_t* index;
+		size_t count;
+		bool dense;
+	} Lanes;
+
+	// like the frames of the solver, with columns of cached arguments
+	typedef struct
+	{
+		const vector<ExprNode*>* args;
+		size_t caller;
+		Symbol* caller_symbol;
+		size_t cache;
+		uint32_t path;
+	} Frame;
+
+	void start(Environment* env);
+	Status solve_parallel(Environment* env, const vector<Symbol*>& symbols, const Batch& batch);
+	void target(Symbol* symbol, T* out);
+	template<typename F> void each(F f);
+	void* acquire();
+	void release(void* column);
+	void evaluate(ExprNode* expr, void* out, NumType type);
+	void convert(void* in, NumType from, void* out, NumType to);
+	void truth(ExprNode* expr, int64_t* out);
+	Lanes select(const int64_t* cond, bool value, uint16_t* index);
+	template<typename R, typename U> void binary(TokenType optype, R* out, const U* lhs, const U* rhs);
+	void call(Symbol* f, T* x, T* out, uint32_t path);
+	void call_span(ActionNode* node, void** columns, void* out);
+	void get_span(ActionNode* node, double* out);
+
+	// columns are reused, so that solving a block does not allocate
+	vector<void*> _pool;
+	size_t _columns = 0;
+
+	vector<void*> _arg_values;
+	vector<void*> _arg_ready;
+	vector<void*> _memo_values;
+	vector<uint64_t> _memo_epochs;
+	uint64_t _epoch = 0;
+
+	Budget _budget;
+	size_t memory();
+
+	// the bound columns, looked up by address for @get, or the row's values when mapping
+	const Action* _get;
+	map<uint, const double*> _bound;
+	size_t _row;
+	uint64_t _first;
+	bool _mapping = false; // every lane is a value of an array, all of them in the same sample
+
+	// of the calls that lead to the current node, the lanes draw for the paths of their values when mapping
+	uint32_t _path;
+	bool _elements;
+
+	// maps over arrays inside of f for every lane
+	BatchSolver<T>* _mapper = nullptr;
+
+	// argument columns of the actions being evaluated, one row of them for handlers and as doubles for span handlers
+	vector<void*> _action_columns;
+	vector<double> _action_args;
+	vector<const double*> _span_args;
+
+	// one search per lane, for every root being searched
+	vector<RootSearch> _searches;
+
+	Environment* _env;
+	vector<Frame> _frames;
+	size_t _frame;
+	Lanes _lanes;
+	void* _out;
+};
+
+#endif
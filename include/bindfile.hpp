@@ -0,0 +1,45 @@
+#ifndef BINDFILE_H
+#define BINDFILE_H
+
+#include "actions.hpp"
+#include "symbol.hpp"
+#include "shm.hpp"
+#include "pch"
+
+using namespace std;
+
+// a bind file may start with this, followed by the number of values as a uint64_t
+#define BIND_FILE_MAGIC "SLVBIND1"
+#define BIND_FILE_HEADER 16
+
+typedef struct
+{
+	string path;
+	BoundBlock block;
+} BindFile;
+
+// Maps a file of little-endian doubles read-only into memory as the values of
+// the addresses from base on, without reading or copying them. The file holds
+// either just the values or a header of BIND_FILE_MAGIC and their count before
+// them, which guards against truncated files. Returns false on errors.
+bool map_bind_file(string path, uint base, BindFile& file);
+
+typedef struct _SharedBindings
+{
+	string name;
+	BoundBlock block; // of the snapshot
+	const SharedTable* table;
+	vector<double> snapshot;
+	uint64_t sequence; // of the snapshot
+} SharedBindings;
+
+// Maps a shared-memory binding table read-only as the values of the addresses
+// from base on, see shm.hpp. The values are read from a snapshot of the table,
+// so that a solve sees one version of all of them however long it takes, and
+// the writer never waits for it. Returns false on errors.
+bool map_shared_table(string name, uint base, SharedBindings& shared);
+
+// renews the snapshots of the environment's shared tables that have changed since
+void refresh_shared(Environment* env);
+
+#endif
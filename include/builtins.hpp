@@ -0,0 +1,224 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include "actions.hpp"
+#include "mathlib.hpp"
+#include "pch"
+
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+// The built-in actions are typed functions, listed in actions.def. Their arity
+// and whether they are integral follow from their signatures, and they are
+// boxed into the handlers of the action table, which stays the description of
+// every action for diagnostics and printing. Pure numeric actions take only
+// their arguments and are folded when those are constant, the others take the
+// token and the environment first. The evaluators call the built-in actions
+// directly, so that the numeric ones are inlined, and all other actions, like
+// those of plugins, through their handlers. The random actions draw from the
+// Philox generator, keyed by the seed of the environment and counted by the
+// sample, the position of the action in the source and the path of calls that
+// led to it, so a draw is the same on any thread and wherever the action is
+// evaluated again in the same call within the sample, but every call and every
+// value of a @map draws anew. The array actions take the bind address of an
+// array and reduce it in mathlib.
+
+#pragma region functions
+// numeric actions are defined here to be inlined, the others in actions.cpp
+int32_t action_print(Token* tok, struct _Environment* env, double x);
+int32_t action_printb(Token* tok, struct _Environment* env, double addr);
+double action_get(Token* tok, struct _Environment* env, double addr);
+double action_rand(Token* tok, struct _Environment* env);
+double action_uniform(Token* tok, struct _Environment* env, double lo, double hi);
+double action_normal(Token* tok, struct _Environment* env, double mean, double deviation);
+double action_lognormal(Token* tok, struct _Environment* env, double mu, double sigma);
+int32_t action_size(Token* tok, struct _Environment* env, double array);
+double action_at(Token* tok, struct _Environment* env, double array, double index);
+double action_sum(Token* tok, struct _Environment* env, double array);
+double action_mean(Token* tok, struct _Environment* env, double array);
+double action_amin(Token* tok, struct _Environment* env, double array);
+double action_amax(Token* tok, struct _Environment* env, double array);
+double action_dot(Token* tok, struct _Environment* env, double a, double b);
+
+inline int32_t action_int(double x) { return (int32_t)x; }
+inline double action_sqrt(double x) { return mathlib::sqrt(x); }
+inline double action_exp(double x) { return mathlib::exp(x); }
+inline double action_log(double x) { return mathlib::log(x); }
+inline double action_pow(double x, double y) { return mathlib::pow(x, y); }
+inline double action_sin(double x) { return mathlib::sin(x); }
+inline double action_cos(double x) { return mathlib::cos(x); }
+inline double action_abs(double x) { return mathlib::abs(x); }
+inline double action_min(double x, double y) { return mathlib::min(x, y); }
+inline double action_max(double x, double y) { return mathlib::max(x, y); }
+inline double action_floor(double x) { return mathlib::floor(x); }
+inline double action_clamp(double x, double lo, double hi) { return mathlib::clamp(x, lo, hi); }
+#pragma endregion
+
+// ==================================================
+
+#pragma region registration
+template<typename F, F f> struct Typed;
+
+template<typename R, typename... A, R (*f)(A...)>
+struct Typed<R (*)(A...), f>
+{
+	static constexpr uint arity = sizeof...(A);
+	static constexpr bool integral = is_integral<R>::value;
+	static constexpr bool numeric = true;
+
+	static inline double call(Token*, struct _Environment*, const double* args) { return call(args, index_sequence_for<A...>()); }
+	static double handler(Token* tok, struct _Environment* env, double* args) { return call(tok, env, args); }
+
+	template<size_t... I> static inline double call(const double* args, index_sequence<I...>)
+	{
+		//
+		return (double)f((A)args[I]...);
+	}
+};
+
+template<typename R, typename... A, R (*f)(Token*, struct _Environment*, A...)>
+struct Typed<R (*)(Token*, struct _Environment*, A...), f>
+{
+	static constexpr uint arity = sizeof...(A);
+	static constexpr bool integral = is_integral<R>::value;
+	static constexpr bool numeric = false;
+
+	static inline double call(Token* tok, struct _Environment* env, const double* args) { return call(tok, env, args, index_sequence_for<A...>()); }
+	static double handler(Token* tok, struct _Environment* env, double* args) { return call(tok, env, args); }
+
+	template<size_t... I> static inline double call(Token* tok, struct _Environment* env, const double* args, index_sequence<I...>)
+	{
+		//
+		return (double)f(tok, env, (A)args[I]...);
+	}
+};
+
+#define TYPED(name) Typed<decltype(&action_##name), &action_##name>
+#pragma endregion
+
+// ==================================================
+
+#pragma region lookup
+// names are looked up in a perfect hash table, its seed is searched for at compile time
+#define ACTION_SLOTS 64
+#define ACTION_EMPTY 0xff
+
+#define ACTION(name, ...) #name,
+#define SPANNED(name, ...) #name,
+#define MATH(name, ...) #name,
+#define RANDOM(name, ...) #name,
+#define ARRAY(name, ...) #name,
+constexpr const char* builtin_names[] = {
+#include "actions.def"
+};
+#undef ACTION
+#undef SPANNED
+#undef MATH
+#undef RANDOM
+#undef ARRAY
+
+constexpr size_t BUILTINS = sizeof(builtin_names) / sizeof(*builtin_names);
+
+constexpr uint32_t action_slot(const char* name, uint32_t seed)
+{
+	uint32_t h = 2166136261u ^ seed; // fnv-1a
+	for(; *name; name++) h = (h ^ (uint8_t)*name) * 16777619u;
+	return (h ^ h >> 16) % ACTION_SLOTS;
+}
+
+constexpr bool action_collides(uint32_t seed)
+{
+	bool used[ACTION_SLOTS] = {};
+	for(size_t i = 0; i < BUILTINS; i++)
+	{
+		uint32_t slot = action_slot(builtin_names[i], seed);
+		if(used[slot]) return true;
+		used[slot] = true;
+	}
+	return false;
+}
+
+constexpr uint32_t action_seed()
+{
+	uint32_t seed = 0;
+	while(action_collides(seed)) seed++;
+	return seed;
+}
+
+typedef struct
+{
+	uint32_t seed;
+	uint8_t index[ACTION_SLOTS];
+} ActionSlots;
+
+constexpr ActionSlots action_slots()
+{
+	ActionSlots slots = { action_seed(), {} };
+	for(size_t i = 0; i < ACTION_SLOTS; i++) slots.index[i] = ACTION_EMPTY;
+	for(size_t i = 0; i < BUILTINS; i++) slots.index[action_slot(builtin_names[i], slots.seed)] = i;
+	return slots;
+}
+
+constexpr ActionSlots ACTION_TABLE = action_slots();
+static_assert(BUILTINS < ACTION_EMPTY, "too many built-in actions");
+
+constexpr bool action_equals(const char* a, const char* b)
+{
+	while(*a && *a == *b) { a++; b++; }
+	return *a == *b;
+}
+
+// the position of a built-in action in the action table, -1 if there is none by that name
+constexpr int builtin_index(const char* name)
+{
+	uint8_t i = ACTION_TABLE.index[action_slot(name, ACTION_TABLE.seed)];
+	return i != ACTION_EMPTY && action_equals(builtin_names[i], name) ? i : -1;
+}
+#pragma endregion
+
+// ==================================================
+
+#pragma region paths
+// Evaluators start from path 0 and fold the position of every call site they
+// enter into it, and the index of the value into the path of every @map. The
+// bodies of parameterless symbols start from 0 again, they are the same
+// wherever they are used.
+inline uint32_t call_path(uint32_t path, uint32_t site)
+{
+	// the finalizer of murmur3, nearby sites lead to unrelated paths
+	uint32_t h = path * 0x9E3779B1u + site + 1;
+	h = (h ^ h >> 16) * 0x85EBCA6Bu;
+	h = (h ^ h >> 13) * 0xC2B2AE35u;
+	return h ^ h >> 16;
+}
+
+inline uint32_t call_path(uint32_t path, Token* site) { return call_path(path, (uint32_t)(site->start - site->source)); }
+
+// the path of the value at index of an array that a @map runs over
+inline uint32_t element_path(uint32_t path, size_t index) { return call_path(~path, (uint32_t)index); }
+#pragma endregion
+
+// ==================================================
+
+// calls an action on one row of arguments, directly if it is a built-in one
+inline double call_action(const Action* action, Token* tok, struct _Environment* env, const double* args)
+{
+	#define ACTION(name, ...) case builtin_index(#name): return TYPED(name)::call(tok, env, args);
+	#define SPANNED(name, ...) ACTION(name)
+	#define MATH(name, ...) ACTION(name)
+	#define RANDOM(name, ...) ACTION(name)
+	#define ARRAY(name, ...) ACTION(name)
+	switch(action - actions.data())
+	{
+		#include "actions.def"
+		default: return action->handler(tok, env, (double*)args);
+	}
+	#undef ACTION
+	#undef SPANNED
+	#undef MATH
+	#undef RANDOM
+	#undef ARRAY
+}
+
+#endif
@@ -101,6 +101,7 @@ typedef enum
 	STATUS_CLI_ERROR = 1,
 	STATUS_PARSE_ERROR = 2,
 	STATUS_SOLVE_ERROR = 3,
+	STATUS_LIMIT_ERROR = 4,
 
 	STATUS_INTERNAL_ERROR = -1
 } Status;
@@ -0,0 +1,81 @@
+#ifndef ESTIMATOR_H
+#define ESTIMATOR_H
+
+#include "ast.hpp"
+#include "symbol.hpp"
+#include "solver.hpp"
+#include "root.hpp"
+#include "pch"
+
+#include <cstdint>
+#include <set>
+
+using namespace std;
+
+#define COST_INFINITE UINT64_MAX
+
+// values assumed for an array of @map whose address is only known when solving
+#define MAP_EXPECTED_VALUES 1024
+
+// cost of an expression as a function of the arguments of its symbol:
+// base + sum(coefs[i] * cost of argument i), saturating at COST_INFINITE
+typedef struct
+{
+	uint64_t base;
+	vector<uint64_t> coefs;
+} Affine;
+
+// nesting of an expression: max(base, params[i] + nesting of argument i),
+// where params[i] is -1 if parameter i is never referenced
+typedef struct
+{
+	int64_t base;
+	vector<int64_t> params;
+} Nesting;
+
+typedef struct
+{
+	Affine lazy;	// evaluated nodes when arguments are passed by name
+	Affine need;	// evaluated nodes when every argument is evaluated at most once
+	Affine local;	// like need, but referenced parameterless symbols count as one node
+	Nesting nesting;
+	set<Symbol*> globals; // parameterless symbols reachable from the expression
+	bool pure;
+} Cost;
+
+string cost_str(uint64_t cost);
+
+// Computes the cost of every symbol from the symbol graph alone,
+// without expanding or evaluating anything.
+class CostEstimator: public Visitor
+{
+public:
+
+	void estimate(Environment* env);
+	Cost& cost(Symbol* symbol);
+
+	uint64_t strategy_cost(Symbol* symbol, Strategy strategy);
+	Strategy pick_strategy(Symbol* symbol);
+	uint64_t strategy_cost(const vector<Symbol*>& symbols, Strategy strategy);
+	Strategy pick_strategy(const vector<Symbol*>& symbols);
+
+	string describe(Symbol* symbol);
+
+private:
+
+	#define VISIT(_node) void visit(_node* node)
+	#include "visits.def"
+	#undef VISIT
+
+	Cost callee_cost(Symbol* symbol);
+	Cost leaf(size_t nodes);
+	void merge(Cost& into, Cost& other);
+	void merge_either(Cost& into, Cost& other);
+
+	map<Symbol*, Cost> _costs;
+	Environment* _env;
+	size_t _arity;
+	Cost _result;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef GRADIENT_H
+#define GRADIENT_H
+
+#include "ast.hpp"
+#include "symbol.hpp"
+#include "solver.hpp"
+#include "root.hpp"
+#include "pch"
+
+using namespace std;
+
+// tangents are padded to a multiple of this, so that their loops have no remainder
+#define GRADIENT_LANES 4
+
+// Solves a symbol together with its partial derivatives with respect to bound
+// values, in forward mode. Every value on the stack is followed by its tangent,
+// one derivative per address, and every operator applies its derivative rule to
+// the whole tangent in one loop. @get of one of the addresses starts a unit
+// tangent, constants and integral actions have a zero tangent, the math actions
+// combine their arguments' tangents by their partial derivatives. All values are
+// doubles, integral nodes are not evaluated exactly. One more lane holds the
+// derivative of f with respect to its parameter while searching a root of f,
+// for the Newton steps and the derivatives of the root itself.
+class GradientSolver: public Visitor
+{
+public:
+
+	GradientSolver();
+	Status solve(Environment* env, Symbol* symbol, const vector<uint>& addrs);
+	Status solve_root(Environment* env, Symbol* f, double lo, double hi, uint32_t path, Budget& budget);
+	double result;
+	vector<double> gradient; // one partial derivative per address
+	Limits limits;
+	Strategy strategy = STRATEGY_LAZY;
+	RootControls root_controls;
+	RootStats root_stats = RootStats{0, 0, 0};
+
+private:
+
+	#define VISIT(_node) void visit(_node* node)
+	#include "visits.def"
+	#undef VISIT
+
+	// arguments of a call and the frame they have to be evaluated in
+	typedef struct
+	{
+		const vector<ExprNode*>* args;
+		size_t caller;
+		Symbol* caller_symbol;
+		size_t cache; // first argument slot when caching
+		uint32_t path; // of the caller, see call_path()
+	} Frame;
+
+	void start(Environment* env, Symbol* symbol, const vector<uint>& addrs);
+	double search(Symbol* f, double lo, double hi, uint32_t path);
+	void call(Symbol* f, double x, uint32_t path, size_t element);
+	void differentiate(ActionNode* node);
+	uint32_t draw_path();
+
+	// slots of _stride doubles, the value followed by its tangent
+	double* push();
+	double* top(size_t below = 0);
+	void pop();
+	void push_constant(double value);
+	void push_copy(const double* slot);
+	double value(ExprNode* expr);
+	vector<double> _stack;
+	size_t _slots;
+	size_t _tangents;
+	size_t _stride;
+	size_t _slope; // the lane of the parameter of f, in a slot
+	size_t _max_depth;
+
+	// evaluated arguments of all frames and evaluated symbols, as slots
+	vector<double> _arg_values;
+	vector<char> _arg_ready;
+	vector<double> _memo_values;
+	vector<uint64_t> _memo_epochs;
+	uint64_t _epoch = 0;
+
+	Budget _budget;
+	size_t memory();
+
+	// tangent index of every address
+	map<uint, size_t> _seeds;
+	const Action* _get;
+	vector<double> _action_args;
+
+	Environment* _env;
+	vector<Frame> _frames;
+	size_t _frame;
+	uint32_t _path; // of the calls that lead to the current node
+	size_t _element; // one past the index of the value of the innermost @map, 0 outside of them
+};
+
+#endif
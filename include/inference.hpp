@@ -0,0 +1,48 @@
+#ifndef INFERENCE_H
+#define INFERENCE_H
+
+#include "ast.hpp"
+#include "symbol.hpp"
+#include "pch"
+
+using namespace std;
+
+// integral values are only proven up to this magnitude, so that the
+// bounds computed in doubles never hide an overflow of 64 bits
+#define TYPE_INT_LIMIT 4611686018427387904.0 // 2^62
+
+// type of an expression and the bounds of its value if integral
+typedef struct
+{
+	NumType type;
+	double lo;
+	double hi;
+} Range;
+
+// Proves which expressions are integral: integer literals, @int and
+// other integral actions, comparisons, and sums, differences, products
+// and powers of them that cannot overflow or give -0. Every node is annotated with
+// its type, the evaluators compute integral nodes exactly in 64 bits.
+// Parameters may be bound to anything, so they are always floats.
+class TypeInference: public Visitor
+{
+public:
+
+	void infer(Environment* env);
+	size_t nodes;		// annotated nodes
+	size_t integral;	// of which integral
+
+private:
+
+	#define VISIT(_node) void visit(_node* node)
+	#include "visits.def"
+	#undef VISIT
+
+	Range symbol_range(Symbol* symbol);
+	void annotate(ExprNode* node, Range range);
+
+	map<Symbol*, Range> _ranges;
+	Range _result;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef KV_H
+#define KV_H
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <unistd.h>
+
+// The protocol of the key-value services that --resolver asks for the values
+// of addresses the program does not bind, the only header a service includes.
+// A service listens on a Unix stream socket. Every request is a uint32_t count
+// followed by that many uint32_t addresses, and is answered with as many
+// doubles followed by as many bytes, 1 for the addresses the service has a
+// value for and 0 for the others. All numbers are in the byte order of the
+// machine. A client may send several requests before reading their answers,
+// which come in the order of the requests.
+#define KV_MAX_COUNT (1 << 20)
+
+namespace kv {
+
+	// false if the other side is gone
+	inline bool write_all(int fd, const void* data, size_t size)
+	{
+		const char* bytes = (const char*)data;
+		while(size)
+		{
+			ssize_t n = write(fd, bytes, size);
+			if(n < 0 && errno == EINTR) continue;
+			if(n <= 0) return false;
+			bytes += n;
+			size -= n;
+		}
+		return true;
+	}
+
+	inline bool read_all(int fd, void* data, size_t size)
+	{
+		char* bytes = (char*)data;
+		while(size)
+		{
+			ssize_t n = read(fd, bytes, size);
+			if(n < 0 && errno == EINTR) continue;
+			if(n <= 0) return false;
+			bytes += n;
+			size -= n;
+		}
+		return true;
+	}
+}
+
+#endif
@@ -0,0 +1,306 @@
+#ifndef MATHLIB_H
+#define MATHLIB_H
+
+#include "pch"
+
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+
+using namespace std;
+
+// sin and cos reduce their argument by pi/2 in four parts up to this magnitude, so that
+// the multiples of the parts are exact, beyond it they fall back to libm
+#define MATHLIB_TRIG_LIMIT 1647099.0 // 2^20 * pi/2
+
+// Branch-free double implementations of the math actions, written so that a
+// loop over them compiles to vector instructions: special cases are selected
+// instead of branched to, bit tricks replace frexp, ldexp and floor. The
+// column versions apply them to n values at once for the batch evaluator.
+// Maximum distances from glibc's libm in units in the last place, as checked
+// by solve-bench --math:
+//
+//   sqrt, abs, min, max, floor, clamp   0, all exact
+//   exp, log                            1
+//   pow                                 1, through log and exp in double-double
+//   sin, cos                            1, libm beyond MATHLIB_TRIG_LIMIT
+//
+// min, max and clamp propagate NaN. Float batches round the double results.
+namespace mathlib
+{
+	inline uint64_t bits(double x) { uint64_t u; memcpy(&u, &x, sizeof(u)); return u; }
+	inline double from_bits(uint64_t u) { double x; memcpy(&x, &u, sizeof(x)); return x; }
+
+	// a * b = p + err exactly, by splitting the factors where there is no fast fma
+	inline double two_product(double a, double b, double& err)
+	{
+		double p = a * b;
+	#ifdef FP_FAST_FMA
+		err = std::fma(a, b, -p);
+	#else
+		const double split = 134217729.0; // 2^27 + 1
+		double ta = split * a, ah = ta - (ta - a), al = a - ah;
+		double tb = split * b, bh = tb - (tb - b), bl = b - bh;
+		err = ((ah * bh - p) + ah * bl + al * bh) + al * bl;
+	#endif
+		return p;
+	}
+
+	// a + b = s + err exactly, for any magnitudes
+	inline double two_sum(double a, double b, double& err)
+	{
+		double s = a + b;
+		double v = s - a;
+		err = (a - (s - v)) + (b - v);
+		return s;
+	}
+
+	// the same if |a| >= |b|
+	inline double fast_two_sum(double a, double b, double& err)
+	{
+		double s = a + b;
+		err = b - (s - a);
+		return s;
+	}
+
+	// =========================================
+
+	inline double sqrt(double x) { return std::sqrt(x); }
+	inline double abs(double x) { return std::fabs(x); }
+	inline double min(double a, double b) { double m = a < b ? a : b; return a != a ? a : m; }
+	inline double max(double a, double b) { double m = a > b ? a : b; return a != a ? a : m; }
+	inline double clamp(double x, double lo, double hi) { return min(max(x, lo), hi); }
+
+	// rounds by adding and subtracting 2^52, values beyond are integral already
+	inline double floor(double x)
+	{
+		double big = std::copysign(4503599627370496.0, x);
+		double t = (x + big) - big;
+		double below = t - 1;
+		t = t > x ? below : t;
+		t = t == 0 ? std::copysign(0.0, x) : t;
+		return std::fabs(x) < 4503599627370496.0 ? t : x;
+	}
+
+	// e^(hi + lo) for a tail lo much smaller than hi, after fdlibm: x = k ln2 + r
+	// with |r| <= ln2 / 2, e^r by a rational approximation, then scaled by 2^k
+	inline double exp(double hi, double lo)
+	{
+		const double inv_ln2 = 1.44269504088896338700e+00;
+		const double ln2_hi = 6.93147180369123816490e-01; // 32 bits, k * ln2_hi is exact
+		const double ln2_lo = 1.90821492927058770002e-10;
+		const double shift = 6755399441055744.0;
+
+		// beyond these the result is infinite or zero anyway, NaN passes
+		double x = hi > 710 ? 710 : hi;
+		x = x < -746 ? -746 : x;
+		double kd = x * inv_ln2 + shift;
+		uint64_t k = bits(kd) - bits(shift);
+		kd -= shift;
+
+		double r_hi = x - kd * ln2_hi;
+		double r_lo = kd * ln2_lo - lo;
+		double r = r_hi - r_lo;
+
+		double t = r * r;
+		double c = r - t * (1.66666666666666019037e-01 + t * (-2.77777777770155933842e-03
+			+ t * (6.61375632143793436117e-05 + t * (-1.65339022054652515390e-06 + t * 4.13813679705723846039e-08))));
+		double y = 1 - ((r_lo - (r * c) / (2 - c)) - r_hi);
+
+		// in two steps, so that both factors are normal even where the result is not,
+		// integers stay in the bits of doubles since vectors of them convert poorly
+		uint64_t k1 = bits(kd * 0.5 + shift) - bits(shift);
+		uint64_t k2 = k - k1;
+		double f1 = from_bits((k1 + 1023) << 52);
+		double f2 = from_bits((k2 + 1023) << 52);
+		return y * f1 * f2;
+	}
+
+	inline double exp(double x) { return exp(x, 0); }
+
+	// x = 2^e (1 + f) with 1 + f in [sqrt(1/2), sqrt(2)), subnormals are scaled into the
+	// normal range first, the exponent is taken as a double from the mantissa of 2^52 + e
+	inline double reduce(double x, double& e)
+	{
+		bool tiny = x < DBL_MIN;
+		double scaled = x * 18014398509481984.0;
+		uint64_t u = bits(tiny ? scaled : x);
+		e = from_bits((u >> 52) | 0x4330000000000000ull) - 4503599627370496.0 - 1023;
+		e -= tiny ? 54 : 0;
+		double m = from_bits((u & 0x000fffffffffffffull) | 0x3ff0000000000000ull);
+		bool big = m > M_SQRT2;
+		double halved = m * 0.5;
+		m = big ? halved : m;
+		e += big ? 1 : 0;
+		return m - 1;
+	}
+
+	// negative numbers have no logarithm, zero and infinity are their own limits
+	inline double log_special(double x, double value)
+	{
+		double edge = x == INFINITY ? x : NAN;
+		edge = x == 0 ? -INFINITY : edge;
+		return (x > 0) & (x < INFINITY) ? value : edge;
+	}
+
+	// after fdlibm: log(1 + f) = 2 atanh(s) with s = f / (2 + f), the series beyond 2 s
+	// by a minimax polynomial in s^2
+	inline double log(double x)
+	{
+		const double ln2_hi = 6.93147180369123816490e-01;
+		const double ln2_lo = 1.90821492927058770002e-10;
+
+		double e;
+		double f = reduce(x, e);
+		double s = f / (2 + f);
+		double z = s * s;
+		double w = z * z;
+		double t1 = w * (3.999999999940941908e-01 + w * (2.222219843214978396e-01 + w * 1.531383769920937332e-01));
+		double t2 = z * (6.666666666666735130e-01 + w * (2.857142874366239149e-01
+			+ w * (1.818357216161805012e-01 + w * 1.479819860511658591e-01)));
+		double hfsq = 0.5 * f * f;
+		double value = e * ln2_hi - ((hfsq - (s * (hfsq + t1 + t2) + e * ln2_lo)) - f);
+		return log_special(x, value);
+	}
+
+	// log(x) = hi + lo to about 100 bits for pow, the leading terms of the series in double-double
+	inline double log(double x, double& lo)
+	{
+		const double ln2_hi = 6.93147180369123816490e-01;
+		const double ln2_lo = 1.90821492927058770002e-10;
+
+		double e;
+		double f = reduce(x, e);
+
+		// s = f / (2 + f), with the rounding errors of the sum and the quotient
+		double d_lo, s_lo, p_err;
+		double d = fast_two_sum(2, f, d_lo);
+		double s = f / d;
+		double p = two_product(s, d, p_err);
+		s_lo = (((f - p) - p_err) - s * d_lo) / d;
+
+		// 2 s + 2/3 s^3 in double-double, the higher terms in double up to s^27, past which they
+		// are below 2^-70 of the result even where s is largest
+		double z_err, c_err, t_err;
+		double z = two_product(s, s, z_err);
+		double c = two_product(s, z, c_err);
+		c_err += s * z_err;
+		double t = two_product(6.66666666666666629659e-01, c, t_err);
+		t_err += 6.66666666666666629659e-01 * c_err + 3.70074341541718816e-17 * c;
+		double rest = c * z * (4.00000000000000022e-01 + z * (2.85714285714285698e-01 + z * (2.22222222222222210e-01
+			+ z * (1.81818181818181823e-01 + z * (1.53846153846153855e-01 + z * (1.33333333333333331e-01
+			+ z * (1.17647058823529410e-01 + z * (1.05263157894736836e-01 + z * (9.52380952380952328e-02
+			+ z * (8.69565217391304324e-02 + z * (8.00000000000000017e-02 + z * 7.40740740740740700e-02)))))))))));
+
+		double sum_err;
+		double sum = fast_two_sum(2 * s, t, sum_err);
+		double sum_lo = sum_err + t_err + rest + 2 * s_lo * (1 + z);
+
+		// plus e ln2
+		double hi_err;
+		double hi = two_sum(e * ln2_hi, sum, hi_err);
+		double hi_lo = hi_err + sum_lo + e * ln2_lo;
+		hi = fast_two_sum(hi, hi_lo, lo);
+
+		bool special = !(x > 0 && x < INFINITY);
+		lo = special ? 0 : lo;
+		return log_special(x, hi);
+	}
+
+	// whether y is an odd integer, for the sign of a negative base
+	inline bool odd(double y)
+	{
+		double half = y * 0.5;
+		return (std::fabs(y) < 9007199254740992.0) & (floor(y) == y) & (floor(half) != half);
+	}
+
+	// |x|^y = e^(y log|x|), with the product in double-double, then the special cases of C99
+	inline double pow(double x, double y)
+	{
+		double log_lo, p_err;
+		double log_hi = log(std::fabs(x), log_lo);
+		double p = two_product(y, log_hi, p_err);
+		double p_lo = p_err + y * log_lo;
+		p_lo = std::fabs(p) < INFINITY ? p_lo : 0;
+		double r = exp(p, p_lo);
+
+		double signed_r = r * std::copysign(1.0, x);
+		r = odd(y) ? signed_r : r;
+		r = (x < 0) & (x > -INFINITY) & (floor(y) != y) & (y == y) ? NAN : r;
+		r = (y == 0) | (x == 1) | ((x == -1) & (std::fabs(y) == INFINITY)) ? 1 : r;
+		return r;
+	}
+
+	// sin and cos of x = k pi/2 + r, with |r| <= pi/4 as hi + lo, after fdlibm's kernels
+	inline double trig(double x, bool cosine)
+	{
+		const double inv_pio2 = 6.36619772367581382433e-01;
+		const double pio2_1 = 1.57079632673412561417e+00; // 33 bits each
+		const double pio2_2 = 6.07710050630396597660e-11;
+		const double pio2_3 = 2.02226624871116645580e-21;
+		const double pio2_4 = 8.47842766036889956997e-32;
+		const double shift = 6755399441055744.0;
+
+		double kd = x * inv_pio2 + shift;
+		uint64_t k = bits(kd) - bits(shift);
+		kd -= shift;
+
+		// the multiples of the first three parts are exact for |k| < 2^20
+		double a_err, b_err;
+		double a = two_sum(x - kd * pio2_1, -kd * pio2_2, a_err);
+		double b = two_sum(a, -kd * pio2_3, b_err);
+		double r_lo, r = fast_two_sum(b, (a_err + b_err) - kd * pio2_4, r_lo);
+
+		double z = r * r;
+		double v = z * r;
+		double s = r - ((z * (0.5 * r_lo - v * (8.33333333332248946124e-03 + z * (-1.98412698298579493134e-04
+			+ z * (2.75573137070700676789e-06 + z * (-2.50507602534068634195e-08 + z * 1.58969099521155010221e-10)))))
+			- r_lo) - v * -1.66666666666666324348e-01);
+
+		double w = z * z;
+		double q = z * (4.16666666666666019037e-02 + z * (-1.38888888888741095749e-03 + z * 2.48015872894767294178e-05))
+			+ w * w * (-2.75573143513906633035e-07 + z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11));
+		double hz = 0.5 * z;
+		double one = 1 - hz;
+		double c = one + (((1 - one) - hz) + (z * q - r * r_lo));
+
+		// the quadrant picks the function and flips the sign, in bits, sin keeps the sign of zero
+		uint64_t quadrant = k + cosine;
+		uint64_t odd = 0 - (quadrant & 1);
+		double value = from_bits(((bits(c) & odd) | (bits(s) & ~odd)) ^ ((quadrant & 2) << 62));
+		return x == 0 && !cosine ? x : value;
+	}
+
+	inline double sin(double x) { return std::fabs(x) <= MATHLIB_TRIG_LIMIT ? trig(x, false) : std::sin(x); }
+	inline double cos(double x) { return std::fabs(x) <= MATHLIB_TRIG_LIMIT ? trig(x, true) : std::cos(x); }
+
+	// =========================================
+
+	// n results from n values of every argument
+	typedef void (*Columns)(double* out, const double* const* args, size_t n);
+
+	void sqrt(double* out, const double* const* args, size_t n);
+	void exp(double* out, const double* const* args, size_t n);
+	void log(double* out, const double* const* args, size_t n);
+	void pow(double* out, const double* const* args, size_t n);
+	void sin(double* out, const double* const* args, size_t n);
+	void cos(double* out, const double* const* args, size_t n);
+	void abs(double* out, const double* const* args, size_t n);
+	void min(double* out, const double* const* args, size_t n);
+	void max(double* out, const double* const* args, size_t n);
+	void floor(double* out, const double* const* args, size_t n);
+	void clamp(double* out, const double* const* args, size_t n);
+
+	// =========================================
+
+	// reductions of n values, in MATHLIB_LANES interleaved partial results that compile to
+	// vector instructions, so sums are rounded in that order instead of from left to right
+	#define MATHLIB_LANES 8
+
+	double sum(const double* x, size_t n);
+	double dot(const double* a, const double* b, size_t n);
+	double minimum(const double* x, size_t n); // infinity if empty, NaN if any is
+	double maximum(const double* x, size_t n);
+}
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef MONTECARLO_H
+#define MONTECARLO_H
+
+#include "ast.hpp"
+#include "symbol.hpp"
+#include "batch.hpp"
+#include "pch"
+
+using namespace std;
+
+// samples solved at once, the results of one chunk are the only ones ever stored
+#define MONTE_CARLO_CHUNK (1 << 16)
+
+// bars of the printed histogram
+#define MONTE_CARLO_BARS 20
+
+// bins of the summary's histogram, which doubles its range to take values beyond it
+#define SUMMARY_BINS 4096
+
+typedef struct
+{
+	double lo;
+	double hi;
+	uint64_t count;
+} HistogramBar;
+
+// The distribution of results streamed into it: their count, mean and variance,
+// updated with every result, and a histogram of fixed resolution relative to the
+// range of the results, from which quantiles are interpolated between the
+// smallest and the largest result of their bin. NaN and infinite
+// results are only counted.
+class Summary
+{
+public:
+
+	void add(const double* values, size_t n);
+	double variance();
+	double quantile(double p);
+	vector<HistogramBar> histogram(size_t bars);
+
+	uint64_t count = 0; // of finite results
+	uint64_t nonfinite = 0;
+	double mean = 0;
+	double min = INFINITY;
+	double max = -INFINITY;
+
+private:
+
+	void widen(double x);
+
+	double _m2 = 0; // sum of the squared distances from the mean
+	double _lo = 0;
+	double _width = 0; // of a bin, zero until the first finite result
+	typedef struct
+	{
+		uint64_t count;
+		double min;
+		double max;
+	} Bin;
+
+	vector<Bin> _bins = vector<Bin>(SUMMARY_BINS, Bin{0, INFINITY, -INFINITY});
+};
+
+// Solves a symbol for the samples 0 to samples - 1 in chunks, every sample a row of
+// a batch without columns, so that only the random actions differ between them.
+// The results are added to the summary in the order of the samples, so it is the
+// same for any number of threads.
+template<typename T>
+Status simulate(Environment* env, Symbol* symbol, uint64_t samples, BatchSolver<T>& solver, Summary& summary);
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "ast.hpp"
+#include "symbol.hpp"
+#include "solver.hpp"
+#include "pch"
+
+#include <set>
+
+using namespace std;
+
+// default number of nodes inlining a single call may add to its caller
+#define OPTIMIZER_INLINE_BUDGET 64
+
+// highest degree of the recognized polynomials
+#define OPTIMIZER_MAX_DEGREE 32
+
+// passes over a body at most, until nothing changes anymore
+#define OPTIMIZER_MAX_PASSES 16
+
+typedef struct
+{
+	size_t inlined;			// calls replaced by the body of their callee
+	size_t folded;			// operations replaced by their constant result
+	size_t simplified;		// algebraic rewrites
+	size_t eliminated;		// nodes removed by the rewrites
+	size_t polynomials;		// sums rewritten into Horner form
+	size_t hoisted;			// bindings, calls and root searches replaced by their value
+	size_t nodes_before;	// nodes in all symbol bodies
+	size_t nodes_after;
+} OptimizerStats;
+
+// size of an expression and the number of references to every parameter
+typedef struct
+{
+	size_t nodes;
+	vector<uint> refs;
+	bool recursive;
+	bool pure;
+	bool invariant; // depends on the parameters only, neither on bindings nor on side effects
+	bool random; // draws random numbers, which depend on the call sites that lead to them
+} NodeCount;
+
+// Rewrites the symbol bodies into cheaper expressions with the same value:
+// small non-recursive functions are inlined at their call sites, constant
+// subexpressions are folded, algebraic identities are simplified and
+// polynomials are put into Horner form, until nothing changes anymore. Nodes
+// are never modified, changed subtrees are rebuilt. With a solver to hoist
+// with, the bindings of all but the varying addresses are constants too, and
+// calls and root searches that depend on constants only are solved once and
+// folded.
+class Optimizer: public Visitor
+{
+public:
+
+	void optimize(Environment* env, Strategy strategy);
+	size_t inline_budget = OPTIMIZER_INLINE_BUDGET;
+	bool fast_math = false; // also rewrite where the result may differ for some doubles
+	Solver* hoist = nullptr; // solves the invariant calls, if given
+	set<uint> varying; // bind addresses that are no constants when hoisting
+	OptimizerStats stats;
+
+private:
+
+	#define VISIT(_node) void visit(_node* node)
+	#include "visits.def"
+	#undef VISIT
+
+	ExprNode* inline_call(CallNode* node, vector<ExprNode*>& args);
+	bool substitutable(ExprNode* arg, uint refs);
+	ExprNode* group(ExprNode* expr);
+
+	ExprNode* simplify(BinaryNode* node, ExprNode* left, ExprNode* right);
+	ExprNode* simplify(UnaryNode* node, ExprNode* expr);
+	ExprNode* rewrite(ExprNode* result, size_t eliminated);
+	bool same(ExprNode* a, ExprNode* b);
+	bool pure(ExprNode* expr);
+	ExprNode* hoisted(ExprNode* node, const vector<ExprNode*>& args, Symbol* callee);
+
+	ExprNode* polynomial(BinaryNode* node, ExprNode* left, ExprNode* right);
+	bool collect(ExprNode* expr, double sign, ExprNode*& var, vector<double>& coefs, size_t& terms);
+	bool monomial(ExprNode* expr, ExprNode*& var, double& coef, size_t& degree);
+
+	Strategy _strategy;
+	Environment* _env;
+	Symbol* _symbol; // being optimized
+	map<Symbol*, NodeCount> _counts;
+	const vector<ExprNode*>* _substitutes; // replace the parameters while inlining
+	ExprNode* _result;
+};
+
+NodeCount count_nodes(ExprNode* expr, Symbol* symbol, const map<Symbol*, NodeCount>* counts = nullptr);
+
+#endif
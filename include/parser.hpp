@@ -41,7 +41,9 @@ private:
 
 	#define CONSUME_OR_RET_NULL(type, msg) if(!consume(type, msg)) return nullptr;
 
+	int next_id(string name);
 	void set_symbol(Symbol symbol);
+	void add_symbol(Symbol* symptr);
 	Symbol* get_symbol(string name, int id = -1);
 	bool check_symbol(string name);
 	void scope_up();
@@ -51,26 +53,34 @@ private:
 	void assignment();
 
 	ExprNode* expression();
+		ExprNode* logic_or();
+		ExprNode* logic_and();
 		ExprNode* equality();
 		ExprNode* comparison();
 		ExprNode* term();
 		ExprNode* factor();
 		ExprNode* unary();
+		ExprNode* exponent();
 		ExprNode* primary();
 			NumberNode* number();
 			VariableNode* finish_variable(Token, Symbol*);
 			CallNode* finish_call(Token, Symbol*);
-			ActionNode* action();
+			ExprNode* action();
+			ExprNode* finish_root(Token);
+			ExprNode* finish_map(Token);
+			Symbol* unary_function();
 
 	// members
 
 	Scanner _scanner;
 	Token _current;
 	Token _previous;
+	size_t _token_count;
 
 	Environment _env;
 	Scope _current_scope;
 	vector<Scope> _scope_stack;
+	Symbol* _defining; // symbol whose body is being parsed
 
 	bool _had_error;
 	bool _panic_mode;
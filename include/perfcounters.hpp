@@ -0,0 +1,60 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include "common.hpp"
+#include "pch"
+
+#include <cstdint>
+
+using namespace std;
+
+// Hardware performance counters (linux perf_event_open) sampled around
+// pipeline phases. Counters are opened per thread on first use; when they
+// are unavailable (no permission, no PMU, not linux) only wall time is kept.
+
+namespace perf {
+
+	typedef enum
+	{
+		COUNTER_CYCLES,
+		COUNTER_INSTRUCTIONS,
+		COUNTER_BRANCH_MISSES,
+		COUNTER_L1D_MISSES,
+		COUNTER_LLC_MISSES,
+
+		COUNTER_MAX
+	} Counter;
+
+	typedef struct
+	{
+		uint64_t time;
+		uint64_t counts[COUNTER_MAX];
+	} Sample;
+
+	extern bool enabled;
+
+	void enable();
+	Sample sample();
+	void add(const char* phase, Sample& start, Sample& end);
+	void report();
+
+	// accumulates the counters from construction to destruction
+	class Scope
+	{
+	public:
+		Scope(const char* phase): _phase(phase)
+			{ if(enabled) _start = sample(); }
+		~Scope()
+			{ if(enabled) { Sample end = sample(); add(_phase, _start, end); } }
+
+	private:
+		const char* _phase;
+		Sample _start;
+	};
+}
+
+#define __PERF_CAT(a, b) a##b
+#define __PERF_NAME(line) __PERF_CAT(_perf_scope_, line)
+#define PERF_SCOPE(phase) perf::Scope __PERF_NAME(__LINE__)(phase)
+
+#endif
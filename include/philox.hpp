@@ -0,0 +1,52 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <cstdint>
+
+// Philox4x32-10, a counter-based random number generator (Salmon et al., "Parallel
+// random numbers: as easy as 1, 2, 3"). A block of random bits is a function of a
+// key and a counter only, so any draw can be made on any thread in any order
+// without a state to share or to split.
+
+namespace philox {
+
+	typedef struct
+	{
+		uint32_t v[4];
+	} Block;
+
+	inline void mulhilo(uint32_t a, uint32_t b, uint32_t& hi, uint32_t& lo)
+	{
+		uint64_t product = (uint64_t)a * b;
+		hi = (uint32_t)(product >> 32);
+		lo = (uint32_t)product;
+	}
+
+	inline Block generate(Block counter, uint32_t k0, uint32_t k1)
+	{
+		for(int round = 0; round < 10; round++)
+		{
+			uint32_t hi0, lo0, hi1, lo1;
+			mulhilo(0xD2511F53u, counter.v[0], hi0, lo0);
+			mulhilo(0xCD9E8D57u, counter.v[2], hi1, lo1);
+			counter = Block{{hi1 ^ counter.v[1] ^ k0, lo1, hi0 ^ counter.v[3] ^ k1, lo0}};
+			k0 += 0x9E3779B9u;
+			k1 += 0xBB67AE85u;
+		}
+		return counter;
+	}
+
+	// two independent uniform doubles in (0, 1), for the given seed, sample, stream and path
+	inline void uniforms(uint64_t seed, uint64_t sample, uint32_t stream, uint32_t path, double& u, double& v)
+	{
+		Block counter = {{(uint32_t)sample, (uint32_t)(sample >> 32), stream, path}};
+		Block bits = generate(counter, (uint32_t)seed, (uint32_t)(seed >> 32));
+
+		// 53 bits each, centered in their interval so that neither 0 nor 1 occurs
+		const double scale = 1.0 / 9007199254740992.0;
+		u = (((((uint64_t)bits.v[0] << 32) | bits.v[1]) >> 11) + 0.5) * scale;
+		v = (((((uint64_t)bits.v[2] << 32) | bits.v[3]) >> 11) + 0.5) * scale;
+	}
+}
+
+#endif
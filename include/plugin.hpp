@@ -0,0 +1,51 @@
+#ifndef PLUGIN_H
+#define PLUGIN_H
+
+#include <cstddef>
+#include <cstdint>
+
+// The interface of action plugins, the only header a plugin includes. A plugin
+// is a shared object loaded with --plugin that exports solve_plugin(), which
+// returns a description of its actions. Their names are resolved by the parser
+// like those of the built-in actions, so calling one costs the same.
+//
+//     static double lerp(const double* args) { return args[0] + (args[1] - args[0]) * args[2]; }
+//     static const PluginAction actions[] = {{"lerp", 3, PLUGIN_NUMERIC, &lerp}};
+//     PLUGIN("curves", actions)
+//
+// The interface version changes whenever these structs do, plugins built for
+// another version are refused.
+#define PLUGIN_VERSION 1
+#define PLUGIN_ENTRY "solve_plugin"
+
+// flags of plugin actions
+#define PLUGIN_PURE 1 // no side effects, calls may be cached and evaluated in batches
+#define PLUGIN_NUMERIC 3 // pure and depends on its arguments only, constant arguments are folded
+#define PLUGIN_INTEGRAL 4 // always returns a 32-bit integer, no span handler
+
+typedef struct
+{
+	const char* name;
+	uint32_t arity;
+	uint32_t flags;
+	double (*call)(const double* args);
+	void (*span)(const double* const* args, double* out, size_t n); // optional, n rows at once, pure actions only
+	void (*partials)(const double* args, double value, double* out); // optional, the derivative by every argument
+} PluginAction;
+
+typedef struct
+{
+	uint32_t version; // PLUGIN_VERSION
+	const char* name;
+	const PluginAction* actions;
+	size_t count;
+} Plugin;
+
+#define PLUGIN(name, actions) \
+	extern "C" const Plugin* solve_plugin() \
+	{ \
+		static const Plugin plugin = { PLUGIN_VERSION, name, actions, sizeof(actions) / sizeof(*actions) }; \
+		return &plugin; \
+	}
+
+#endif
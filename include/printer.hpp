@@ -22,7 +22,17 @@ private:
 	#define PRINT(what) { _stream << what; }
 	stringstream _stream;
 
-	stack<vector<ExprNode*>> _args_stack;
+	// arguments of a call and the frame they were written in
+	typedef struct
+	{
+		const vector<ExprNode*>* args;
+		size_t caller;
+		Symbol* caller_symbol;
+	} Frame;
+
+	vector<Frame> _frames;
+	size_t _frame;
+	Symbol* _symbol; // symbol whose body is being printed
 };
 
 
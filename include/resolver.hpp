@@ -0,0 +1,78 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "ast.hpp"
+#include "symbol.hpp"
+#include "kv.hpp"
+#include "pch"
+
+#include <mutex>
+#include <set>
+
+using namespace std;
+
+// how long the service may take to answer, in seconds
+#define RESOLVER_TIMEOUT 10
+
+typedef struct
+{
+	uint64_t requests;
+	uint64_t addresses; // asked for
+	uint64_t found; // of them
+	uint64_t prefetched; // addresses of the static prefetch
+} ResolverStats;
+
+// Fetches the values of addresses the program does not bind from a key-value
+// service, see kv.hpp, and keeps them for the rest of the run, like those of the
+// addresses it has none for. The addresses known before solving are prefetched
+// in one request that is only answered once a value is needed, so the service
+// works while the program is prepared. The batch solver fetches the other ones
+// for a whole block of rows at once, so that its rows share their round trips,
+// while the scalar solver fetches them as it meets them. Thread-safe, the
+// threads of a batch share the resolver.
+class Resolver
+{
+public:
+
+	~Resolver();
+	bool connect(string path); // false on errors
+	void prefetch(const vector<uint>& addrs);
+	void fetch(const vector<uint>& addrs);
+	bool lookup(uint addr, double& value); // false if the service has no value for addr
+	ResolverStats stats = ResolverStats{0, 0, 0, 0};
+
+private:
+
+	void send(const vector<uint>& addrs);
+	void receive();
+	void fail(string what);
+
+	int _fd = -1;
+	string _path;
+	mutex _mutex;
+	map<uint, pair<bool, double>> _values; // whether the service has one, and which
+	vector<vector<uint>> _pending; // requests sent but not answered yet
+};
+
+// Collects the addresses of all @get with a constant argument that a symbol
+// may evaluate, through the symbols it refers to.
+class AddressCollector: public Visitor
+{
+public:
+
+	vector<uint> collect(Symbol* symbol);
+
+private:
+
+	#define VISIT(_node) void visit(_node* node)
+	#include "visits.def"
+	#undef VISIT
+
+	void reach(Symbol* symbol);
+
+	const Action* _get;
+	set<Symbol*> _reached;
+	set<uint> _addrs;
+};
+
+#endif
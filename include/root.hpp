@@ -0,0 +1,54 @@
+#ifndef ROOT_H
+#define ROOT_H
+
+#include "pch"
+
+#include <cmath>
+
+using namespace std;
+
+// defaults of the root search controls
+#define ROOT_TOLERANCE 1e-12
+#define ROOT_MAX_ITERATIONS 100
+
+// evaluations of f per root assumed by the cost estimates, typical of smooth functions
+#define ROOT_EXPECTED_EVALUATIONS 12
+
+typedef struct
+{
+	double tolerance = ROOT_TOLERANCE;			// on the root, relative to its magnitude but at least absolute
+	uint max_iterations = ROOT_MAX_ITERATIONS;	// evaluations of f after the bounds
+} RootControls;
+
+typedef struct
+{
+	size_t roots;		// searched
+	size_t failures;	// of which had no bracketed root or did not converge
+	size_t evaluations;	// of f, including the bounds
+} RootStats;
+
+// Searches a root of f between two bounds where f has opposite signs, like
+// rtsafe: a Newton step from the last point if its slope is known, otherwise a
+// secant step through the last two points, and bisection whenever that step
+// leaves the bracket or is not at most half the step before the last one. The
+// bracket always holds the root, so the search converges at least as fast as
+// bisection. The caller evaluates f wherever the search asks for it.
+class RootSearch
+{
+public:
+
+	bool start(double lo, double flo, double slo, double hi, double fhi, double shi, RootControls controls);
+	double next();
+	bool update(double x, double fx, double slope);
+	double root; // NaN if there is none
+
+private:
+
+	double _a, _fa, _b, _fb;	// the bracket
+	double _x, _fx, _slope;		// the last point and the slope of f there, or of the secant
+	double _step, _before;		// the last two steps
+	uint _iterations;
+	RootControls _controls;
+};
+
+#endif
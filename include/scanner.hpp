@@ -27,6 +27,7 @@ typedef enum
 	TOKEN_GREATER,
 	TOKEN_LESS,
 	TOKEN_MODULO,
+	TOKEN_CARET,
 
 
 	// Multi-character tokens
@@ -42,6 +43,10 @@ typedef enum
 	TOKEN_FLOAT,
 	TOKEN_STRING,
 
+	// Keywords.
+	TOKEN_AND,
+	TOKEN_OR,
+
 	// misc.
 	TOKEN_NEWLINE,
 	TOKEN_ERROR,
@@ -86,6 +91,7 @@ private:
 	Token number();
 	Token string();
 	Token identifier();
+	TokenType identifierType();
 	void skipWhitespaces();
 };
 
@@ -0,0 +1,37 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "ast.hpp"
+#include "symbol.hpp"
+#include "solver.hpp"
+#include "pch"
+
+using namespace std;
+
+// bytes read from the input at once
+#define SERVER_READ_SIZE (1 << 16)
+
+typedef enum
+{
+	FRAMING_TEXT,
+	FRAMING_BINARY,
+} Framing;
+
+// Answers a stream of requests from stdin on stdout until the end of the input,
+// with the program parsed and optimized once and the same solver for every
+// request. In the text framing every line is a request: "ADDR -> VALUE" binds
+// a number to a bind address, "solve" writes the result as a line, and any
+// other line is answered with a line starting with "error". In the binary
+// framing a request is the byte 'b' followed by a uint32_t address and a double,
+// or the byte 's', which is answered with the result as a double, both in the
+// byte order of the machine. The output is only flushed once all input read so
+// far is answered, so pipelined requests share their writes. Every solve sees
+// the shared tables as they are when it starts. Runtime errors of the program
+// still abort, like when solving once.
+Status serve(Environment* env, Symbol* symbol, Solver& solver, Framing framing);
+
+// keeps stdout for the answers of serve, everything else printed for the rest
+// of the run goes to stderr, so that it is never mistaken for an answer
+void take_stdout();
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <sched.h>
+
+// The layout of a shared-memory binding table, the only header a writer of one
+// includes. A table is a POSIX shared-memory object of a header followed by its
+// values, which one writer updates in place while any number of solve processes
+// read them. Writes are guarded by a sequence lock: the sequence is odd while
+// the writer changes values and even otherwise, so a reader that copied the
+// values between two reads of the same even sequence has a consistent copy.
+// Neither side ever waits for the other, a reader only retries its copy.
+//
+//     SharedTable* table = ...; // mapped read-write, of shm::bytes(count)
+//     shm::begin_write(table);
+//     shm::values(table)[i] = x;
+//     shm::end_write(table);
+#define SHM_MAGIC "SLVSHM01"
+
+// retries of a reader before it yields to the writer
+#define SHM_SPINS 64
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the sequence must be lock-free to be shared between processes");
+
+typedef struct
+{
+	char magic[8]; // SHM_MAGIC, written last when creating a table
+	uint64_t count; // of the values
+	std::atomic<uint64_t> sequence;
+	uint64_t reserved[5]; // up to a cache line, the values start on the next one
+} SharedTable;
+
+namespace shm {
+
+	inline size_t bytes(uint64_t count)
+	{
+		//
+		return sizeof(SharedTable) + count * sizeof(double);
+	}
+
+	inline double* values(SharedTable* table)
+	{
+		//
+		return (double*)(table + 1);
+	}
+
+	inline const double* values(const SharedTable* table)
+	{
+		//
+		return (const double*)(table + 1);
+	}
+
+	// the values written between these are seen by readers all at once
+	inline void begin_write(SharedTable* table)
+	{
+		table->sequence.store(table->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+	}
+
+	inline void end_write(SharedTable* table)
+	{
+		//
+		table->sequence.store(table->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	// copies a consistent version of count values unless it is the one of since, which
+	// is odd to always copy, and returns its sequence
+	inline uint64_t read(const SharedTable* table, double* out, size_t count, uint64_t since)
+	{
+		for(uint64_t spins = 1; ; spins++)
+		{
+			// a writer that was preempted in the middle of a write gets the core
+			uint64_t before = table->sequence.load(std::memory_order_acquire);
+			if(before & 1) { if(!(spins % SHM_SPINS)) sched_yield(); continue; }
+			if(before == since) return before;
+
+			memcpy(out, values(table), count * sizeof(double));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if(table->sequence.load(std::memory_order_relaxed) == before) return before;
+		}
+	}
+}
+
+#endif
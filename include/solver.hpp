@@ -3,32 +3,218 @@
 
 #include "ast.hpp"
 #include "symbol.hpp"
+#include "root.hpp"
 #include "pch"
 
 #include <cmath>
+#include <limits>
 
 using namespace std;
 
+// initial capacities, the stacks only grow when these are exceeded
+#define SOLVER_VALUE_STACK_INIT 1024
+#define SOLVER_FRAME_STACK_INIT 256
+
+// native stack the evaluation may use, recursive models that run away
+// are stopped here instead of overflowing the stack
+#define SOLVER_NATIVE_STACK_LIMIT (4 << 20)
+
+// number of steps between checks of the deadline and memory limits
+#define SOLVER_BUDGET_INTERVAL 1024
+
+// how arguments and parameterless symbols are evaluated
+typedef enum
+{
+	STRATEGY_LAZY,	// by name, every reference evaluates again
+	STRATEGY_NEED,	// every argument at most once per call
+	STRATEGY_MEMO,	// like need, and every symbol at most once per solve
+} Strategy;
+
+// per-solve limits, 0 means unlimited
+typedef struct
+{
+	uint64_t max_steps = 0;		// evaluated nodes
+	uint64_t timeout_us = 0;	// wall-clock time
+	size_t max_nesting = 0;		// nested symbol expansions
+	size_t max_memory = 0;		// bytes of evaluator stacks
+} Limits;
+
+// The operators are templated on the value type: double for the solver and
+// constant folding, float for float32 batches and int64_t for integral nodes.
+
+// exponents up to 3 are raised by multiplication, which gives exactly the
+// result of the written out multiplications, all others by pow, since the
+// error of squaring grows with the exponent and its reciprocal may overflow
+template<typename T>
+inline T power(T base, T exponent)
+{
+	if(exponent == 0) return 1;
+	if(exponent == 1) return base;
+	if(exponent == 2) return base * base;
+	if(exponent == 3) return base * base * base;
+	return pow(base, exponent);
+}
+
+// integral nodes only have constant non-negative exponents
+template<>
+inline int64_t power(int64_t base, int64_t exponent)
+{
+	int64_t result = 1;
+	for(uint64_t n = exponent; n; base *= base)
+	{
+		if(n & 1) result *= base;
+		if(!(n >>= 1)) break;
+	}
+	return result;
+}
+
+// evaluates a polynomial in Horner form, with fused multiply-adds where the hardware has them
+template<typename T>
+inline T horner(const vector<double>& coefs, T x)
+{
+	T result = coefs.back();
+	for(size_t i = coefs.size() - 1; i-- > 0; )
+	{
+	#ifdef FP_FAST_FMA
+		result = fma(result, x, (T)coefs[i]);
+	#else
+		result = result * x + (T)coefs[i];
+	#endif
+	}
+	return result;
+}
+
+// results of the operators, shared by the solver and constant folding
+template<typename T>
+inline T apply_binary(TokenType optype, T lhs, T rhs)
+{
+	switch(optype)
+	{
+		case TOKEN_EQUAL_EQUAL:		return lhs == rhs;
+		case TOKEN_SLASH_EQUAL:		return lhs != rhs;
+
+		case TOKEN_GREATER_EQUAL:	return lhs >= rhs;
+		case TOKEN_LESS_EQUAL:		return lhs <= rhs;
+		case TOKEN_GREATER:			return lhs > rhs;
+		case TOKEN_LESS:			return lhs < rhs;
+
+		case TOKEN_PLUS:  			return lhs + rhs;
+		case TOKEN_MINUS: 			return lhs - rhs;
+		case TOKEN_STAR:  			return lhs * rhs;
+		case TOKEN_SLASH:			return lhs / rhs;
+		case TOKEN_CARET:			return power(lhs, rhs);
+		default: THROW_INTERNAL_ERROR("during solving");
+	}
+	return numeric_limits<T>::quiet_NaN();
+}
+
+template<typename T>
+inline T apply_unary(TokenType optype, T value)
+{
+	switch(optype)
+	{
+		case TOKEN_MINUS:  	  		return - value;
+		default: THROW_INTERNAL_ERROR("during solving");
+	}
+	return numeric_limits<T>::quiet_NaN();
+}
+
+// Counts the steps and nesting of one solve and enforces its limits. The
+// evaluators check it every step, the deadline and memory are only checked
+// every SOLVER_BUDGET_INTERVAL steps.
+class Budget
+{
+public:
+
+	void start(Limits limits, Symbol* symbol);
+	bool check(size_t memory);
+	bool enter(Symbol* symbol);
+	uint64_t steps;
+	uint64_t next_check;
+	size_t nesting;
+	Symbol* symbol; // being evaluated, blamed for exceeded limits
+	Status status;
+
+private:
+
+	void exceed(string what);
+	Limits _limits;
+	uint64_t _deadline;
+	size_t _max_nesting;
+	uintptr_t _stack_base;
+};
+
+class GradientSolver;
+template<typename T> class BatchSolver;
+
 class Solver: public Visitor
 {
 public:
 
+	Solver();
+	~Solver();
 	Status solve(Environment* env, Symbol* symbol);
+	Status solve(Environment* env, const vector<Symbol*>& symbols);
 	double result;
-	
+	vector<double> results; // of every symbol, when solving several
+	Limits limits;
+	Strategy strategy = STRATEGY_LAZY;
+	RootControls root_controls;
+	RootStats root_stats();
+
 private:
 
 	#define VISIT(_node) void visit(_node* node)
 	#include "visits.def"
 	#undef VISIT
 
+	// arguments of a call and the frame they have to be evaluated in
+	typedef struct
+	{
+		const vector<ExprNode*>* args;
+		size_t caller;
+		Symbol* caller_symbol;
+		size_t cache; // first argument slot when caching
+		uint32_t path; // of the caller, see call_path()
+	} Frame;
+
+	// evaluated arguments of all frames and evaluated symbols
+	vector<double> _arg_values;
+	vector<char> _arg_ready;
+	vector<double> _memo_values;
+	vector<uint64_t> _memo_epochs;
+	uint64_t _epoch = 0;
+
+	Budget _budget;
+	size_t memory();
+
+	void start(Environment* env, Symbol* symbol);
+	double target(Symbol* symbol);
+
+	// integral nodes push their exact value bitwise into the same slots
 	void push(double value);
 	double pop();
-	stack<double> _value_stack;
+	void push_int(int64_t value);
+	int64_t pop_int();
+	void convert(NumType from, NumType to);
+	void evaluate(ExprNode* expr, NumType type);
+	double value(ExprNode* expr);
+	int64_t integer(ExprNode* expr);
+	vector<double> _value_stack;
+	size_t _max_depth;
+
+	// searches the roots, with the slopes of f
+	GradientSolver* _slopes = nullptr;
+
+	// maps over arrays, a block of values at once
+	BatchSolver<double>* _mapper = nullptr;
 
 	Environment* _env;
-	stack<vector<ExprNode*>> _args_stack;
+	vector<Frame> _frames;
+	size_t _frame;
+	uint32_t _path; // of the calls that lead to the current node, the random actions draw for it
 };
 
+uint64_t now_us();
 
-#endif
\ No newline at end of file
+#endif
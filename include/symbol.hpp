@@ -6,6 +6,7 @@
 #include "scanner.hpp"
 
 class ExprNode;
+class Resolver;
 
 typedef struct _Target
 {
@@ -24,6 +25,7 @@ typedef struct _Symbol
 	int id = 0;
 	ExprNode* body = nullptr;
 	bool invalid = true;
+	uint index = 0; // position in Environment::symbols
 
 	string get_ident()
 	{
@@ -38,6 +40,14 @@ typedef struct _Environment
 {
 	vector<Symbol*> symbols;
 	map<uint, BoundValue> bindings;
+	vector<BoundBlock> blocks; // of bind files, for the addresses the program does not bind
+	vector<struct _SharedBindings*> shared; // tables whose blocks are snapshots, renewed before solving
+	Resolver* resolver = nullptr; // of the addresses bound by neither the program nor the blocks
+
+	// of the random actions, batches draw for the sample of every row instead
+	uint64_t seed = 0;
+	uint64_t sample = 0;
+	uint32_t path = 0; // of the calls that lead to the action, see call_path()
 } Environment;
 
 #endif
\ No newline at end of file
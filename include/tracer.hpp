@@ -0,0 +1,68 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include "common.hpp"
+#include "pch"
+
+#include <cstdint>
+
+using namespace std;
+
+// Chrome/Perfetto trace-event recorder. Every thread records into its own
+// fixed-size ring buffer (oldest events get overwritten), so recording is
+// lock-free and cheap enough to leave enabled. The buffers are dumped as
+// trace-event JSON when the program exits.
+
+#define TRACE_RING_SIZE (1 << 16)
+#define TRACE_SYMBOL_MIN_NS 20000 // only keep per-symbol spans above 20us
+
+namespace tracer {
+
+	typedef struct
+	{
+		const char* name;
+		char phase; // 'X' (complete span) or 'C' (counter)
+		uint64_t ts;
+		uint64_t dur;
+		double value;
+	} Event;
+
+	extern bool enabled;
+
+	void enable(string path);
+	uint64_t now();
+	const char* intern(string name);
+
+	void span(const char* name, uint64_t start, uint64_t end);
+	void counter(const char* name, double value);
+	void thread_name(const char* name);
+
+	bool write();
+
+	// records a span from construction to destruction
+	class Scope
+	{
+	public:
+		Scope(const char* name, uint64_t min_dur = 0):
+			_name(name), _min_dur(min_dur), _start(enabled ? now() : 0) {}
+		~Scope()
+		{
+			if(!enabled || !_name) return;
+			uint64_t end = now();
+			if(end - _start >= _min_dur) span(_name, _start, end);
+		}
+		void rename(const char* name) { _name = name; }
+
+	private:
+		const char* _name;
+		uint64_t _min_dur;
+		uint64_t _start;
+	};
+}
+
+#define __TRACE_CAT(a, b) a##b
+#define __TRACE_NAME(line) __TRACE_CAT(_trace_scope_, line)
+#define TRACE_SCOPE(name) tracer::Scope __TRACE_NAME(__LINE__)(name)
+#define TRACE_COUNTER(name, value) { if(tracer::enabled) tracer::counter(name, value); }
+
+#endif
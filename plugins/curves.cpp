@@ -0,0 +1,82 @@
+#include "plugin.hpp"
+
+#include <cmath>
+
+// An example plugin: interpolation along curves and a lookup table.
+//
+//     make plugins
+//     bin/solve --plugin bin/plugins/curves.so file.slv
+//
+// with file.slv calling @lerp[a, b, t], @smoothstep[lo, hi, x] and @curve[x].
+
+static double lerp(const double* args)
+{
+	//
+	return args[0] + (args[1] - args[0]) * args[2];
+}
+
+static void lerp_span(const double* const* args, double* out, size_t n)
+{
+	const double* a = args[0];
+	const double* b = args[1];
+	const double* t = args[2];
+	for(size_t i = 0; i < n; i++) out[i] = a[i] + (b[i] - a[i]) * t[i];
+}
+
+static void lerp_partials(const double* args, double value, double* out)
+{
+	out[0] = 1 - args[2];
+	out[1] = args[2];
+	out[2] = args[1] - args[0];
+}
+
+// ==================================================
+
+static double smoothstep(const double* args)
+{
+	double t = (args[2] - args[0]) / (args[1] - args[0]);
+	t = t < 0 ? 0 : t > 1 ? 1 : t;
+	return t * t * (3 - 2 * t);
+}
+
+static void smoothstep_span(const double* const* args, double* out, size_t n)
+{
+	for(size_t i = 0; i < n; i++)
+	{
+		double row[3] = { args[0][i], args[1][i], args[2][i] };
+		out[i] = smoothstep(row);
+	}
+}
+
+// ==================================================
+
+// a curve given by points at equal steps, linear in between and constant beyond its ends
+#define CURVE_START 0.0
+#define CURVE_STEP 0.5
+static const double curve_points[] = { 0, 0.12, 0.41, 0.73, 0.88, 0.95, 0.98, 1 };
+static const size_t curve_count = sizeof(curve_points) / sizeof(*curve_points);
+
+static double curve(const double* args)
+{
+	double x = (args[0] - CURVE_START) / CURVE_STEP;
+	if(!(x > 0)) return x != x ? x : curve_points[0];
+	if(x >= curve_count - 1) return curve_points[curve_count - 1];
+
+	size_t i = (size_t)x;
+	return curve_points[i] + (curve_points[i + 1] - curve_points[i]) * (x - i);
+}
+
+static void curve_span(const double* const* args, double* out, size_t n)
+{
+	for(size_t i = 0; i < n; i++) out[i] = curve(args[0] + i);
+}
+
+// ==================================================
+
+static const PluginAction actions[] = {
+	{ "lerp", 3, PLUGIN_NUMERIC, &lerp, &lerp_span, &lerp_partials },
+	{ "smoothstep", 3, PLUGIN_NUMERIC, &smoothstep, &smoothstep_span, nullptr },
+	{ "curve", 1, PLUGIN_NUMERIC, &curve, &curve_span, nullptr },
+};
+
+PLUGIN("curves", actions)
@@ -2,11 +2,23 @@
 #include "symbol.hpp"
 #include "error.hpp"
 #include "tools.hpp"
+#include "builtins.hpp"
+#include "philox.hpp"
+#include "resolver.hpp"
 
 // ==================================================
 
 string BoundValue::to_string(bool debug)
 {
+	// arrays show their first values only
+	if(type == ARRAY)
+	{
+		string s = "[";
+		for(size_t i = 0; i < as.arr.size && i < 8; i++) s += (i ? ", " : "") + tools::fstr("%g", as.arr.data[i]);
+		if(as.arr.size > 8) s += tools::fstr(", ... %zu values", as.arr.size);
+		return s + "]";
+	}
+
 	if(debug) switch(type)
 	{
 		case NUMBER: return ::to_string(as.num);
@@ -27,6 +39,20 @@ static ErrorDispatcher err_dispatcher = ErrorDispatcher();
 #define ERR_PROMPT "Runtime Error"
 #define FMT_ERROR(fmt, ...) err_dispatcher.error_at_token(tok, ERR_PROMPT, tools::fstr(fmt, __VA_ARGS__).c_str())
 
+// the block of a bind file that holds addr, or null
+static const BoundBlock* find_block(Environment* env, uint addr)
+{
+	for(auto& b : env->blocks) if(addr - b.base < b.count) return &b;
+	return nullptr;
+}
+
+bool is_bound(Environment* env, uint addr, bool resolve)
+{
+	double value;
+	if(env->bindings.count(addr) || find_block(env, addr)) return true;
+	return resolve && env->resolver && env->resolver->lookup(addr, value);
+}
+
 static BoundValue get_bound_value(Token* tok, Environment* env, double addr)
 {
 	if(addr != (uint)addr) // make sure addr is uint
@@ -34,63 +60,324 @@ static BoundValue get_bound_value(Token* tok, Environment* env, double addr)
 		FMT_ERROR("Bind address %g is not an unsigned integer.", addr);
 		ABORT(STATUS_SOLVE_ERROR);
 	}
-	else if(env->bindings.find(addr) == env->bindings.end()) // check if addr bound
+
+	auto it = env->bindings.find(addr);
+	if(it != env->bindings.end()) return it->second;
+
+	// bind files are read straight from their mapping
+	BoundValue val;
+	val.type = BoundValue::NUMBER;
+	if(const BoundBlock* b = find_block(env, addr))
 	{
-		FMT_ERROR("No value bound to address 0x%x (%u).", (uint)addr, (uint)addr);
+		val.as.num = b->values[(uint)addr - b->base];
+		return val;
+	}
+	if(env->resolver && env->resolver->lookup(addr, val.as.num)) return val;
+
+	FMT_ERROR("No value bound to address 0x%x (%u).", (uint)addr, (uint)addr);
+	ABORT(STATUS_SOLVE_ERROR);
+}
+
+BoundArray get_bound_array(Token* tok, Environment* env, double addr)
+{
+	BoundValue val = get_bound_value(tok, env, addr);
+	if(val.type != BoundValue::ARRAY)
+	{
+		FMT_ERROR("Bound value %s is not an array.", val.to_string(true).c_str());
 		ABORT(STATUS_SOLVE_ERROR);
 	}
+	return val.as.arr;
+}
+
+// ==================================================
+
+#pragma region random
+// every random action draws from a stream of its own, numbered by its position in the source
+#define STREAM(tok) (uint32_t)((tok)->start - (tok)->source)
+
+static inline double draw_rand(uint64_t seed, uint64_t sample, uint32_t stream, uint32_t path)
+{
+	double u, v;
+	philox::uniforms(seed, sample, stream, path, u, v);
+	return u;
+}
+
+static inline double draw_uniform(uint64_t seed, uint64_t sample, uint32_t stream, uint32_t path, double lo, double hi)
+{
+	//
+	return lo + (hi - lo) * draw_rand(seed, sample, stream, path);
+}
 
-	return env->bindings[addr];
+// Box-Muller, with the second of its pair unused so that every draw stays a function of its sample
+static inline double draw_normal(uint64_t seed, uint64_t sample, uint32_t stream, uint32_t path, double mean, double deviation)
+{
+	double u, v;
+	philox::uniforms(seed, sample, stream, path, u, v);
+	return mean + deviation * mathlib::sqrt(-2 * mathlib::log(u)) * mathlib::cos(2 * M_PI * v);
+}
+
+static inline double draw_lognormal(uint64_t seed, uint64_t sample, uint32_t stream, uint32_t path, double mu, double sigma)
+{
+	//
+	return mathlib::exp(draw_normal(seed, sample, stream, path, mu, sigma));
 }
+#pragma endregion
 
 // ==================================================
 
-#pragma region handlers
-#define HANDLER(name) static double handler_##name(Token* tok, Environment* env, double* args)
+#pragma region functions
 #define GET_BOUND_VALUE(addr) get_bound_value(tok, env, addr)
 
-HANDLER(print) // print double
+int32_t action_print(Token* tok, Environment* env, double x) // print double
 {
-	cout << args[0] << endl;
+	cout << x << '\n';
 	return 0;
 }
 
-HANDLER(printb) // print string
+int32_t action_printb(Token* tok, Environment* env, double addr) // print string
 {
-	cout << GET_BOUND_VALUE(args[0]).to_string(false) << endl;
+	cout << GET_BOUND_VALUE(addr).to_string(false) << '\n';
 	return 0;
 }
 
-HANDLER(int) // cast to int
+double action_get(Token* tok, Environment* env, double addr) // gets a double
+{
+	BoundValue val = GET_BOUND_VALUE(addr);
+	if(val.type != BoundValue::NUMBER)
+		FMT_ERROR("Cannot use non-numeric bound value %s.", val.to_string(true).c_str());
+	return val.as.num;
+}
+
+double action_rand(Token* tok, Environment* env) // uniform in (0, 1)
 {
 	//
-	return (int)args[0];
+	return draw_rand(env->seed, env->sample, STREAM(tok), env->path);
 }
 
-HANDLER(get) // gets a double
+double action_uniform(Token* tok, Environment* env, double lo, double hi)
 {
-	BoundValue val = GET_BOUND_VALUE(args[0]);
-	if(val.type != BoundValue::NUMBER)
-		FMT_ERROR("Cannot use non-numeric bound value %s.", val.to_string(true).c_str());
-	return val.as.num;
+	//
+	return draw_uniform(env->seed, env->sample, STREAM(tok), env->path, lo, hi);
+}
+
+double action_normal(Token* tok, Environment* env, double mean, double deviation)
+{
+	//
+	return draw_normal(env->seed, env->sample, STREAM(tok), env->path, mean, deviation);
+}
+
+double action_lognormal(Token* tok, Environment* env, double mu, double sigma) // of a normal log
+{
+	//
+	return draw_lognormal(env->seed, env->sample, STREAM(tok), env->path, mu, sigma);
+}
+
+#define GET_BOUND_ARRAY(addr) get_bound_array(tok, env, addr)
+
+int32_t action_size(Token* tok, Environment* env, double array) // number of values
+{
+	//
+	return GET_BOUND_ARRAY(array).size;
 }
 
-#undef HANDLER
+double action_at(Token* tok, Environment* env, double array, double index) // the value at index, from 0
+{
+	auto arr = GET_BOUND_ARRAY(array);
+	if(!(index >= 0 && index < arr.size && index == (size_t)index))
+	{
+		FMT_ERROR("Index %g is out of the bounds of the %zu values of array 0x%x.", index, arr.size, (uint)array);
+		ABORT(STATUS_SOLVE_ERROR);
+	}
+	return arr.data[(size_t)index];
+}
+
+double action_sum(Token* tok, Environment* env, double array)
+{
+	auto arr = GET_BOUND_ARRAY(array);
+	return mathlib::sum(arr.data, arr.size);
+}
+
+double action_mean(Token* tok, Environment* env, double array) // NaN if empty
+{
+	auto arr = GET_BOUND_ARRAY(array);
+	return arr.size ? mathlib::sum(arr.data, arr.size) / arr.size : NAN;
+}
+
+double action_amin(Token* tok, Environment* env, double array) // smallest value, infinity if empty
+{
+	auto arr = GET_BOUND_ARRAY(array);
+	return mathlib::minimum(arr.data, arr.size);
+}
+
+double action_amax(Token* tok, Environment* env, double array) // largest value, -infinity if empty
+{
+	auto arr = GET_BOUND_ARRAY(array);
+	return mathlib::maximum(arr.data, arr.size);
+}
+
+double action_dot(Token* tok, Environment* env, double a, double b) // of arrays of the same size
+{
+	auto x = GET_BOUND_ARRAY(a);
+	auto y = GET_BOUND_ARRAY(b);
+	if(x.size != y.size)
+	{
+		FMT_ERROR("Arrays 0x%x and 0x%x differ in size, %zu and %zu values.", (uint)a, (uint)b, x.size, y.size);
+		ABORT(STATUS_SOLVE_ERROR);
+	}
+	return mathlib::dot(x.data, y.data, x.size);
+}
+#pragma endregion
+
+#pragma region spans
+#define SPAN(name) static void span_##name(Token* tok, Environment* env, const double* const* args, double* out, size_t n)
+
+SPAN(get) // rows of the same address look it up once
+{
+	// the addresses of the resolver are fetched for all rows in one request
+	if(env->resolver)
+	{
+		vector<uint> missing;
+		for(size_t i = 0; i < n; i++)
+			if(args[0][i] == (uint)args[0][i] && !is_bound(env, args[0][i], false)) missing.push_back(args[0][i]);
+		if(!missing.empty()) env->resolver->fetch(missing);
+	}
+
+	double last = NAN;
+	BoundValue val;
+	for(size_t i = 0; i < n; i++)
+	{
+		if(!(args[0][i] == last)) val = GET_BOUND_VALUE(last = args[0][i]);
+		if(val.type != BoundValue::NUMBER)
+			FMT_ERROR("Cannot use non-numeric bound value %s.", val.to_string(true).c_str());
+		out[i] = val.as.num;
+	}
+}
+
+// the math actions are vectorized by mathlib
+#define COLUMNS(name) SPAN(name) { mathlib::name(out, args, n); }
+COLUMNS(sqrt)
+COLUMNS(exp)
+COLUMNS(log)
+COLUMNS(pow)
+COLUMNS(sin)
+COLUMNS(cos)
+COLUMNS(abs)
+COLUMNS(min)
+COLUMNS(max)
+COLUMNS(floor)
+COLUMNS(clamp)
+#undef COLUMNS
+
+// the columns after the arguments hold the sample and the path of every row
+SPAN(rand) { for(size_t i = 0; i < n; i++) out[i] = draw_rand(env->seed, args[0][i], STREAM(tok), (uint32_t)args[1][i]); }
+SPAN(uniform) { for(size_t i = 0; i < n; i++) out[i] = draw_uniform(env->seed, args[2][i], STREAM(tok), (uint32_t)args[3][i], args[0][i], args[1][i]); }
+SPAN(normal) { for(size_t i = 0; i < n; i++) out[i] = draw_normal(env->seed, args[2][i], STREAM(tok), (uint32_t)args[3][i], args[0][i], args[1][i]); }
+SPAN(lognormal) { for(size_t i = 0; i < n; i++) out[i] = draw_lognormal(env->seed, args[2][i], STREAM(tok), (uint32_t)args[3][i], args[0][i], args[1][i]); }
+
+// rows of the same arrays reduce them once
+#define REDUCTION(name) SPAN(name) \
+	{ \
+		double last = NAN, value = NAN; \
+		for(size_t i = 0; i < n; i++) \
+		{ \
+			if(!(args[0][i] == last)) value = action_##name(tok, env, last = args[0][i]); \
+			out[i] = value; \
+		} \
+	}
+REDUCTION(sum)
+REDUCTION(mean)
+REDUCTION(amin)
+REDUCTION(amax)
+#undef REDUCTION
+
+SPAN(at) { for(size_t i = 0; i < n; i++) out[i] = action_at(tok, env, args[0][i], args[1][i]); }
+
+SPAN(dot)
+{
+	double a = NAN, b = NAN, value = NAN;
+	for(size_t i = 0; i < n; i++)
+	{
+		if(!(args[0][i] == a && args[1][i] == b)) value = action_dot(tok, env, a = args[0][i], b = args[1][i]);
+		out[i] = value;
+	}
+}
+
+#undef SPAN
 #pragma endregion
 
-// built-in actions
-#define HANDLER(name, argc) { #name, argc, &handler_##name }
+#pragma region partials
+#define PARTIALS(name) static void partials_##name(const double* args, double value, double* out)
+
+PARTIALS(sqrt) { out[0] = 0.5 / value; }
+PARTIALS(exp) { out[0] = value; }
+PARTIALS(log) { out[0] = 1 / args[0]; }
+PARTIALS(sin) { out[0] = cos(args[0]); }
+PARTIALS(cos) { out[0] = -sin(args[0]); }
+PARTIALS(abs) { out[0] = args[0] > 0 ? 1 : args[0] < 0 ? -1 : 0; }
+PARTIALS(floor) { out[0] = 0; }
+
+PARTIALS(pow) // like the ^ operator, by the exponent only where it varies
+{
+	out[0] = args[1] == 0 ? 0 : args[1] * pow(args[0], args[1] - 1);
+	out[1] = value * log(args[0]);
+}
+
+// the selected argument, the first one on ties
+PARTIALS(min) { out[0] = !(args[1] < args[0]); out[1] = !out[0]; }
+PARTIALS(max) { out[0] = !(args[1] > args[0]); out[1] = !out[0]; }
+
+PARTIALS(clamp)
+{
+	out[2] = max(args[0], args[1]) > args[2];
+	out[1] = !out[2] && args[0] < args[1];
+	out[0] = !out[1] && !out[2];
+}
+
+// of the draw for the same sample, which is the same uniform or standard normal one scaled
+PARTIALS(rand) {}
+PARTIALS(uniform) { out[1] = (value - args[0]) / (args[1] - args[0]); out[0] = 1 - out[1]; }
+PARTIALS(normal) { out[0] = 1; out[1] = (value - args[0]) / args[1]; }
+PARTIALS(lognormal) { out[0] = value; out[1] = value * (log(value) - args[0]) / args[1]; }
+
+// arrays are constants, their addresses and indices are not differentiable
+#define CONSTANT(name) PARTIALS(name) { for(uint i = 0; i < TYPED(name)::arity; i++) out[i] = 0; }
+CONSTANT(at)
+CONSTANT(sum)
+CONSTANT(mean)
+CONSTANT(amin)
+CONSTANT(amax)
+CONSTANT(dot)
+#undef CONSTANT
+
+#undef PARTIALS
+#pragma endregion
+
+// built-in actions in the order of actions.def, the math ones also take spans and have derivatives,
+// the random ones take spans with a column of samples and are differentiated for their sample,
+// the array ones are constant in their arguments
+#define TABLE(name, pure) #name, TYPED(name)::arity, pure, TYPED(name)::integral, TYPED(name)::numeric, &TYPED(name)::handler
+#define ACTION(name, pure) { TABLE(name, pure) },
+#define SPANNED(name, pure) { TABLE(name, pure), &span_##name },
+#define MATH(name) { TABLE(name, true), &span_##name, &partials_##name },
+#define RANDOM(name) { TABLE(name, true), &span_##name, &partials_##name, true },
+#define ARRAY(name) { TABLE(name, true), &span_##name, &partials_##name },
 vector<Action> actions = {
-	HANDLER(print, 1),
-	HANDLER(printb, 1),
-	HANDLER(int, 1),
-	HANDLER(get, 1),
+#include "actions.def"
 };
-#undef HANDLER
+#undef TABLE
+#undef ACTION
+#undef SPANNED
+#undef MATH
+#undef RANDOM
+#undef ARRAY
 
 Action* get_action(string name)
 {
-	for(auto it = actions.begin(); it != actions.end(); it++)
-		if(it->name == name) return &(*it);
+	int builtin = builtin_index(name.c_str());
+	if(builtin >= 0) return &actions[builtin];
+
+	// then the actions of plugins
+	for(size_t i = BUILTINS; i < actions.size(); i++)
+		if(actions[i].name == name) return &actions[i];
 	return nullptr;
 }
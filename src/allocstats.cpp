@@ -0,0 +1,150 @@
+#include "allocstats.hpp"
+#include "tools.hpp"
+
+#include <mutex>
+#include <new>
+
+// ==================================================
+
+#define MAX_PHASES 32
+
+typedef struct
+{
+	const char* phase;
+	uint runs;
+	allocstats::Counts total;
+} PhaseTotals;
+
+bool allocstats::enabled = false;
+
+static mutex phases_mutex;
+static PhaseTotals phases[MAX_PHASES]; // fixed, so that accounting never allocates
+static uint phase_count = 0;
+
+static thread_local allocstats::Counts local_counts;
+
+#define COUNT(size) { if(allocstats::enabled) { local_counts.allocations++; local_counts.bytes += (size); } }
+
+static void report_at_exit()
+{
+	//
+	allocstats::report();
+}
+
+// ==================================================
+
+void allocstats::enable()
+{
+	#ifndef __GLIBC__
+	ERR("Allocation statistics are only supported with glibc.");
+	return;
+	#endif
+
+	enabled = true;
+	atexit(report_at_exit);
+}
+
+allocstats::Counts allocstats::counts()
+{
+	//
+	return local_counts;
+}
+
+void allocstats::add(const char* phase, Counts& start, Counts& end)
+{
+	lock_guard<mutex> lock(phases_mutex);
+
+	PhaseTotals* totals = nullptr;
+	for(uint i = 0; i < phase_count; i++) if(phases[i].phase == phase) { totals = &phases[i]; break; }
+	if(!totals)
+	{
+		if(phase_count == MAX_PHASES) return;
+		totals = &phases[phase_count++];
+		*totals = PhaseTotals{phase, 0, {0, 0}};
+	}
+
+	totals->runs++;
+	totals->total.allocations += end.allocations - start.allocations;
+	totals->total.bytes += end.bytes - start.bytes;
+}
+
+// print the totals per phase
+void allocstats::report()
+{
+	if(!enabled) return;
+	enabled = false;
+
+	lock_guard<mutex> lock(phases_mutex);
+	MSG("Heap allocations:");
+
+	for(uint i = 0; i < phase_count; i++)
+	{
+		PhaseTotals& p = phases[i];
+		MSG(tools::fstr("    %-14s %4u run%s %10llu allocation%s %12llu bytes",
+			p.phase, p.runs, p.runs == 1 ? " " : "s",
+			(unsigned long long)p.total.allocations, p.total.allocations == 1 ? " " : "s",
+			(unsigned long long)p.total.bytes));
+	}
+}
+
+// ==================================================
+// counting replacements of the global allocation functions
+
+#ifdef __GLIBC__
+#pragma region hooks
+
+extern "C"
+{
+	void* __libc_malloc(size_t size);
+	void* __libc_calloc(size_t count, size_t size);
+	void* __libc_realloc(void* ptr, size_t size);
+	void __libc_free(void* ptr);
+
+	void* malloc(size_t size) noexcept
+	{
+		COUNT(size);
+		return __libc_malloc(size);
+	}
+
+	void* calloc(size_t count, size_t size) noexcept
+	{
+		COUNT(count * size);
+		return __libc_calloc(count, size);
+	}
+
+	void* realloc(void* ptr, size_t size) noexcept
+	{
+		COUNT(size);
+		return __libc_realloc(ptr, size);
+	}
+
+	void free(void* ptr) noexcept
+	{
+		//
+		__libc_free(ptr);
+	}
+}
+
+static void* counted_new(size_t size)
+{
+	COUNT(size);
+	void* ptr = __libc_malloc(size ? size : 1);
+	if(!ptr) throw bad_alloc();
+	return ptr;
+}
+
+void* operator new(size_t size) { return counted_new(size); }
+void* operator new[](size_t size) { return counted_new(size); }
+
+void* operator new(size_t size, const nothrow_t&) noexcept
+	{ COUNT(size); return __libc_malloc(size ? size : 1); }
+void* operator new[](size_t size, const nothrow_t&) noexcept
+	{ COUNT(size); return __libc_malloc(size ? size : 1); }
+
+void operator delete(void* ptr) noexcept { __libc_free(ptr); }
+void operator delete[](void* ptr) noexcept { __libc_free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { __libc_free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { __libc_free(ptr); }
+
+#pragma endregion
+#endif
@@ -0,0 +1,949 @@
+#include "batch.hpp"
+#include "tracer.hpp"
+#include "perfcounters.hpp"
+#include "allocstats.hpp"
+#include "error.hpp"
+#include "tools.hpp"
+#include "builtins.hpp"
+
+#include <climits>
+#include <thread>
+
+#define COLUMN_BYTES (BATCH_LANES * sizeof(int64_t))
+
+// ==================================================
+
+// parses a whole field, surrounding spaces allowed
+static bool parse_field(string field, double& value, bool address)
+{
+	const char* begin = field.c_str();
+	char* end;
+
+	if(address)
+	{
+		unsigned long long addr = strtoull(begin, &end, 0);
+		if(addr > UINT_MAX || strchr(begin, '-')) return false;
+		value = addr;
+	}
+	else value = strtod(begin, &end);
+
+	while(isspace(*end)) end++;
+	return end != begin && !*end;
+}
+
+bool read_batch(string path, Batch& batch)
+{
+	TRACE_SCOPE("read batch");
+
+	string text = tools::readf(path);
+	batch = Batch();
+
+	size_t line = 0;
+	for(auto& row : tools::split_string(text, "\n"))
+	{
+		line++;
+		if(!row.empty() && row.back() == '\r') row.pop_back();
+		if(row.find_first_not_of(" \t") == string::npos) continue;
+
+		vector<string> fields = tools::split_string(row, ",");
+		double value;
+
+		// the first row holds the addresses
+		if(batch.addrs.empty())
+		{
+			for(auto& f : fields)
+			{
+				if(!parse_field(f, value, true))
+					{ ERR(tools::fstr("Invalid bind address '%s' in \"%s\".", f.c_str(), path.c_str())); return false; }
+				batch.addrs.push_back((uint)value);
+			}
+			batch.columns.resize(fields.size());
+			continue;
+		}
+
+		if(fields.size() != batch.addrs.size())
+		{
+			ERR(tools::fstr("Expected %zu values on line %zu of \"%s\", got %zu.",
+				batch.addrs.size(), line, path.c_str(), fields.size()));
+			return false;
+		}
+		for(size_t i = 0; i < fields.size(); i++)
+		{
+			if(!parse_field(fields[i], value, false))
+				{ ERR(tools::fstr("Invalid number '%s' on line %zu of \"%s\".", fields[i].c_str(), line, path.c_str())); return false; }
+			batch.columns[i].push_back(value);
+		}
+		batch.rows++;
+	}
+
+	if(batch.addrs.empty()) { ERR("No bind addresses in \"" << path << "\"."); return false; }
+	return true;
+}
+
+// stop is included even if the division rounds below it
+size_t sweep_points(const SweepAxis& axis)
+{
+	double points = floor((axis.stop - axis.start) / axis.step + 1e-9) + 1;
+	return points <= SWEEP_MAX_ROWS ? (size_t)points : 0;
+}
+
+Batch sweep_grid(const vector<SweepAxis>& axes)
+{
+	Batch grid;
+	grid.rows = 1;
+
+	// the values are multiples of the step rather than sums, so that the steps do
+	// not accumulate rounding errors
+	vector<size_t> counts;
+	for(auto& a : axes)
+	{
+		counts.push_back(sweep_points(a));
+		grid.addrs.push_back(a.addr);
+		grid.rows *= counts.back();
+	}
+
+	grid.columns.resize(axes.size());
+	for(size_t i = 0; i < axes.size(); i++)
+	{
+		grid.columns[i].reserve(grid.rows);
+		size_t repeat = 1;
+		for(size_t j = i + 1; j < axes.size(); j++) repeat *= counts[j];
+		for(size_t row = 0; row < grid.rows; row++)
+			grid.columns[i].push_back(axes[i].start + (row / repeat % counts[i]) * axes[i].step);
+	}
+	return grid;
+}
+
+// ==================================================
+
+template<typename T>
+BatchSolver<T>::BatchSolver()
+{
+	// preallocate so that solving does not have to
+	_frames.reserve(SOLVER_FRAME_STACK_INIT);
+	_arg_values.reserve(SOLVER_FRAME_STACK_INIT);
+	_arg_ready.reserve(SOLVER_FRAME_STACK_INIT);
+	_pool.reserve(SOLVER_FRAME_STACK_INIT);
+	_searches.reserve(BATCH_LANES);
+}
+
+template<typename T>
+BatchSolver<T>::~BatchSolver()
+{
+	for(auto c : _pool) delete[] (int64_t*)c;
+	for(auto c : _memo_values) delete[] (int64_t*)c;
+	delete _mapper;
+}
+
+// what every solve needs before its first block
+template<typename T>
+void BatchSolver<T>::start(Environment* env)
+{
+	_env = env;
+
+	// the arguments of one action are passed at a time, and the samples and paths of the random ones
+	size_t arity = 1;
+	for(auto& a : actions) arity = max(arity, (size_t)a.arity);
+	_action_args.resize(arity);
+	_span_args.resize(arity + 2);
+
+	_get = get_action("get");
+	_bound.clear();
+
+	if(strategy == STRATEGY_MEMO && _memo_epochs.size() < env->symbols.size())
+	{
+		_memo_values.resize(env->symbols.size(), nullptr);
+		_memo_epochs.resize(env->symbols.size(), 0);
+	}
+}
+
+template<typename T>
+Status BatchSolver<T>::solve(Environment* env, Symbol* symbol, const Batch& batch)
+{
+	//
+	return solve(env, vector<Symbol*>{symbol}, batch);
+}
+
+// the results of a row are next to each other, in the order of the symbols
+template<typename T>
+Status BatchSolver<T>::solve(Environment* env, const vector<Symbol*>& symbols, const Batch& batch)
+{
+	if(threads > 1 && batch.rows > BATCH_LANES) return solve_parallel(env, symbols, batch);
+
+	TRACE_SCOPE("solve batch");
+	PERF_SCOPE("solve batch");
+	ALLOC_SCOPE("solve batch");
+
+	size_t n = symbols.size();
+	results.assign(batch.rows * n, nan("<no result>"));
+	start(env);
+	_first = batch.first;
+	_mapping = false;
+	for(size_t i = 0; i < batch.addrs.size(); i++) _bound[batch.addrs[i]] = batch.columns[i].data();
+
+	// the limits hold for the whole batch
+	_budget.start(limits, symbols[0]);
+
+	T* column = (T*)acquire();
+	for(_row = 0; _row < batch.rows && _budget.status == STATUS_SUCCESS; _row += BATCH_LANES)
+	{
+		// every block starts with all lanes and a new epoch, shared by the symbols
+		_lanes = Lanes{nullptr, min((size_t)BATCH_LANES, batch.rows - _row), true};
+		_epoch++;
+
+		for(size_t k = 0; k < n && _budget.status == STATUS_SUCCESS; k++)
+		{
+			target(symbols[k], column);
+			for(size_t i = 0; i < _lanes.count; i++) results[(_row + i) * n + k] = isnan(column[i]) ? nan("<NaN>") : column[i];
+		}
+	}
+	release(column);
+
+	TRACE_COUNTER("evaluation steps", _budget.steps);
+	TRACE_COUNTER("batch columns", _columns);
+
+	return _budget.status;
+}
+
+// evaluates a symbol being solved for with a top-level frame, memoized like the references to it
+template<typename T>
+void BatchSolver<T>::target(Symbol* symbol, T* out)
+{
+	_frames.clear();
+	_frames.push_back(Frame{nullptr, 0, symbol, 0, 0});
+	_frame = 0;
+	_path = 0;
+	_elements = false;
+	_budget.symbol = symbol;
+	if(strategy != STRATEGY_MEMO) { evaluate(symbol->body, out, TYPE_FLOAT); return; }
+
+	uint index = symbol->index;
+	NumType type = symbol->body->_type;
+	if(_memo_epochs[index] != _epoch)
+	{
+		if(!_memo_values[index]) _memo_values[index] = new int64_t[BATCH_LANES];
+		evaluate(symbol->body, _memo_values[index], type);
+		_memo_epochs[index] = _epoch;
+	}
+	convert(_memo_values[index], type, out, TYPE_FLOAT);
+}
+
+// sums f over the values of an array in their order, one value per lane, on the caller's budget,
+// with the values bound by the caller's row for all of them, drawing for the path of f
+template<typename T>
+Status BatchSolver<T>::map_sum(Environment* env, Symbol* f, BoundArray values, const map<uint, const double*>& bound, uint64_t sample, uint32_t path, Budget& budget, double& sum)
+{
+	start(env);
+	_first = sample;
+	_mapping = true;
+	_bound = bound;
+	_budget = budget;
+
+	sum = 0;
+	T* x = (T*)acquire();
+	T* fx = (T*)acquire();
+	for(_row = 0; _row < values.size && _budget.status == STATUS_SUCCESS; _row += BATCH_LANES)
+	{
+		_lanes = Lanes{nullptr, min((size_t)BATCH_LANES, values.size - _row), true};
+		_frames.clear();
+		_frames.push_back(Frame{nullptr, 0, _budget.symbol, 0, 0});
+		_frame = 0;
+		_path = 0;
+		_elements = true;
+		_epoch++;
+
+		for(size_t i = 0; i < _lanes.count; i++) x[i] = values.data[_row + i];
+		call(f, x, fx, path);
+		for(size_t i = 0; i < _lanes.count; i++) sum += fx[i];
+	}
+	release(fx);
+	release(x);
+
+	if(_budget.status != STATUS_SUCCESS) sum = NAN;
+	budget = _budget;
+	return _budget.status;
+}
+
+// splits the rows into a part of whole blocks per thread
+template<typename T>
+Status BatchSolver<T>::solve_parallel(Environment* env, const vector<Symbol*>& symbols, const Batch& batch)
+{
+	TRACE_SCOPE("solve parallel");
+
+	size_t blocks = (batch.rows + BATCH_LANES - 1) / BATCH_LANES;
+	size_t parts = min((size_t)threads, blocks);
+	vector<BatchSolver<T>> solvers(parts);
+	vector<Batch> batches(parts);
+	vector<Status> statuses(parts);
+	vector<thread> workers;
+
+	for(size_t p = 0; p < parts; p++)
+	{
+		size_t begin = blocks * p / parts * BATCH_LANES;
+		size_t end = min(batch.rows, blocks * (p + 1) / parts * BATCH_LANES);
+		batches[p].addrs = batch.addrs;
+		batches[p].rows = end - begin;
+		batches[p].first = batch.first + begin;
+		for(auto& c : batch.columns) batches[p].columns.emplace_back(c.begin() + begin, c.begin() + end);
+
+		solvers[p].limits = limits;
+		solvers[p].strategy = strategy;
+		solvers[p].root_controls = root_controls;
+		workers.emplace_back([&, p]()
+		{
+			tracer::thread_name(tracer::intern(tools::fstr("batch %zu", p)));
+			statuses[p] = solvers[p].solve(env, symbols, batches[p]);
+		});
+	}
+
+	// the first failed part decides the status, like the first failed block does
+	results.clear();
+	Status status = STATUS_SUCCESS;
+	for(size_t p = 0; p < parts; p++)
+	{
+		workers[p].join();
+		results.insert(results.end(), solvers[p].results.begin(), solvers[p].results.end());
+		root_stats.roots += solvers[p].root_stats.roots;
+		root_stats.failures += solvers[p].root_stats.failures;
+		root_stats.evaluations += solvers[p].root_stats.evaluations;
+		if(status == STATUS_SUCCESS) status = statuses[p];
+	}
+	return status;
+}
+
+// calls f with the index of every evaluated lane
+template<typename T> template<typename F>
+inline void BatchSolver<T>::each(F f)
+{
+	if(_lanes.dense) for(size_t i = 0; i < _lanes.count; i++) f(i);
+	else for(size_t k = 0; k < _lanes.count; k++) f(_lanes.index[k]);
+}
+
+// a column of BATCH_LANES values of up to 8 bytes, or of lane indices
+template<typename T>
+void* BatchSolver<T>::acquire()
+{
+	if(_pool.empty()) { _columns++; return new int64_t[BATCH_LANES]; }
+
+	void* column = _pool.back();
+	_pool.pop_back();
+	return column;
+}
+
+template<typename T>
+void BatchSolver<T>::release(void* column)
+{
+	//
+	_pool.push_back(column);
+}
+
+// evaluates an expression for the current lanes into a column of the given type
+template<typename T>
+void BatchSolver<T>::evaluate(ExprNode* expr, void* out, NumType type)
+{
+	if(expr->_type == type) { _out = out; expr->accept(this); return; }
+
+	void* column = acquire();
+	_out = column;
+	expr->accept(this);
+	convert(column, expr->_type, out, type);
+	release(column);
+}
+
+template<typename T>
+void BatchSolver<T>::convert(void* in, NumType from, void* out, NumType to)
+{
+	int64_t* ints = (int64_t*)in;
+	T* floats = (T*)in;
+
+	if(to == TYPE_INT)
+	{
+		int64_t* o = (int64_t*)out;
+		if(from == TYPE_INT) each([=](size_t i) { o[i] = ints[i]; });
+		else each([=](size_t i) { o[i] = (int64_t)floats[i]; });
+	}
+	else
+	{
+		T* o = (T*)out;
+		if(from == TYPE_INT) each([=](size_t i) { o[i] = (T)ints[i]; });
+		else each([=](size_t i) { o[i] = floats[i]; });
+	}
+}
+
+// whether an expression is non-zero, for the current lanes
+template<typename T>
+void BatchSolver<T>::truth(ExprNode* expr, int64_t* out)
+{
+	void* column = acquire();
+	_out = column;
+	expr->accept(this);
+
+	int64_t* ints = (int64_t*)column;
+	T* floats = (T*)column;
+	if(expr->_type == TYPE_INT) each([=](size_t i) { out[i] = ints[i] != 0; });
+	else each([=](size_t i) { out[i] = floats[i] != 0; });
+	release(column);
+}
+
+// the current lanes whose condition is value, still dense if that are all of them
+template<typename T>
+typename BatchSolver<T>::Lanes BatchSolver<T>::select(const int64_t* cond, bool value, uint16_t* index)
+{
+	size_t count = 0;
+	each([&](size_t i) { if((cond[i] != 0) == value) index[count++] = i; });
+	return count == _lanes.count ? _lanes : Lanes{index, count, false};
+}
+
+// applies an operator to all lanes, with the switch outside of the loop
+template<typename T> template<typename R, typename U>
+void BatchSolver<T>::binary(TokenType optype, R* o, const U* a, const U* b)
+{
+	switch(optype)
+	{
+		case TOKEN_EQUAL_EQUAL:		each([=](size_t i) { o[i] = a[i] == b[i]; }); break;
+		case TOKEN_SLASH_EQUAL:		each([=](size_t i) { o[i] = a[i] != b[i]; }); break;
+
+		case TOKEN_GREATER_EQUAL:	each([=](size_t i) { o[i] = a[i] >= b[i]; }); break;
+		case TOKEN_LESS_EQUAL:		each([=](size_t i) { o[i] = a[i] <= b[i]; }); break;
+		case TOKEN_GREATER:			each([=](size_t i) { o[i] = a[i] > b[i]; }); break;
+		case TOKEN_LESS:			each([=](size_t i) { o[i] = a[i] < b[i]; }); break;
+
+		case TOKEN_PLUS:			each([=](size_t i) { o[i] = a[i] + b[i]; }); break;
+		case TOKEN_MINUS:			each([=](size_t i) { o[i] = a[i] - b[i]; }); break;
+		case TOKEN_STAR:			each([=](size_t i) { o[i] = a[i] * b[i]; }); break;
+		case TOKEN_SLASH:			each([=](size_t i) { o[i] = a[i] / b[i]; }); break;
+		case TOKEN_CARET:			each([=](size_t i) { o[i] = power(a[i], b[i]); }); break;
+		default: THROW_INTERNAL_ERROR("during solving");
+	}
+}
+
+// evaluates f at x for the current lanes, in a frame whose only argument is always ready, drawing for the given path
+template<typename T>
+void BatchSolver<T>::call(Symbol* f, T* x, T* out, uint32_t path)
+{
+	Symbol* symbol = _budget.symbol;
+
+	size_t caller = _frame;
+	size_t cache = _arg_values.size();
+	_frames.push_back(Frame{nullptr, caller, symbol, cache, _path});
+	_frame = _frames.size() - 1;
+	_path = path;
+
+	int64_t* ready = (int64_t*)acquire();
+	for(size_t i = 0; i < BATCH_LANES; i++) ready[i] = 1;
+	_arg_values.push_back(x);
+	_arg_ready.push_back(ready);
+
+	if(_budget.enter(f)) evaluate(f->body, out, TYPE_FLOAT);
+
+	release(ready);
+	_arg_values.pop_back();
+	_arg_ready.pop_back();
+	_path = _frames.back().path;
+	_frames.pop_back();
+	_frame = caller;
+	_budget.nesting--;
+	_budget.symbol = symbol;
+}
+
+// runs an action's span handler on all lanes, its arguments packed and converted
+// to doubles unless the block is dense doubles already, the random ones also get the samples and paths of the lanes
+template<typename T>
+void BatchSolver<T>::call_span(ActionNode* node, void** columns, void* out)
+{
+	size_t arity = node->_args.size();
+	bool direct = is_same<T, double>::value && _lanes.dense;
+	for(size_t a = 0; a < arity; a++)
+	{
+		if(direct && node->_args[a]->_type == TYPE_FLOAT) { _span_args[a] = (double*)columns[a]; continue; }
+
+		double* packed = (double*)acquire();
+		bool integral = node->_args[a]->_type == TYPE_INT;
+		size_t k = 0;
+		each([&](size_t i) { packed[k++] = integral ? (double)((int64_t*)columns[a])[i] : (double)((T*)columns[a])[i]; });
+		_span_args[a] = packed;
+	}
+
+	if(node->_action->random)
+	{
+		double* samples = (double*)acquire();
+		size_t k = 0;
+		each([&](size_t i) { samples[k++] = _mapping ? _first : _first + _row + i; });
+		_span_args[arity] = samples;
+
+		double* paths = (double*)acquire();
+		k = 0;
+		each([&](size_t i) { paths[k++] = _elements ? element_path(_path, _row + i) : _path; });
+		_span_args[arity + 1] = paths;
+	}
+
+	double* result = direct ? (double*)out : (double*)acquire();
+	if(node->_action == _get) get_span(node, result);
+	else node->_action->span(&node->_token, _env, _span_args.data(), result, _lanes.count);
+
+	if(!direct)
+	{
+		size_t k = 0;
+		each([&](size_t i) { ((T*)out)[i] = result[k++]; });
+		release(result);
+	}
+
+	for(size_t a = 0; a < arity; a++)
+		if(_span_args[a] != columns[a]) release((void*)_span_args[a]);
+	if(node->_action->random) { release((void*)_span_args[arity]); release((void*)_span_args[arity + 1]); }
+}
+
+// @get reads the batch's columns first, only the other addresses go to its span handler
+template<typename T>
+void BatchSolver<T>::get_span(ActionNode* node, double* out)
+{
+	const double* addrs = _span_args[0];
+	double* missed = (double*)acquire();
+	uint16_t* at = (uint16_t*)acquire();
+	size_t k = 0, m = 0;
+	uint last = UINT_MAX;
+	const double* bound = nullptr;
+
+	each([&](size_t i)
+	{
+		bool exact = addrs[k] == (uint)addrs[k];
+		if(exact && (uint)addrs[k] != last)
+		{
+			auto it = _bound.find(last = addrs[k]);
+			bound = it != _bound.end() ? it->second : nullptr;
+		}
+
+		if(exact && bound) out[k] = bound[_mapping ? 0 : _row + i];
+		else { missed[m] = addrs[k]; at[m++] = k; }
+		k++;
+	});
+
+	if(m)
+	{
+		double* values = (double*)acquire();
+		_get->span(&node->_token, _env, &missed, values, m);
+		for(size_t j = 0; j < m; j++) out[at[j]] = values[j];
+		release(values);
+	}
+	release(at);
+	release(missed);
+}
+
+template<typename T>
+size_t BatchSolver<T>::memory()
+{
+	//
+	return _columns * COLUMN_BYTES + _frames.size() * sizeof(Frame);
+}
+
+// ===================================================================
+// All visit methods MUST fill the current lanes of the output column!
+// Only an aborted solve leaves them as they are.
+
+#define VISIT(_node) template<typename T> void BatchSolver<T>::visit(_node* node)
+
+// counts the step and bails out once a limit has been exceeded
+#define CHECK_BUDGET() if(++_budget.steps >= _budget.next_check && !_budget.check(memory())) return
+
+VISIT(AssignNode)
+{
+	// this kind of node should never be solved for
+	THROW_INTERNAL_ERROR("during solving");
+}
+
+VISIT(BinaryNode)
+{
+	CHECK_BUDGET();
+	void* out = _out;
+
+	// integral operands are exact, the result is only rounded if it is a float
+	NumType operands = node->_left->_type == TYPE_INT && node->_right->_type == TYPE_INT
+		&& node->_type == TYPE_INT ? TYPE_INT : TYPE_FLOAT;
+
+	void* lhs = acquire();
+	void* rhs = acquire();
+	evaluate(node->_left, lhs, operands);
+	evaluate(node->_right, rhs, operands);
+
+	// comparisons of floats are integral
+	if(operands == TYPE_INT) binary(node->_optype, (int64_t*)out, (int64_t*)lhs, (int64_t*)rhs);
+	else if(node->_type == TYPE_INT) binary(node->_optype, (int64_t*)out, (T*)lhs, (T*)rhs);
+	else binary(node->_optype, (T*)out, (T*)lhs, (T*)rhs);
+
+	release(rhs);
+	release(lhs);
+}
+
+VISIT(LogicalNode)
+{
+	CHECK_BUDGET();
+	int64_t* out = (int64_t*)_out;
+	truth(node->_left, out);
+
+	// the right operand is only evaluated for the lanes the left one does not decide
+	bool undecided = true;
+	switch(node->_optype)
+	{
+		case TOKEN_AND: undecided = true; break;
+		case TOKEN_OR:  undecided = false; break;
+		default: THROW_INTERNAL_ERROR("during solving");
+	}
+
+	uint16_t* index = (uint16_t*)acquire();
+	Lanes lanes = _lanes;
+	_lanes = select(out, undecided, index);
+	if(_lanes.count) truth(node->_right, out);
+	_lanes = lanes;
+	release(index);
+}
+
+VISIT(UnaryNode)
+{
+	CHECK_BUDGET();
+	void* out = _out;
+	void* column = acquire();
+	evaluate(node->_expr, column, node->_type);
+
+	if(node->_optype != TOKEN_MINUS) THROW_INTERNAL_ERROR("during solving");
+	if(node->_type == TYPE_INT)
+	{
+		int64_t* o = (int64_t*)out;
+		int64_t* a = (int64_t*)column;
+		each([=](size_t i) { o[i] = -a[i]; });
+	}
+	else
+	{
+		T* o = (T*)out;
+		T* a = (T*)column;
+		each([=](size_t i) { o[i] = -a[i]; });
+	}
+	release(column);
+}
+
+VISIT(GroupingNode)
+{
+	CHECK_BUDGET();
+
+	// just accept expr inside
+	node->_expr->accept(this);
+}
+
+VISIT(ConditionalNode)
+{
+	CHECK_BUDGET();
+	void* out = _out;
+
+	int64_t* cond = (int64_t*)acquire();
+	uint16_t* index = (uint16_t*)acquire();
+	truth(node->_cond, cond);
+
+	// every branch is only evaluated for the lanes that take it
+	Lanes lanes = _lanes;
+	_lanes = select(cond, true, index);
+	if(_lanes.count) evaluate(node->_then, out, node->_type);
+	_lanes = lanes;
+	_lanes = select(cond, false, index);
+	if(_lanes.count) evaluate(node->_else, out, node->_type);
+	_lanes = lanes;
+
+	release(index);
+	release(cond);
+}
+
+VISIT(PolynomialNode)
+{
+	CHECK_BUDGET();
+	T* out = (T*)_out;
+	T* x = (T*)acquire();
+	evaluate(node->_var, x, TYPE_FLOAT);
+
+	// one coefficient at a time for all lanes, like horner()
+	const vector<double>& coefs = node->_coefs;
+	T top = coefs.back();
+	each([=](size_t i) { out[i] = top; });
+	for(size_t k = coefs.size() - 1; k-- > 0; )
+	{
+		T c = coefs[k];
+	#ifdef FP_FAST_FMA
+		each([=](size_t i) { out[i] = fma(out[i], x[i], c); });
+	#else
+		each([=](size_t i) { out[i] = out[i] * x[i] + c; });
+	#endif
+	}
+	release(x);
+}
+
+VISIT(NumberNode)
+{
+	CHECK_BUDGET();
+
+	// just fill in the node's value
+	if(node->_type == TYPE_INT)
+	{
+		int64_t* o = (int64_t*)_out;
+		int64_t value = (int64_t)node->_value;
+		each([=](size_t i) { o[i] = value; });
+	}
+	else
+	{
+		T* o = (T*)_out;
+		T value = node->_value;
+		each([=](size_t i) { o[i] = value; });
+	}
+}
+
+VISIT(VariableNode)
+{
+	CHECK_BUDGET();
+	Symbol* symbol = _budget.symbol;
+	void* out = _out;
+
+	if(node->_symbol->id >= 0)
+	{
+		// symbols are only memoized for whole blocks
+		uint index = node->_symbol->index;
+		NumType type = node->_symbol->body->_type;
+		bool memo = strategy == STRATEGY_MEMO && _lanes.dense;
+		if(memo && _memo_epochs[index] == _epoch) { convert(_memo_values[index], type, out, node->_type); return; }
+
+		// parameterless symbols draw the same wherever they are used
+		uint32_t path = _path;
+		bool elements = _elements;
+		_path = 0;
+		_elements = false;
+		if(_budget.enter(node->_symbol))
+		{
+			if(memo)
+			{
+				if(!_memo_values[index]) _memo_values[index] = new int64_t[BATCH_LANES];
+				_out = _memo_values[index];
+				node->_symbol->body->accept(this);
+				_memo_epochs[index] = _epoch;
+				convert(_memo_values[index], type, out, node->_type);
+			}
+			else evaluate(node->_symbol->body, out, node->_type);
+		}
+		_path = path;
+		_elements = elements;
+	}
+	else
+	{
+		size_t callee = _frame;
+		size_t param = -node->_symbol->id - 1;
+		Frame frame = _frames[callee];
+
+		// arguments are evaluated in the frame of their call site, the x of a root search is always ready
+		ExprNode* arg = frame.args ? (*frame.args)[param] : nullptr;
+
+		uint32_t path = _path;
+		if(strategy == STRATEGY_LAZY && arg)
+		{
+			_frame = frame.caller;
+			_path = frame.path;
+			if(_budget.enter(frame.caller_symbol)) evaluate(arg, out, node->_type);
+			_frame = callee;
+			_path = path;
+		}
+		else
+		{
+			// only the lanes that have not evaluated the argument yet
+			void* values = _arg_values[frame.cache + param];
+			int64_t* ready = (int64_t*)_arg_ready[frame.cache + param];
+			uint16_t* index = (uint16_t*)acquire();
+			Lanes lanes = _lanes;
+			_lanes = select(ready, false, index);
+
+			if(_lanes.count)
+			{
+				_frame = frame.caller;
+				_path = frame.path;
+				if(_budget.enter(frame.caller_symbol)) evaluate(arg, values, TYPE_FLOAT);
+				_budget.nesting--;
+				_frame = callee;
+				_path = path;
+				each([=](size_t i) { ready[i] = 1; });
+			}
+
+			_lanes = lanes;
+			release(index);
+			convert(values, TYPE_FLOAT, out, node->_type);
+			_budget.symbol = symbol;
+			return;
+		}
+	}
+
+	_budget.nesting--;
+	_budget.symbol = symbol;
+}
+
+VISIT(CallNode)
+{
+	CHECK_BUDGET();
+	Symbol* symbol = _budget.symbol;
+	void* out = _out;
+
+	// set args
+	size_t caller = _frame;
+	size_t cache = _arg_values.size();
+	_frames.push_back(Frame{&node->_args, caller, symbol, cache, _path});
+	_frame = _frames.size() - 1;
+	_path = call_path(_path, &node->_token);
+
+	if(strategy != STRATEGY_LAZY) for(size_t i = 0; i < node->_args.size(); i++)
+	{
+		_arg_values.push_back(acquire());
+		_arg_ready.push_back(memset(acquire(), 0, COLUMN_BYTES));
+	}
+
+	// visit body
+	if(_budget.enter(node->_symbol)) evaluate(node->_symbol->body, out, node->_type);
+
+	if(strategy != STRATEGY_LAZY)
+	{
+		for(size_t i = cache; i < _arg_values.size(); i++) { release(_arg_ready[i]); release(_arg_values[i]); }
+		_arg_values.resize(cache);
+		_arg_ready.resize(cache);
+	}
+
+	_path = _frames.back().path;
+	_frames.pop_back();
+	_frame = caller;
+	_budget.nesting--;
+	_budget.symbol = symbol;
+}
+
+VISIT(RootNode)
+{
+	CHECK_BUDGET();
+	T* out = (T*)_out;
+	T* lo = (T*)acquire();
+	T* hi = (T*)acquire();
+	T* flo = (T*)acquire();
+	T* fhi = (T*)acquire();
+	evaluate(node->_lo, lo, TYPE_FLOAT);
+	evaluate(node->_hi, hi, TYPE_FLOAT);
+	root_stats.evaluations += 2 * _lanes.count;
+	uint32_t path = call_path(_path, &node->_token);
+	call(node->_symbol, lo, flo, path);
+	call(node->_symbol, hi, fhi, path);
+
+	// floats cannot get closer to the root than their precision
+	RootControls controls = root_controls;
+	controls.tolerance = max(controls.tolerance, (double)numeric_limits<T>::epsilon());
+
+	// the searches of nested roots are stacked behind these
+	size_t base = _searches.size();
+	_searches.resize(base + BATCH_LANES);
+	root_stats.roots += _lanes.count;
+
+	uint16_t* index = (uint16_t*)acquire();
+	size_t count = 0;
+	each([&](size_t i)
+	{
+		RootSearch& search = _searches[base + i];
+		if(!search.start(lo[i], flo[i], NAN, hi[i], fhi[i], NAN, controls)) index[count++] = i;
+		else out[i] = search.root;
+	});
+
+	// only the lanes that are not done yet take another step, x reuses the column of lo
+	Lanes lanes = _lanes;
+	T* x = lo;
+	T* fx = flo;
+	while(count && _budget.status == STATUS_SUCCESS)
+	{
+		_lanes = count == _lanes.count ? _lanes : Lanes{index, count, false};
+		each([&](size_t i) { x[i] = _searches[base + i].next(); });
+		root_stats.evaluations += _lanes.count;
+		call(node->_symbol, x, fx, path);
+
+		count = 0;
+		each([&](size_t i)
+		{
+			RootSearch& search = _searches[base + i];
+			if(!search.update(x[i], fx[i], NAN)) index[count++] = i;
+			else out[i] = search.root;
+		});
+	}
+	_lanes = lanes;
+
+	each([&](size_t i) { if(isnan(out[i])) root_stats.failures++; });
+	_searches.resize(base);
+	release(index);
+	release(fhi);
+	release(flo);
+	release(hi);
+	release(lo);
+}
+
+VISIT(ActionNode)
+{
+	CHECK_BUDGET();
+	void* out = _out;
+
+	// arguments keep their type, so that integral addresses stay exact in float32 batches
+	size_t base = _action_columns.size();
+	for(auto a : node->_args)
+	{
+		_action_columns.push_back(_out = acquire());
+		a->accept(this);
+	}
+	void** columns = _action_columns.data() + base;
+
+	// don't run handlers on the garbage of an aborted solve
+	if(_budget.status == STATUS_SUCCESS && node->_action->span) call_span(node, columns, out);
+	else if(_budget.status == STATUS_SUCCESS)
+	{
+		double* args = _action_args.data();
+		each([&](size_t i)
+		{
+			for(size_t a = 0; a < node->_args.size(); a++) args[a] = node->_args[a]->_type == TYPE_INT
+				? (double)((int64_t*)columns[a])[i] : (double)((T*)columns[a])[i];
+
+			double value = call_action(node->_action, &node->_token, _env, args);
+			if(node->_type == TYPE_INT) ((int64_t*)out)[i] = (int64_t)value;
+			else ((T*)out)[i] = value;
+		});
+	}
+
+	for(size_t a = base; a < _action_columns.size(); a++) release(_action_columns[a]);
+	_action_columns.resize(base);
+}
+
+VISIT(MapNode)
+{
+	CHECK_BUDGET();
+	T* out = (T*)_out;
+	void* arrays = acquire();
+	bool integral = node->_array->_type == TYPE_INT;
+	_out = arrays;
+	node->_array->accept(this);
+
+	// every lane maps over its own array in its own sample and with its own row, with a solver of its own
+	if(!_mapper) _mapper = new BatchSolver<T>();
+	_mapper->strategy = strategy;
+	_mapper->root_controls = root_controls;
+	map<uint, const double*> bound = _bound;
+	each([&](size_t i)
+	{
+		if(_budget.status != STATUS_SUCCESS) return;
+		double addr = integral ? (double)((int64_t*)arrays)[i] : (double)((T*)arrays)[i];
+		BoundArray values = get_bound_array(&node->_token, _env, addr);
+		for(auto& b : bound) b.second = _bound[b.first] + (_mapping ? 0 : _row + i);
+
+		double sum;
+		uint32_t path = call_path(_elements ? element_path(_path, _row + i) : _path, &node->_token);
+		_mapper->map_sum(_env, node->_symbol, values, bound, _mapping ? _first : _first + _row + i, path, _budget, sum);
+		out[i] = sum;
+	});
+
+	root_stats.roots += _mapper->root_stats.roots;
+	root_stats.failures += _mapper->root_stats.failures;
+	root_stats.evaluations += _mapper->root_stats.evaluations;
+	_mapper->root_stats = RootStats{0, 0, 0};
+	release(arrays);
+}
+
+#undef VISIT
+
+template class BatchSolver<double>;
+template class BatchSolver<float>;
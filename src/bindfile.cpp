@@ -0,0 +1,118 @@
+#include "bindfile.hpp"
+#include "tracer.hpp"
+#include "tools.hpp"
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool map_bind_file(string path, uint base, BindFile& file)
+{
+	TRACE_SCOPE("map bind file");
+
+	#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+	ERR("Bind files are little-endian, which this machine is not.");
+	return false;
+	#endif
+
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0) { ERR("Cannot open bind file \"" << path << "\": " << strerror(errno)); return false; }
+
+	struct stat info;
+	if(fstat(fd, &info)) { ERR("Cannot open bind file \"" << path << "\": " << strerror(errno)); close(fd); return false; }
+	size_t length = info.st_size;
+	if(!length) { ERR("Bind file \"" << path << "\" is empty."); close(fd); return false; }
+
+	// the mapping keeps the file open
+	void* mapping = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(mapping == MAP_FAILED) { ERR("Cannot map bind file \"" << path << "\": " << strerror(errno)); return false; }
+
+	// the header is a whole number of doubles, so the values stay aligned behind it
+	const char* bytes = (const char*)mapping;
+	size_t offset = 0, count = length / sizeof(double);
+	if(length >= BIND_FILE_HEADER && !memcmp(bytes, BIND_FILE_MAGIC, 8))
+	{
+		uint64_t declared;
+		memcpy(&declared, bytes + 8, sizeof(declared));
+		offset = BIND_FILE_HEADER;
+		count = (length - offset) / sizeof(double);
+		if(declared != count || (length - offset) % sizeof(double))
+		{
+			ERR(tools::fstr("Bind file \"%s\" declares %llu values, but holds %zu bytes of them.",
+				path.c_str(), (unsigned long long)declared, length - offset));
+			munmap(mapping, length);
+			return false;
+		}
+	}
+	else if(length % sizeof(double))
+	{
+		ERR(tools::fstr("Bind file \"%s\" holds %zu bytes, which are no whole number of doubles.", path.c_str(), length));
+		munmap(mapping, length);
+		return false;
+	}
+
+	if(count && count - 1 > UINT_MAX - base)
+	{
+		ERR(tools::fstr("Bind file \"%s\" holds %zu values, more than there are addresses from 0x%x on.", path.c_str(), count, base));
+		munmap(mapping, length);
+		return false;
+	}
+
+	// the mapping stays until the end, its values are read until then
+	file = BindFile{path, BoundBlock{base, count, (const double*)(bytes + offset)}};
+	return true;
+}
+
+// ==================================================
+
+bool map_shared_table(string name, uint base, SharedBindings& shared)
+{
+	TRACE_SCOPE("map shared table");
+
+	// the names of shared-memory objects start with a slash
+	if(name[0] != '/') name = "/" + name;
+
+	int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if(fd < 0) { ERR("Cannot open shared table \"" << name << "\": " << strerror(errno)); return false; }
+
+	struct stat info;
+	if(fstat(fd, &info)) { ERR("Cannot open shared table \"" << name << "\": " << strerror(errno)); close(fd); return false; }
+	size_t length = info.st_size;
+	if(length < sizeof(SharedTable)) { ERR("Shared table \"" << name << "\" is not ready."); close(fd); return false; }
+
+	void* mapping = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(mapping == MAP_FAILED) { ERR("Cannot map shared table \"" << name << "\": " << strerror(errno)); return false; }
+
+	// the count is checked against the size once, the values are only ever read within it
+	const SharedTable* table = (const SharedTable*)mapping;
+	uint64_t count = table->count;
+	string reason;
+	if(memcmp(table->magic, SHM_MAGIC, 8)) reason = "is not ready or no binding table";
+	else if(length < shm::bytes(count) || count > length) reason = tools::fstr("declares %llu values, but is too small for them", (unsigned long long)count);
+	else if(count && count - 1 > UINT_MAX - base) reason = tools::fstr("holds %llu values, more than there are addresses from 0x%x on", (unsigned long long)count, base);
+	if(!reason.empty())
+	{
+		ERR("Shared table \"" << name << "\" " << reason << ".");
+		munmap(mapping, length);
+		return false;
+	}
+
+	shared.name = name;
+	shared.table = table;
+	shared.snapshot.resize(count);
+	shared.sequence = shm::read(table, shared.snapshot.data(), count, 1);
+	shared.block = BoundBlock{base, count, shared.snapshot.data()};
+	return true;
+}
+
+void refresh_shared(Environment* env)
+{
+	//
+	for(auto s : env->shared) s->sequence = shm::read(s->table, s->snapshot.data(), s->snapshot.size(), s->sequence);
+}
@@ -3,15 +3,28 @@
 
 #include <argp.h>
 #include <regex>
+#include <thread>
 
 #include "common.hpp"
 #include "tools.hpp"
+#include "tracer.hpp"
+#include "perfcounters.hpp"
+#include "allocstats.hpp"
 
 #include "ast.hpp"
 #include "parser.hpp"
 #include "visualizer.hpp"
 #include "printer.hpp"
 #include "solver.hpp"
+#include "estimator.hpp"
+#include "optimizer.hpp"
+#include "inference.hpp"
+#include "batch.hpp"
+#include "gradient.hpp"
+#include "server.hpp"
+#include "montecarlo.hpp"
+#include "bindfile.hpp"
+#include "resolver.hpp"
 
 // ================= arg stuff =======================
 
@@ -19,14 +32,69 @@ const char *argp_program_version = APP_NAME " " APP_VERSION;
 const char *argp_program_bug_address = EMAIL;
 static char args_doc[] = "file...";
 
+#define STRATEGY_AUTO -1
+
 struct arguments
 {
 	char *infile = nullptr;
 	int verbose = 0;
 	bool generate_ast = false;
+	char *trace_file = nullptr;
+	bool perf_counters = false;
+	bool alloc_stats = false;
+	Limits limits;
+	int strategy = STRATEGY_AUTO;
+	uint64_t max_cost = 0;
+	uint64_t warn_cost = 0;
+	bool optimize = true;
+	size_t inline_budget = OPTIMIZER_INLINE_BUDGET;
+	bool fast_math = false;
+	char *batch_file = nullptr;
+	bool float32 = false;
+	vector<uint> gradient;
+	RootControls root_controls;
+	vector<char*> plugins;
+	vector<SweepAxis> sweep;
+	uint threads = 0;
+	bool serve = false;
+	Framing framing = FRAMING_TEXT;
+	uint64_t samples = 0;
+	uint64_t seed = 0;
+	vector<BindFile> bind_files;
+	vector<SharedBindings> bind_shm;
+	char *resolver = nullptr;
+	vector<string> solve;
 };
 
 #define ARG_GEN_AST 1
+#define ARG_TRACE 2
+#define ARG_PERF_COUNTERS 3
+#define ARG_ALLOC_STATS 4
+#define ARG_MAX_STEPS 5
+#define ARG_TIMEOUT 6
+#define ARG_MAX_NESTING 7
+#define ARG_MAX_MEMORY 8
+#define ARG_STRATEGY 9
+#define ARG_MAX_COST 10
+#define ARG_WARN_COST 11
+#define ARG_NO_OPTIMIZE 12
+#define ARG_INLINE_BUDGET 13
+#define ARG_FAST_MATH 14
+#define ARG_BATCH 15
+#define ARG_FLOAT32 16
+#define ARG_GRADIENT 17
+#define ARG_ROOT_TOLERANCE 18
+#define ARG_ROOT_ITERATIONS 19
+#define ARG_PLUGIN 20
+#define ARG_SWEEP 21
+#define ARG_THREADS 22
+#define ARG_SERVE 23
+#define ARG_MONTE_CARLO 24
+#define ARG_SEED 25
+#define ARG_BIND_FILE 26
+#define ARG_BIND_SHM 27
+#define ARG_RESOLVER 28
+#define ARG_SOLVE 29
 
 static struct argp_option options[] =
 {
@@ -35,12 +103,149 @@ static struct argp_option options[] =
 	{"usage", 				'u', 			 0, 		  0, "Display a usage information message."},
 	{"verbose", 			'v', 			 0, 		  0, "Produce verbose output."},
 	{"generate-ast",  		ARG_GEN_AST, 	 0, 		  0, "Generate AST image."},
+	{"trace",  				ARG_TRACE, 		 "FILE", 	  0, "Write a Chrome trace-event timeline to FILE."},
+	{"perf-counters",		ARG_PERF_COUNTERS, 0, 		  0, "Report hardware performance counters per phase."},
+	{"alloc-stats",			ARG_ALLOC_STATS, 0, 		  0, "Report heap allocations per phase."},
+	{"max-steps",			ARG_MAX_STEPS,	 "N", 		  0, "Abort solving after N evaluation steps."},
+	{"timeout",				ARG_TIMEOUT,	 "MS", 		  0, "Abort solving after MS milliseconds."},
+	{"max-nesting",			ARG_MAX_NESTING, "N", 		  0, "Abort solving when symbols nest deeper than N."},
+	{"max-memory",			ARG_MAX_MEMORY,	 "BYTES", 	  0, "Abort solving when the evaluator stacks exceed BYTES (K, M and G suffixes allowed)."},
+	{"strategy",			ARG_STRATEGY,	 "NAME", 	  0, "Evaluation strategy: lazy, need, memo or auto (default)."},
+	{"max-cost",			ARG_MAX_COST,	 "N", 		  0, "Refuse to solve when more than N nodes are estimated to be evaluated."},
+	{"warn-cost",			ARG_WARN_COST,	 "N", 		  0, "Warn when more than N nodes are estimated to be evaluated."},
+	{"no-optimize",			ARG_NO_OPTIMIZE, 0, 		  0, "Solve the expressions exactly as written."},
+	{"inline-budget",		ARG_INLINE_BUDGET, "N", 	  0, "Inline calls that grow their caller by at most N nodes (default 64, 0 disables inlining)."},
+	{"fast-math",			ARG_FAST_MATH,	 0, 		  0, "Also simplify where the result may differ in rounding, for NaN, infinities or signed zeros."},
+	{"batch",				ARG_BATCH,		 "FILE", 	  0, "Solve once per row of the CSV file FILE, with its header naming the bind addresses of the columns."},
+	{"float32",				ARG_FLOAT32,	 0, 		  0, "Solve batches in single precision."},
+	{"gradient",			ARG_GRADIENT,	 "ADDRS", 	  0, "Also compute the partial derivatives with respect to the comma-separated bind addresses ADDRS."},
+	{"root-tolerance",		ARG_ROOT_TOLERANCE, "X", 	  0, "Stop searching a root of @root once it is known to within X, relative to its magnitude above 1 (default 1e-12)."},
+	{"root-iterations",		ARG_ROOT_ITERATIONS, "N", 	  0, "Give up searching a root of @root after N evaluations (default 100)."},
+	{"plugin",				ARG_PLUGIN,		 "LIB", 	  0, "Load the actions of the plugin LIB, a shared object (repeatable)."},
+	{"sweep",				ARG_SWEEP,		 "ADDR=START:STOP:STEP", 0, "Solve for every value of the bind address ADDR from START to STOP (repeatable, for a grid), printing a table."},
+	{"threads",				ARG_THREADS,	 "N", 		  0, "Solve batches and sweeps on N threads (default all cores, 1 when main has side effects)."},
+	{"serve",				ARG_SERVE,		 "FRAMING", OPTION_ARG_OPTIONAL, "Answer binding updates and solve requests from stdin on stdout until its end, in lines or, with FRAMING binary, in binary records."},
+	{"monte-carlo",			ARG_MONTE_CARLO, "N", 		  0, "Solve for N samples of the random actions and print the mean, deviation, quantiles and a histogram of the results."},
+	{"seed",				ARG_SEED,		 "N", 		  0, "Seed of the random actions (default 0)."},
+	{"bind-file",			ARG_BIND_FILE,	 "ADDR=FILE", 0, "Bind the little-endian doubles of FILE to the addresses from ADDR on, mapped instead of read (repeatable)."},
+	{"bind-shm",			ARG_BIND_SHM,	 "ADDR=NAME", 0, "Bind the values of the shared-memory binding table NAME to the addresses from ADDR on, as they are when a solve starts (repeatable)."},
+	{"resolver",			ARG_RESOLVER,	 "SOCKET", 	  0, "Fetch the values of addresses bound nowhere else from the key-value service listening on the Unix socket SOCKET."},
+	{"solve",				ARG_SOLVE,		 "NAMES", 	  0, "Solve for the comma-separated symbols NAMES instead of main, the last version of NAME or version ID of NAME.ID, printing their results as one JSON object (per row of a batch)."},
 
 	{0}
 };
 
 static error_t parse_opt(int key, char *arg, struct argp_state *state);
 
+// parses a non-negative count with an optional K, M or G suffix, or a number
+// in units of scale whose fractions are rounded up, so that they never become
+// 0, which means no limit
+static uint64_t parse_size(char *arg, struct argp_state *state, bool suffixes = false, double scale = 0)
+{
+	char *end;
+	double value = strtod(arg, &end);
+
+	if(suffixes) switch(toupper(*end))
+	{
+		case 'K': value *= 1 << 10; end++; break;
+		case 'M': value *= 1 << 20; end++; break;
+		case 'G': value *= 1 << 30; end++; break;
+	}
+	if(scale) value = ceil(value * scale);
+
+	// NaN fails every comparison, infinities are out of range
+	if(end == arg || *end || !(value >= 0) || value >= 18446744073709551616.0 || value != floor(value))
+		argp_error(state, "Invalid number '%s'.", arg);
+	return (uint64_t)value;
+}
+
+// parses a bind address, decimal or hexadecimal
+static uint parse_address(string arg, struct argp_state *state)
+{
+	char *end;
+	unsigned long long addr = strtoull(arg.c_str(), &end, 0);
+
+	if(end == arg.c_str() || *end || addr > UINT_MAX || arg.find('-') != string::npos)
+		argp_error(state, "Invalid bind address '%s'.", arg.c_str());
+	return (uint)addr;
+}
+
+// splits the version ID off NAME.ID, -1 without one, false if it is out of range
+static bool split_version(string& name, int& id)
+{
+	id = -1;
+	size_t dot = name.rfind('.');
+	if(dot == string::npos || dot + 1 == name.size() || name.find_first_not_of("0123456789", dot + 1) != string::npos) return true;
+
+	errno = 0;
+	unsigned long version = strtoul(name.c_str() + dot + 1, nullptr, 10);
+	if(errno || version > INT_MAX) return false;
+
+	id = (int)version;
+	name = name.substr(0, dot);
+	return true;
+}
+
+// the last parameterless version of a symbol, or version ID of NAME.ID
+static Symbol* find_target(Environment* env, string name)
+{
+	int id;
+	split_version(name, id);
+
+	for(auto it = env->symbols.rbegin(); it != env->symbols.rend(); it++)
+	{
+		Symbol* s = *it;
+		if(s->target.name == name && !s->target.has_params && (id < 0 || s->id == id)) return s;
+	}
+	return nullptr;
+}
+
+// prints the results of the solved symbols as a JSON object, without a value for NaN and infinities
+static void print_record(const vector<string>& names, const double* results, const char* format)
+{
+	printf("{");
+	for(size_t i = 0; i < names.size(); i++)
+	{
+		printf("%s\"%s\": ", i ? ", " : "", names[i].c_str());
+		if(isfinite(results[i])) printf(format, results[i]);
+		else printf("null");
+	}
+	printf("}\n");
+}
+
+// the limits and strategy every solver of a run shares
+template<typename S>
+static void configure(S& solver, const struct arguments& arguments, Strategy strategy)
+{
+	solver.limits = arguments.limits;
+	solver.strategy = strategy;
+	solver.root_controls = arguments.root_controls;
+}
+
+template<typename T>
+static void configure(BatchSolver<T>& solver, const struct arguments& arguments, Strategy strategy, uint threads)
+{
+	configure(solver, arguments, strategy);
+	solver.threads = threads;
+}
+
+// reports how the roots were searched
+static void report_roots(RootStats stats)
+{
+	if(!stats.roots) return;
+	MSG("Roots: " << stats.roots - stats.failures << " found, " << stats.failures << " failed, "
+		<< stats.evaluations << " evaluations of f");
+}
+
+// reports what the resolver fetched
+static void report_resolver(Resolver* resolver)
+{
+	if(!resolver) return;
+	ResolverStats& stats = resolver->stats;
+	MSG("Resolver: " << stats.found << " of " << stats.addresses << " addresses found in " << stats.requests
+		<< " request" << (stats.requests == 1 ? "" : "s") << ", " << stats.prefetched << " prefetched");
+}
+
 static char *doc = strdup(tools::fstr(
 	APP_DOC, APP_NAME, EMAIL, LINK, __DATE__, __TIME__, OS_NAME, COMPILER
 	).c_str());
@@ -67,6 +272,163 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
 	case ARG_GEN_AST:
 		arguments->generate_ast = true;
 		break;
+	case ARG_TRACE:
+		arguments->trace_file = arg;
+		break;
+	case ARG_PERF_COUNTERS:
+		arguments->perf_counters = true;
+		break;
+	case ARG_ALLOC_STATS:
+		arguments->alloc_stats = true;
+		break;
+	case ARG_MAX_STEPS:
+		arguments->limits.max_steps = parse_size(arg, state);
+		break;
+	case ARG_TIMEOUT:
+		arguments->limits.timeout_us = parse_size(arg, state, false, 1000);
+		break;
+	case ARG_MAX_NESTING:
+		arguments->limits.max_nesting = parse_size(arg, state);
+		break;
+	case ARG_MAX_MEMORY:
+		arguments->limits.max_memory = parse_size(arg, state, true);
+		break;
+	case ARG_STRATEGY:
+		if(!strcmp(arg, "lazy")) arguments->strategy = STRATEGY_LAZY;
+		else if(!strcmp(arg, "need")) arguments->strategy = STRATEGY_NEED;
+		else if(!strcmp(arg, "memo")) arguments->strategy = STRATEGY_MEMO;
+		else if(!strcmp(arg, "auto")) arguments->strategy = STRATEGY_AUTO;
+		else argp_error(state, "Unknown strategy '%s'.", arg);
+		break;
+	case ARG_MAX_COST:
+		arguments->max_cost = parse_size(arg, state);
+		break;
+	case ARG_WARN_COST:
+		arguments->warn_cost = parse_size(arg, state);
+		break;
+	case ARG_NO_OPTIMIZE:
+		arguments->optimize = false;
+		break;
+	case ARG_INLINE_BUDGET:
+		arguments->inline_budget = parse_size(arg, state);
+		break;
+	case ARG_FAST_MATH:
+		arguments->fast_math = true;
+		break;
+	case ARG_BATCH:
+		arguments->batch_file = arg;
+		break;
+	case ARG_FLOAT32:
+		arguments->float32 = true;
+		break;
+	case ARG_GRADIENT:
+		for(auto a : tools::split_string(arg, ","))
+		{
+			uint addr = parse_address(a, state);
+			if(find(arguments->gradient.begin(), arguments->gradient.end(), addr) != arguments->gradient.end())
+				argp_error(state, "Bind address '%s' given twice.", a.c_str());
+			arguments->gradient.push_back(addr);
+		}
+		break;
+	case ARG_ROOT_TOLERANCE:
+	{
+		char *end;
+		double tolerance = strtod(arg, &end);
+		if(end == arg || *end || !(tolerance > 0)) argp_error(state, "Invalid tolerance '%s'.", arg);
+		arguments->root_controls.tolerance = tolerance;
+		break;
+	}
+	case ARG_ROOT_ITERATIONS:
+		arguments->root_controls.max_iterations = parse_size(arg, state);
+		break;
+	case ARG_PLUGIN:
+		arguments->plugins.push_back(arg);
+		break;
+	case ARG_SWEEP:
+	{
+		vector<string> parts = tools::split_string(arg, "=");
+		vector<string> range = parts.size() == 2 ? tools::split_string(parts[1], ":") : vector<string>();
+		if(range.size() != 3) argp_error(state, "Invalid sweep '%s', expected ADDR=START:STOP:STEP.", arg);
+
+		SweepAxis axis;
+		axis.addr = parse_address(parts[0], state);
+		double* values[] = {&axis.start, &axis.stop, &axis.step};
+		for(int i = 0; i < 3; i++)
+		{
+			char *end;
+			*values[i] = strtod(range[i].c_str(), &end);
+			if(end == range[i].c_str() || *end || !isfinite(*values[i])) argp_error(state, "Invalid number '%s'.", range[i].c_str());
+		}
+		if(!(axis.step > 0) || axis.stop < axis.start) argp_error(state, "Invalid sweep '%s', the step must be positive and STOP at least START.", arg);
+
+		for(auto& a : arguments->sweep) if(a.addr == axis.addr) argp_error(state, "Bind address '%s' swept twice.", parts[0].c_str());
+		arguments->sweep.push_back(axis);
+
+		// the grid is checked as it grows, so that the product cannot overflow
+		size_t rows = 1;
+		for(auto& a : arguments->sweep)
+		{
+			size_t points = sweep_points(a);
+			if(!points || rows > SWEEP_MAX_ROWS / points)
+				argp_error(state, "Invalid sweep '%s', the grid would have more than %d rows.", arg, SWEEP_MAX_ROWS);
+			rows *= points;
+		}
+		break;
+	}
+	case ARG_THREADS:
+		arguments->threads = parse_size(arg, state);
+		if(!arguments->threads) argp_error(state, "Invalid number of threads '%s'.", arg);
+		break;
+	case ARG_SERVE:
+		arguments->serve = true;
+		if(!arg || !strcmp(arg, "text")) arguments->framing = FRAMING_TEXT;
+		else if(!strcmp(arg, "binary")) arguments->framing = FRAMING_BINARY;
+		else argp_error(state, "Unknown framing '%s', expected text or binary.", arg);
+		break;
+	case ARG_MONTE_CARLO:
+		arguments->samples = parse_size(arg, state);
+		if(!arguments->samples) argp_error(state, "Invalid number of samples '%s'.", arg);
+		break;
+	case ARG_SEED:
+		arguments->seed = parse_size(arg, state);
+		break;
+	case ARG_BIND_FILE:
+	{
+		const char* path = strchr(arg, '=');
+		if(!path || !path[1]) argp_error(state, "Invalid bind file '%s', expected ADDR=FILE.", arg);
+
+		BindFile file;
+		file.path = path + 1;
+		file.block.base = parse_address(string(arg, path - arg), state);
+		arguments->bind_files.push_back(file);
+		break;
+	}
+	case ARG_RESOLVER:
+		arguments->resolver = arg;
+		break;
+	case ARG_SOLVE:
+		for(auto name : tools::split_string(arg, ","))
+		{
+			string symbol = name;
+			int id;
+			if(name.empty()) argp_error(state, "Invalid symbols '%s'.", arg);
+			if(!split_version(symbol, id)) argp_error(state, "Invalid version of symbol '%s'.", name.c_str());
+			if(find(arguments->solve.begin(), arguments->solve.end(), name) != arguments->solve.end())
+				argp_error(state, "Symbol '%s' given twice.", name.c_str());
+			arguments->solve.push_back(name);
+		}
+		break;
+	case ARG_BIND_SHM:
+	{
+		const char* name = strchr(arg, '=');
+		if(!name || !name[1]) argp_error(state, "Invalid shared table '%s', expected ADDR=NAME.", arg);
+
+		SharedBindings shared;
+		shared.name = name + 1;
+		shared.block.base = parse_address(string(arg, name - arg), state);
+		arguments->bind_shm.push_back(shared);
+		break;
+	}
 
 	case ARGP_KEY_ARG:
 	{
@@ -81,6 +443,15 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
 	case ARGP_KEY_END:
 	{
 		if(!arguments->infile) argp_usage(state);
+		if(arguments->batch_file && !arguments->gradient.empty()) argp_error(state, "--gradient cannot be combined with --batch.");
+		if(!arguments->sweep.empty() && (arguments->batch_file || !arguments->gradient.empty()))
+			argp_error(state, "--sweep cannot be combined with --batch or --gradient.");
+		if(arguments->serve && (arguments->batch_file || !arguments->gradient.empty() || !arguments->sweep.empty()))
+			argp_error(state, "--serve cannot be combined with --batch, --gradient or --sweep.");
+		if(arguments->samples && (arguments->batch_file || !arguments->gradient.empty() || !arguments->sweep.empty() || arguments->serve))
+			argp_error(state, "--monte-carlo cannot be combined with --batch, --gradient, --sweep or --serve.");
+		if(arguments->solve.size() > 1 && (!arguments->gradient.empty() || arguments->serve || arguments->samples))
+			argp_error(state, "Several symbols to --solve cannot be combined with --gradient, --serve or --monte-carlo.");
 		break;
 	}
 	default: return ARGP_ERR_UNKNOWN;
@@ -98,12 +469,29 @@ int main(int argc, char **argv)
 
 	/* Where the magic happens */
 	if(argp_parse(&argp, argc, argv, 0, 0, &arguments)) ABORT(STATUS_CLI_ERROR);
+	if(arguments.serve) take_stdout();
 
 	// ===================================
 	#define ABORT_IF_UNSUCCESSFULL() if(status != STATUS_SUCCESS) ABORT(status)
 
+	if(arguments.trace_file) tracer::enable(arguments.trace_file);
+	if(arguments.perf_counters) perf::enable();
+	if(arguments.alloc_stats) allocstats::enable();
+
+	// plugin actions are resolved while parsing, like the built-in ones
+	{
+		TRACE_SCOPE("plugins");
+		for(auto p : arguments.plugins) if(!load_plugin(p)) ABORT(STATUS_CLI_ERROR);
+	}
+
 	Status status = STATUS_SUCCESS;
-	CCP source = strdup(tools::readf(arguments.infile).c_str());
+	CCP source;
+	{
+		TRACE_SCOPE("read");
+		PERF_SCOPE("read");
+		ALLOC_SCOPE("read");
+		source = strdup(tools::readf(arguments.infile).c_str());
+	}
 	Environment env = {{}, {}};
 
 
@@ -111,11 +499,50 @@ int main(int argc, char **argv)
 	Parser parser = Parser();
 	status = parser.parse(arguments.infile, source, &env);
 	ABORT_IF_UNSUCCESSFULL();
+	env.seed = arguments.seed;
+
+	Resolver resolver;
+	if(arguments.resolver)
+	{
+		if(!resolver.connect(arguments.resolver)) ABORT(STATUS_CLI_ERROR);
+		env.resolver = &resolver;
+	}
+
+
+	// map the bind files and shared tables, the values of files are never read up front
+	vector<string> sources;
+	for(auto& f : arguments.bind_files)
+	{
+		if(!map_bind_file(f.path, f.block.base, f)) ABORT(STATUS_CLI_ERROR);
+		env.blocks.push_back(f.block);
+		sources.push_back(f.path);
+	}
+	for(auto& s : arguments.bind_shm)
+	{
+		if(!map_shared_table(s.name, s.block.base, s)) ABORT(STATUS_CLI_ERROR);
+		env.blocks.push_back(s.block);
+		env.shared.push_back(&s);
+		sources.push_back(s.name);
+	}
+	for(size_t i = 0; i < env.blocks.size(); i++) for(size_t j = 0; j < i; j++)
+	{
+		BoundBlock& a = env.blocks[j];
+		BoundBlock& b = env.blocks[i];
+		if(a.count && b.count && (a.base - b.base < b.count || b.base - a.base < a.count))
+		{
+			ERR("\"" << sources[j] << "\" and \"" << sources[i] << "\" bind overlapping addresses from "
+				<< tools::fstr("0x%x on.", max(a.base, b.base)));
+			ABORT(STATUS_CLI_ERROR);
+		}
+	}
 
 
 	// print symbols
 	if(arguments.verbose)
 	{
+		TRACE_SCOPE("symbol dump");
+		ALLOC_SCOPE("symbol dump");
+
 		MSG("Defined symbols:");
 		for(auto s : env.symbols)
 		{
@@ -135,52 +562,295 @@ int main(int argc, char **argv)
 			string msg = tools::fstr("    0x%02x -> ", b.first);
 			MSG(msg + b.second.to_string(true));
 		}
+		for(size_t i = 0; i < env.blocks.size(); i++) if(env.blocks[i].count) MSG(tools::fstr("    0x%02x..0x%02x -> \"%s\" (%zu values)",
+			env.blocks[i].base, (uint)(env.blocks[i].base + env.blocks[i].count - 1), sources[i].c_str(), env.blocks[i].count));
 	}
 
 
 	// generate visualization
 	if(arguments.generate_ast)
 	{
-		ASTVisualizer viz = ASTVisualizer();
+		{
+			TRACE_SCOPE("visualize");
+			ALLOC_SCOPE("visualize");
+			ASTVisualizer viz = ASTVisualizer();
 
-		viz.init();
-		for(auto s : env.symbols) viz.visualize(string(arguments.infile) + ".svg", s);
-		viz.finalize();
+			viz.init();
+			for(auto s : env.symbols) viz.visualize(string(arguments.infile) + ".svg", s);
+			viz.finalize();
+		}
 
 		MSG("AST image written to \"" + string(arguments.infile) + ".svg\".");
 		exit(STATUS_SUCCESS);
 	}
 
 
-	// find symbol to solve
-	// TODO: allow user-specified main symbol
-	Symbol* to_solve = nullptr;
-	for(auto it = env.symbols.rbegin(); it != env.symbols.rend(); it++)
+	// find the symbols to solve, main unless given
+	vector<string> names = arguments.solve.empty() ? vector<string>{"main"} : arguments.solve;
+	vector<Symbol*> targets;
+	bool pure = true;
+	for(auto& name : names)
 	{
-		Symbol* s = *it;
-		if(s->target.name == "main" && !s->target.has_params)
-			{ to_solve = s; break; }
+		Symbol* target = find_target(&env, name);
+		if(!target) { ERR("Could not solve for undefined variable '" << name << "'."); ABORT(STATUS_SOLVE_ERROR); }
+		targets.push_back(target);
+	}
+	Symbol* to_solve = targets[0];
+
+
+	// estimate cost and pick the strategy
+	CostEstimator estimator = CostEstimator();
+	Strategy strategy;
+	{
+		TRACE_SCOPE("estimate");
+		estimator.estimate(&env);
+
+		if(arguments.strategy == STRATEGY_AUTO) strategy = estimator.pick_strategy(targets);
+		else strategy = (Strategy)arguments.strategy;
+
+		for(auto t : targets) pure = pure && estimator.cost(t).pure;
+		if(strategy != STRATEGY_LAZY && !pure)
+			ErrorDispatcher().warning("Warning", "Caching arguments changes how often side effects happen.");
+	}
+
+
+	// optimize for the chosen strategy, the estimates then describe the optimized expressions
+	if(arguments.optimize)
+	{
+		uint64_t unoptimized = estimator.strategy_cost(targets, strategy);
+
+		Optimizer optimizer = Optimizer();
+		optimizer.inline_budget = arguments.inline_budget;
+		optimizer.fast_math = arguments.fast_math;
+
+		// a sweep only varies its addresses, everything else is solved once before it
+		Solver hoist = Solver();
+		configure(hoist, arguments, strategy);
+		if(!arguments.sweep.empty()) optimizer.hoist = &hoist;
+		for(auto& a : arguments.sweep) optimizer.varying.insert(a.addr);
+
+		optimizer.optimize(&env, strategy);
+		estimator.estimate(&env);
+
+		OptimizerStats& stats = optimizer.stats;
+		if(arguments.verbose) MSG("Optimized: " << stats.inlined << " call" << (stats.inlined == 1 ? "" : "s")
+			<< " inlined, " << stats.folded << " operation" << (stats.folded == 1 ? "" : "s") << " folded, "
+			<< stats.simplified << " rewrite" << (stats.simplified == 1 ? "" : "s") << " eliminating " << stats.eliminated << " nodes, "
+			<< stats.polynomials << " polynomial" << (stats.polynomials == 1 ? "" : "s") << " in Horner form, "
+			<< stats.nodes_before << " -> " << stats.nodes_after << " nodes (" << cost_str(unoptimized)
+			<< " -> " << cost_str(estimator.strategy_cost(targets, strategy)) << " estimated)");
+		if(arguments.verbose && optimizer.hoist) MSG("Hoisted " << stats.hoisted << " binding"
+			<< (stats.hoisted == 1 ? "" : "s") << ", call" << (stats.hoisted == 1 ? "" : "s") << " or root searches out of the sweep.");
 	}
-	if(!to_solve) { ERR("Could not solve for undefined variable 'main'."); ABORT(STATUS_SOLVE_ERROR); }
+
+	// the service looks up the constant addresses while the rest is prepared
+	if(env.resolver)
+	{
+		vector<uint> addrs;
+		set<uint> collected;
+		for(auto t : targets) for(auto a : AddressCollector().collect(t)) collected.insert(a);
+		for(auto a : collected) if(!is_bound(&env, a, false)) addrs.push_back(a);
+		resolver.prefetch(addrs);
+	}
+
+	// integral nodes are evaluated exactly
+	TypeInference inference = TypeInference();
+	inference.infer(&env);
+	if(arguments.verbose) MSG("Types: " << inference.integral << " of " << inference.nodes << " nodes integral");
+
+	static const char* strategy_names[] = {"lazy", "need", "memo"};
+	uint64_t cost = estimator.strategy_cost(targets, strategy);
+
+	if(arguments.verbose)
+	{
+		MSG("Cost estimates:");
+		for(auto s : env.symbols) MSG(tools::fstr("    %-16s %s", s->get_ident().c_str(),
+			estimator.describe(s).c_str()));
+
+		MSG("Evaluation strategy: " << strategy_names[strategy] << " (" << cost_str(cost) << " nodes estimated, "
+			<< cost_str(estimator.strategy_cost(targets, STRATEGY_LAZY)) << " when lazy)");
+	}
+
+	if(arguments.max_cost && cost > arguments.max_cost)
+	{
+		ERR("Estimated cost of " << cost_str(cost) << " nodes exceeds the limit of " << arguments.max_cost << ".");
+		ABORT(STATUS_LIMIT_ERROR);
+	}
+	if(arguments.warn_cost && cost > arguments.warn_cost)
+		ErrorDispatcher().warning("Warning", tools::fstr("Estimated cost of %s nodes exceeds %llu.",
+			cost_str(cost).c_str(), (unsigned long long)arguments.warn_cost).c_str());
 
 
 	// print
 	if(arguments.verbose > 1)
 	{
 		Printer printer = Printer();
-		string out = printer.print(to_solve);
-		MSG("Substituted expression: ");
+		MSG("Substituted expression" << (targets.size() == 1 ? "" : "s") << ": ");
 		// MSG("");
-		MSG("    " << out);
+		for(auto t : targets) MSG("    " << printer.print(t));
 		// MSG("");
 	}
 
 
+	// the shared tables as they are now, every request of a server gets them anew
+	refresh_shared(&env);
+
+
+	// solve with the partial derivatives, the value and derivatives are the only output
+	if(!arguments.gradient.empty())
+	{
+		for(auto a : arguments.gradient) if(!is_bound(&env, a))
+			{ ERR(tools::fstr("No value bound to address 0x%x (%u).", a, a)); ABORT(STATUS_CLI_ERROR); }
+
+		GradientSolver solver = GradientSolver();
+		configure(solver, arguments, strategy);
+		status = solver.solve(&env, to_solve, arguments.gradient);
+		ABORT_IF_UNSUCCESSFULL();
+		if(arguments.verbose) report_roots(solver.root_stats);
+		if(arguments.verbose) report_resolver(env.resolver);
+
+		printf("value %.17g\n", solver.result);
+		for(size_t i = 0; i < arguments.gradient.size(); i++)
+			printf("0x%02x  %.17g\n", arguments.gradient[i], solver.gradient[i]);
+
+		free((void*)source);
+		return STATUS_SUCCESS;
+	}
+
+
+	// solve for every sample, only the summary of the results is kept and printed
+	if(arguments.samples)
+	{
+		// side effects keep the order of the samples
+		uint threads = arguments.threads ? arguments.threads : max(1u, thread::hardware_concurrency());
+		if(!pure) threads = 1;
+
+		Summary summary;
+		RootStats roots;
+		if(arguments.float32)
+		{
+			BatchSolver<float> solver = BatchSolver<float>();
+			configure(solver, arguments, strategy, threads);
+			status = simulate(&env, to_solve, arguments.samples, solver, summary);
+			roots = solver.root_stats;
+		}
+		else
+		{
+			BatchSolver<double> solver = BatchSolver<double>();
+			configure(solver, arguments, strategy, threads);
+			status = simulate(&env, to_solve, arguments.samples, solver, summary);
+			roots = solver.root_stats;
+		}
+		ABORT_IF_UNSUCCESSFULL();
+
+		static const double quantiles[] = {0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99};
+		printf("samples %llu\n", (unsigned long long)summary.count);
+		if(summary.nonfinite) printf("nonfinite %llu\n", (unsigned long long)summary.nonfinite);
+		printf("mean %.17g\n", summary.mean);
+		printf("deviation %.17g\n", sqrt(summary.variance()));
+		printf("min %.17g\n", summary.min);
+		for(auto q : quantiles) printf("p%g %.17g\n", q * 100, summary.quantile(q));
+		printf("max %.17g\n", summary.max);
+		for(auto& bar : summary.histogram(MONTE_CARLO_BARS))
+			printf("bin %.9g %.9g %llu\n", bar.lo, bar.hi, (unsigned long long)bar.count);
+
+		if(arguments.verbose) MSG("Solved " << arguments.samples << " sample" << (arguments.samples == 1 ? "" : "s")
+			<< " on " << threads << " thread" << (threads == 1 ? "" : "s") << ".");
+		if(arguments.verbose) report_roots(roots);
+		if(arguments.verbose) report_resolver(env.resolver);
+
+		free((void*)source);
+		return STATUS_SUCCESS;
+	}
+
+
+	// solve every row of the batch or every point of the sweep, the results are the only output
+	if(arguments.batch_file || !arguments.sweep.empty())
+	{
+		Batch batch;
+		if(!arguments.sweep.empty()) batch = sweep_grid(arguments.sweep);
+		else if(!read_batch(arguments.batch_file, batch)) ABORT(STATUS_CLI_ERROR);
+
+		// side effects keep the order of the rows
+		uint threads = arguments.threads ? arguments.threads : max(1u, thread::hardware_concurrency());
+		if(!pure) threads = 1;
+
+		vector<double> results;
+		RootStats roots;
+		if(arguments.float32)
+		{
+			BatchSolver<float> solver = BatchSolver<float>();
+			configure(solver, arguments, strategy, threads);
+			status = solver.solve(&env, targets, batch);
+			results = solver.results;
+			roots = solver.root_stats;
+		}
+		else
+		{
+			BatchSolver<double> solver = BatchSolver<double>();
+			configure(solver, arguments, strategy, threads);
+			status = solver.solve(&env, targets, batch);
+			results = solver.results;
+			roots = solver.root_stats;
+		}
+		ABORT_IF_UNSUCCESSFULL();
+
+		// a sweep is a table of the swept values and the results, with --solve every row of a batch is a record
+		const char* format = arguments.float32 ? "%.9g" : "%.17g";
+		size_t n = targets.size();
+		if(!arguments.sweep.empty())
+		{
+			for(auto a : batch.addrs) printf("0x%02x,", a);
+			for(size_t k = 0; k < n; k++) printf("%s%s", names[k].c_str(), k + 1 < n ? "," : "\n");
+		}
+		for(size_t row = 0; row < batch.rows; row++)
+		{
+			if(arguments.sweep.empty() && !arguments.solve.empty()) { print_record(names, &results[row * n], format); continue; }
+
+			if(!arguments.sweep.empty()) for(auto& c : batch.columns) printf("%.17g,", c[row]);
+			for(size_t k = 0; k < n; k++) { printf(format, results[row * n + k]); printf(k + 1 < n ? "," : "\n"); }
+		}
+		if(arguments.verbose) MSG("Solved " << batch.rows << " row" << (batch.rows == 1 ? "" : "s")
+			<< " on " << threads << " thread" << (threads == 1 ? "" : "s") << ".");
+		if(arguments.verbose) report_roots(roots);
+		if(arguments.verbose) report_resolver(env.resolver);
+
+		free((void*)source);
+		return STATUS_SUCCESS;
+	}
+
+
 	// solve
 	Solver solver = Solver();
-	status = solver.solve(&env, to_solve);
-	ABORT_IF_UNSUCCESSFULL();
-	if(arguments.verbose) { MSG("Result of solved expression: " << solver.result); }
+	configure(solver, arguments, strategy);
+
+	// the parsed and optimized program and the stacks of the solver stay for every request
+	if(arguments.serve)
+	{
+		status = serve(&env, to_solve, solver, arguments.framing);
+		ABORT_IF_UNSUCCESSFULL();
+		if(arguments.verbose) report_roots(solver.root_stats());
+		if(arguments.verbose) report_resolver(env.resolver);
+
+		free((void*)source);
+		return STATUS_SUCCESS;
+	}
+
+	// the results of given symbols are the output
+	if(!arguments.solve.empty())
+	{
+		status = solver.solve(&env, targets);
+		ABORT_IF_UNSUCCESSFULL();
+		print_record(names, solver.results.data(), "%.17g");
+	}
+	else
+	{
+		status = solver.solve(&env, to_solve);
+		ABORT_IF_UNSUCCESSFULL();
+		if(arguments.verbose) { MSG("Result of solved expression: " << solver.result); }
+	}
+	if(arguments.verbose) report_roots(solver.root_stats());
+	if(arguments.verbose) report_resolver(env.resolver);
 
 
 	free((void*)source);
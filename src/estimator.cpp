@@ -0,0 +1,418 @@
+#include "estimator.hpp"
+#include "tools.hpp"
+
+// ==================================================
+
+static uint64_t sat_add(uint64_t a, uint64_t b)
+{
+	//
+	return a > COST_INFINITE - b ? COST_INFINITE : a + b;
+}
+
+static uint64_t sat_mul(uint64_t a, uint64_t b)
+{
+	//
+	return a && b > COST_INFINITE / a ? COST_INFINITE : a * b;
+}
+
+#define NESTING_INFINITE ((int64_t)1 << 40)
+#define NESTING_ADD(a, b) min<int64_t>((a) + (b), NESTING_INFINITE)
+
+string cost_str(uint64_t cost)
+{
+	//
+	return cost == COST_INFINITE ? "inf" : to_string(cost);
+}
+
+static string nesting_str(int64_t nesting)
+{
+	//
+	return nesting == NESTING_INFINITE ? "inf" : to_string(nesting);
+}
+
+// ==================================================
+
+void CostEstimator::estimate(Environment* env)
+{
+	_costs.clear();
+	_env = env;
+
+	// symbols only refer to symbols defined before them
+	for(auto s : env->symbols)
+	{
+		_arity = s->target.params.size();
+		s->body->accept(this);
+		_costs[s] = _result;
+	}
+}
+
+Cost& CostEstimator::cost(Symbol* symbol)
+{
+	//
+	return _costs.at(symbol);
+}
+
+// cost of a referenced symbol, unbounded if the symbol refers to itself
+Cost CostEstimator::callee_cost(Symbol* symbol)
+{
+	auto it = _costs.find(symbol);
+	if(it != _costs.end()) return it->second;
+
+	// nothing is known about how deep the recursion goes
+	size_t arity = symbol->target.params.size();
+	Cost c;
+	c.lazy = Affine{COST_INFINITE, vector<uint64_t>(arity, COST_INFINITE)};
+	c.need = c.local = Affine{COST_INFINITE, vector<uint64_t>(arity, 1)};
+	c.nesting = Nesting{NESTING_INFINITE, vector<int64_t>(arity, NESTING_INFINITE)};
+	c.pure = true; // decided by the rest of the body
+	return c;
+}
+
+// estimated number of evaluated nodes when solving a parameterless symbol
+uint64_t CostEstimator::strategy_cost(Symbol* symbol, Strategy strategy)
+{
+	Cost& c = cost(symbol);
+	switch(strategy)
+	{
+		case STRATEGY_LAZY: return c.lazy.base;
+		case STRATEGY_NEED: return c.need.base;
+		case STRATEGY_MEMO:
+		{
+			// every reachable parameterless symbol is evaluated once
+			uint64_t total = c.local.base;
+			for(auto g : c.globals) total = sat_add(total, cost(g).local.base);
+			return total;
+		}
+		default: THROW_INTERNAL_ERROR("during cost estimation");
+	}
+	return COST_INFINITE;
+}
+
+Strategy CostEstimator::pick_strategy(Symbol* symbol)
+{
+	// caching would change how often side effects happen
+	if(!cost(symbol).pure) return STRATEGY_LAZY;
+
+	// weigh in the rough bookkeeping overhead per node of each strategy
+	uint64_t lazy = strategy_cost(symbol, STRATEGY_LAZY);
+	uint64_t need = strategy_cost(symbol, STRATEGY_NEED);
+	uint64_t memo = strategy_cost(symbol, STRATEGY_MEMO);
+	need = sat_add(need, need / 4);
+	memo = sat_add(memo, memo / 2);
+
+	// unbounded (recursive) models are cheapest with cached arguments
+	if(lazy == COST_INFINITE && need == COST_INFINITE) return STRATEGY_NEED;
+	if(lazy <= need && lazy <= memo) return STRATEGY_LAZY;
+	return need <= memo ? STRATEGY_NEED : STRATEGY_MEMO;
+}
+
+// solved together, the symbols share everything memoized
+uint64_t CostEstimator::strategy_cost(const vector<Symbol*>& symbols, Strategy strategy)
+{
+	uint64_t total = 0;
+	if(strategy != STRATEGY_MEMO)
+	{
+		for(auto s : symbols) total = sat_add(total, strategy_cost(s, strategy));
+		return total;
+	}
+
+	set<Symbol*> evaluated(symbols.begin(), symbols.end());
+	for(auto s : symbols) evaluated.insert(cost(s).globals.begin(), cost(s).globals.end());
+	for(auto s : evaluated) total = sat_add(total, cost(s).local.base);
+	return total;
+}
+
+Strategy CostEstimator::pick_strategy(const vector<Symbol*>& symbols)
+{
+	if(symbols.size() == 1) return pick_strategy(symbols[0]);
+
+	// only memoized symbols are shared between the symbols
+	for(auto s : symbols) if(!cost(s).pure) return STRATEGY_LAZY;
+	return STRATEGY_MEMO;
+}
+
+string CostEstimator::describe(Symbol* symbol)
+{
+	Cost& c = cost(symbol);
+	vector<string>& params = symbol->target.params;
+
+	string nodes = "nodes " + cost_str(c.lazy.base);
+	string refs;
+	for(size_t i = 0; i < params.size(); i++)
+	{
+		if(!c.lazy.coefs[i]) continue;
+		nodes += " + " + cost_str(c.lazy.coefs[i]) + "*" + params[i];
+		refs += (refs.empty() ? "refs " : ", ") + params[i] + ":" + cost_str(c.lazy.coefs[i]);
+	}
+
+	string nesting = "nesting " + nesting_str(c.nesting.base);
+	for(size_t i = 0; i < params.size(); i++)
+		if(c.nesting.params[i] >= 0) nesting += " | " + params[i] + "+" + nesting_str(c.nesting.params[i]);
+
+	return nodes + ", " + nesting + (refs.empty() ? "" : ", " + refs) + (c.pure ? "" : ", impure");
+}
+
+// ==================================================
+
+// cost of an expression of the given number of nodes, without arguments
+Cost CostEstimator::leaf(size_t nodes)
+{
+	Cost c;
+	c.lazy = c.need = c.local = Affine{nodes, vector<uint64_t>(_arity, 0)};
+	c.nesting = Nesting{0, vector<int64_t>(_arity, -1)};
+	c.pure = true;
+	return c;
+}
+
+// cost of evaluating both expressions
+void CostEstimator::merge(Cost& into, Cost& other)
+{
+	into.lazy.base = sat_add(into.lazy.base, other.lazy.base);
+	into.need.base = sat_add(into.need.base, other.need.base);
+	into.local.base = sat_add(into.local.base, other.local.base);
+	into.nesting.base = max(into.nesting.base, other.nesting.base);
+
+	for(size_t i = 0; i < _arity; i++)
+	{
+		into.lazy.coefs[i] = sat_add(into.lazy.coefs[i], other.lazy.coefs[i]);
+		into.need.coefs[i] |= other.need.coefs[i];
+		into.local.coefs[i] |= other.local.coefs[i];
+		into.nesting.params[i] = max(into.nesting.params[i], other.nesting.params[i]);
+	}
+
+	into.globals.insert(other.globals.begin(), other.globals.end());
+	into.pure &= other.pure;
+}
+
+// cost of evaluating either one of the expressions, at worst
+void CostEstimator::merge_either(Cost& into, Cost& other)
+{
+	into.lazy.base = max(into.lazy.base, other.lazy.base);
+	into.need.base = max(into.need.base, other.need.base);
+	into.local.base = max(into.local.base, other.local.base);
+	into.nesting.base = max(into.nesting.base, other.nesting.base);
+
+	for(size_t i = 0; i < _arity; i++)
+	{
+		into.lazy.coefs[i] = max(into.lazy.coefs[i], other.lazy.coefs[i]);
+		into.need.coefs[i] |= other.need.coefs[i];
+		into.local.coefs[i] |= other.local.coefs[i];
+		into.nesting.params[i] = max(into.nesting.params[i], other.nesting.params[i]);
+	}
+
+	into.globals.insert(other.globals.begin(), other.globals.end());
+	into.pure &= other.pure;
+}
+
+// =========================================
+// All visit methods MUST set _result!
+
+#define VISIT(_node) void CostEstimator::visit(_node* node)
+
+VISIT(AssignNode)
+{
+	// this kind of node should never be estimated
+	THROW_INTERNAL_ERROR("during cost estimation");
+}
+
+VISIT(BinaryNode)
+{
+	node->_left->accept(this);
+	Cost cost = _result;
+	node->_right->accept(this);
+	merge(cost, _result);
+
+	Cost self = leaf(1);
+	merge(cost, self);
+	_result = cost;
+}
+
+VISIT(LogicalNode)
+{
+	// the right operand may be skipped, but it is counted anyway
+	node->_left->accept(this);
+	Cost cost = _result;
+	node->_right->accept(this);
+	merge(cost, _result);
+
+	Cost self = leaf(1);
+	merge(cost, self);
+	_result = cost;
+}
+
+VISIT(UnaryNode)
+{
+	node->_expr->accept(this);
+	Cost self = leaf(1);
+	merge(_result, self);
+}
+
+VISIT(GroupingNode)
+{
+	node->_expr->accept(this);
+	Cost self = leaf(1);
+	merge(_result, self);
+}
+
+VISIT(ConditionalNode)
+{
+	node->_then->accept(this);
+	Cost branch = _result;
+	node->_else->accept(this);
+	merge_either(branch, _result);
+
+	node->_cond->accept(this);
+	Cost cost = _result;
+	merge(cost, branch);
+
+	Cost self = leaf(1);
+	merge(cost, self);
+	_result = cost;
+}
+
+VISIT(PolynomialNode)
+{
+	// one multiply-add per coefficient
+	node->_var->accept(this);
+	Cost self = leaf(node->_coefs.size());
+	merge(_result, self);
+}
+
+VISIT(NumberNode)
+{
+	//
+	_result = leaf(1);
+}
+
+VISIT(VariableNode)
+{
+	Cost c = leaf(1);
+	c.nesting.base = 1;
+
+	if(node->_symbol->id >= 0)
+	{
+		Cost body = callee_cost(node->_symbol);
+		c.lazy.base = sat_add(1, body.lazy.base);
+		c.need.base = sat_add(1, body.need.base);
+		c.nesting.base = NESTING_ADD(1, body.nesting.base);
+		c.globals = body.globals;
+		c.globals.insert(node->_symbol);
+		c.pure = body.pure;
+	}
+	else
+	{
+		// the argument is evaluated one nesting deeper
+		size_t param = -node->_symbol->id - 1;
+		c.lazy.coefs[param] = c.need.coefs[param] = c.local.coefs[param] = 1;
+		c.nesting.params[param] = 1;
+	}
+
+	_result = c;
+}
+
+VISIT(CallNode)
+{
+	Cost callee = callee_cost(node->_symbol);
+
+	vector<Cost> args;
+	for(auto a : node->_args) { a->accept(this); args.push_back(_result); }
+
+	Cost c = leaf(1);
+	c.lazy.base = sat_add(1, callee.lazy.base);
+	c.need.base = sat_add(1, callee.need.base);
+	c.local.base = sat_add(1, callee.local.base);
+	c.nesting.base = NESTING_ADD(1, callee.nesting.base);
+	c.globals = callee.globals;
+	c.pure = callee.pure;
+
+	// substitute the cost of the arguments into the callee's cost
+	for(size_t j = 0; j < args.size(); j++)
+	{
+		Cost& arg = args[j];
+
+		uint64_t refs = callee.lazy.coefs[j];
+		c.lazy.base = sat_add(c.lazy.base, sat_mul(refs, arg.lazy.base));
+		for(size_t i = 0; i < _arity; i++)
+			c.lazy.coefs[i] = sat_add(c.lazy.coefs[i], sat_mul(refs, arg.lazy.coefs[i]));
+
+		// arguments that are never referenced are never evaluated
+		if(!refs) continue;
+
+		c.need.base = sat_add(c.need.base, arg.need.base);
+		c.local.base = sat_add(c.local.base, arg.local.base);
+		for(size_t i = 0; i < _arity; i++)
+		{
+			c.need.coefs[i] |= arg.need.coefs[i];
+			c.local.coefs[i] |= arg.local.coefs[i];
+		}
+
+		int64_t depth = callee.nesting.params[j];
+		c.nesting.base = max(c.nesting.base, NESTING_ADD(1 + depth, arg.nesting.base));
+		for(size_t i = 0; i < _arity; i++) if(arg.nesting.params[i] >= 0)
+			c.nesting.params[i] = max(c.nesting.params[i], NESTING_ADD(1 + depth, arg.nesting.params[i]));
+
+		c.globals.insert(arg.globals.begin(), arg.globals.end());
+		c.pure &= arg.pure;
+	}
+
+	_result = c;
+}
+
+VISIT(ActionNode)
+{
+	Cost c = leaf(1);
+	c.pure = node->_action->pure;
+
+	for(auto a : node->_args)
+	{
+		a->accept(this);
+		merge(c, _result);
+	}
+
+	_result = c;
+}
+
+VISIT(RootNode)
+{
+	node->_lo->accept(this);
+	Cost cost = _result;
+	node->_hi->accept(this);
+	merge(cost, _result);
+
+	// f is called with a single node for its parameter, a typical number of times
+	Cost callee = callee_cost(node->_symbol);
+	Cost c = leaf(1);
+	c.lazy.base = sat_mul(ROOT_EXPECTED_EVALUATIONS, sat_add(callee.lazy.base, callee.lazy.coefs[0]));
+	c.need.base = sat_mul(ROOT_EXPECTED_EVALUATIONS, sat_add(callee.need.base, 1));
+	c.local.base = sat_mul(ROOT_EXPECTED_EVALUATIONS, sat_add(callee.local.base, 1));
+	c.nesting.base = NESTING_ADD(1, max<int64_t>(callee.nesting.base, callee.nesting.params[0]));
+	c.globals = callee.globals;
+	c.pure = callee.pure;
+	merge(cost, c);
+	_result = cost;
+}
+
+VISIT(MapNode)
+{
+	node->_array->accept(this);
+	Cost cost = _result;
+
+	// f is called once per value, like by the root search
+	uint64_t values = MAP_EXPECTED_VALUES;
+	NumberNode* addr = dynamic_cast<NumberNode*>(node->_array);
+	if(addr && addr->_value == (uint)addr->_value && _env->bindings.count(addr->_value) && _env->bindings[addr->_value].type == BoundValue::ARRAY)
+		values = _env->bindings[addr->_value].as.arr.size;
+
+	Cost callee = callee_cost(node->_symbol);
+	Cost c = leaf(1);
+	c.lazy.base = sat_mul(values, sat_add(callee.lazy.base, callee.lazy.coefs[0]));
+	c.need.base = sat_mul(values, sat_add(callee.need.base, 1));
+	c.local.base = sat_mul(values, sat_add(callee.local.base, 1));
+	c.nesting.base = NESTING_ADD(1, max<int64_t>(callee.nesting.base, callee.nesting.params[0]));
+	c.globals = callee.globals;
+	c.pure = callee.pure;
+	merge(cost, c);
+	_result = cost;
+}
+
+#undef VISIT
@@ -0,0 +1,551 @@
+#include "gradient.hpp"
+#include "tracer.hpp"
+#include "perfcounters.hpp"
+#include "allocstats.hpp"
+#include "error.hpp"
+#include "tools.hpp"
+#include "builtins.hpp"
+
+GradientSolver::GradientSolver()
+{
+	// preallocate so that solving does not have to
+	_frames.reserve(SOLVER_FRAME_STACK_INIT);
+	_arg_ready.reserve(SOLVER_FRAME_STACK_INIT);
+}
+
+// resets the stacks for a solve with tangents of the given addresses
+void GradientSolver::start(Environment* env, Symbol* symbol, const vector<uint>& addrs)
+{
+	result = nan("<no result>");
+	gradient.assign(addrs.size(), nan("<no result>"));
+	_env = env;
+	_get = get_action("get");
+
+	// the lane of the parameter of f follows the addresses
+	_seeds.clear();
+	for(size_t i = 0; i < addrs.size(); i++) _seeds[addrs[i]] = i;
+	_tangents = (addrs.size() + 1 + GRADIENT_LANES - 1) / GRADIENT_LANES * GRADIENT_LANES;
+	_stride = 1 + _tangents;
+	_slope = 1 + addrs.size();
+
+	// the stack only grows when the slots get wider or the expressions deeper
+	if(_stack.size() < SOLVER_VALUE_STACK_INIT * _stride) _stack.resize(SOLVER_VALUE_STACK_INIT * _stride);
+	_arg_values.clear();
+	_arg_ready.clear();
+	_frames.clear();
+	_slots = 0;
+	_max_depth = 0;
+
+	// top-level frame without arguments
+	_frames.push_back(Frame{nullptr, 0, symbol, 0, 0});
+	_frame = 0;
+	_path = 0;
+	_element = 0;
+
+	// a new epoch invalidates all memoized symbols at once
+	_epoch++;
+	if(strategy == STRATEGY_MEMO)
+	{
+		_memo_values.resize(env->symbols.size() * _stride);
+		_memo_epochs.resize(env->symbols.size(), 0);
+	}
+}
+
+Status GradientSolver::solve(Environment* env, Symbol* symbol, const vector<uint>& addrs)
+{
+	TRACE_SCOPE("solve gradient");
+	PERF_SCOPE("solve gradient");
+	ALLOC_SCOPE("solve gradient");
+
+	// the native stack is measured from here
+	start(env, symbol, addrs);
+	_budget.start(limits, symbol);
+
+	symbol->body->accept(this);
+	double* slot = top();
+	result = isnan(slot[0]) ? nan("<NaN>") : slot[0];
+	for(size_t i = 0; i < addrs.size(); i++) gradient[i] = slot[1 + i];
+	pop();
+
+	TRACE_COUNTER("value stack depth", _max_depth);
+	TRACE_COUNTER("evaluation steps", _budget.steps);
+
+	return _budget.status;
+}
+
+// finds a root of f between lo and hi for the solver, on the solver's budget, drawing for the path of f
+Status GradientSolver::solve_root(Environment* env, Symbol* f, double lo, double hi, uint32_t path, Budget& budget)
+{
+	start(env, f, {});
+	_budget = budget;
+
+	result = search(f, lo, hi, path);
+	if(isnan(result)) result = nan("<NaN>");
+
+	budget = _budget;
+	return _budget.status;
+}
+
+// a root of f, with Newton steps along the slope in the lane of the parameter
+double GradientSolver::search(Symbol* f, double lo, double hi, uint32_t path)
+{
+	RootSearch search;
+	root_stats.roots++;
+	root_stats.evaluations += 2;
+
+	call(f, lo, path, _element);
+	double flo = top()[0], slo = top()[_slope];
+	pop();
+	call(f, hi, path, _element);
+	double fhi = top()[0], shi = top()[_slope];
+	pop();
+
+	bool done = search.start(lo, flo, slo, hi, fhi, shi, root_controls);
+	while(!done && _budget.status == STATUS_SUCCESS)
+	{
+		double x = search.next();
+		root_stats.evaluations++;
+		call(f, x, path, _element);
+		done = search.update(x, top()[0], top()[_slope]);
+		pop();
+	}
+
+	if(isnan(search.root)) root_stats.failures++;
+	return _budget.status == STATUS_SUCCESS ? search.root : NAN;
+}
+
+// pushes f(x), with a unit tangent for x in the lane of the parameter, drawing for the given path and element
+void GradientSolver::call(Symbol* f, double x, uint32_t path, size_t element)
+{
+	Symbol* symbol = _budget.symbol;
+
+	// a frame without argument expressions, its only argument is always ready
+	size_t caller = _frame;
+	size_t cache = _arg_ready.size();
+	size_t outer = _element;
+	_frames.push_back(Frame{nullptr, caller, symbol, cache, _path});
+	_frame = _frames.size() - 1;
+	_path = path;
+	_element = element;
+
+	_arg_values.resize((cache + 1) * _stride, 0);
+	_arg_ready.resize(cache + 1);
+	double* arg = &_arg_values[cache * _stride];
+	arg[0] = x;
+	for(size_t k = 1; k < _stride; k++) arg[k] = k == _slope;
+	_arg_ready[cache] = 1;
+
+	if(_budget.enter(f)) f->body->accept(this);
+	else push_constant(NAN);
+
+	_arg_values.resize(cache * _stride);
+	_arg_ready.resize(cache);
+	_path = _frames.back().path;
+	_element = outer;
+	_frames.pop_back();
+	_frame = caller;
+	_budget.nesting--;
+	_budget.symbol = symbol;
+}
+
+// the path the random actions draw for, which tells the values of a @map apart
+uint32_t GradientSolver::draw_path()
+{
+	//
+	return _element ? element_path(_path, _element - 1) : _path;
+}
+
+size_t GradientSolver::memory()
+{
+	//
+	return (_slots * _stride + _arg_values.size()) * sizeof(double) + _frames.size() * sizeof(Frame);
+}
+
+// a new slot on top of the stack, left for the caller to fill
+double* GradientSolver::push()
+{
+	if((_slots + 1) * _stride > _stack.size()) _stack.resize(_stack.size() * 2);
+	if(++_slots > _max_depth) _max_depth = _slots;
+	return top();
+}
+
+// pointers into the stack are only valid until the next push
+double* GradientSolver::top(size_t below)
+{
+	ASSERT_OR_THROW_INTERNAL_ERROR(_slots > below, "during solving");
+	return _stack.data() + (_slots - 1 - below) * _stride;
+}
+
+void GradientSolver::pop()
+{
+	ASSERT_OR_THROW_INTERNAL_ERROR(_slots, "during solving");
+	_slots--;
+}
+
+void GradientSolver::push_constant(double value)
+{
+	double* slot = push();
+	slot[0] = value;
+	for(size_t k = 1; k < _stride; k++) slot[k] = 0;
+}
+
+void GradientSolver::push_copy(const double* from)
+{
+	double* slot = push();
+	memcpy(slot, from, _stride * sizeof(double));
+}
+
+// the value of an expression without its tangent
+double GradientSolver::value(ExprNode* expr)
+{
+	expr->accept(this);
+	double value = top()[0];
+	pop();
+	return value;
+}
+
+// =========================================
+// All visit methods MUST push a slot!
+
+#define VISIT(_node) void GradientSolver::visit(_node* node)
+
+// counts the step and bails out once a limit has been exceeded
+#define CHECK_BUDGET() if(++_budget.steps >= _budget.next_check && !_budget.check(memory())) { push_constant(NAN); return; }
+
+VISIT(AssignNode)
+{
+	// this kind of node should never be solved for
+	THROW_INTERNAL_ERROR("during solving");
+}
+
+VISIT(BinaryNode)
+{
+	CHECK_BUDGET();
+	node->_left->accept(this);
+	node->_right->accept(this);
+
+	// the result replaces the left operand
+	double* lhs = top(1);
+	double* rhs = top();
+	double x = lhs[0], y = rhs[0];
+	double value = apply_binary(node->_optype, x, y);
+	double* dx = lhs + 1;
+	const double* dy = rhs + 1;
+	size_t n = _tangents;
+
+	switch(node->_optype)
+	{
+		case TOKEN_PLUS:  for(size_t k = 0; k < n; k++) dx[k] += dy[k]; break;
+		case TOKEN_MINUS: for(size_t k = 0; k < n; k++) dx[k] -= dy[k]; break;
+		case TOKEN_STAR:  for(size_t k = 0; k < n; k++) dx[k] = y * dx[k] + x * dy[k]; break;
+		case TOKEN_SLASH: for(size_t k = 0; k < n; k++) dx[k] = (dx[k] - value * dy[k]) / y; break;
+		case TOKEN_CARET:
+		{
+			// d(x^y) = y x^(y-1) dx + x^y ln(x) dy, the second term only if the exponent varies
+			double by_base = y == 0 ? 0 : y * power(x, y - 1);
+			bool varies = false;
+			for(size_t k = 0; k < n; k++) varies |= dy[k] != 0;
+
+			if(varies)
+			{
+				double by_exponent = value * log(x);
+				for(size_t k = 0; k < n; k++) dx[k] = by_base * dx[k] + by_exponent * dy[k];
+			}
+			else for(size_t k = 0; k < n; k++) dx[k] *= by_base;
+			break;
+		}
+
+		// comparisons are constant almost everywhere
+		default: for(size_t k = 0; k < n; k++) dx[k] = 0; break;
+	}
+
+	lhs[0] = value;
+	pop();
+}
+
+VISIT(LogicalNode)
+{
+	CHECK_BUDGET();
+	double lhs = value(node->_left);
+
+	// the right operand is skipped if the left one decides the result
+	switch(node->_optype)
+	{
+		case TOKEN_AND: if(lhs == 0) { push_constant(0); return; } break;
+		case TOKEN_OR:  if(lhs != 0) { push_constant(1); return; } break;
+		default: THROW_INTERNAL_ERROR("during solving");
+	}
+
+	push_constant(value(node->_right) != 0);
+}
+
+VISIT(UnaryNode)
+{
+	CHECK_BUDGET();
+	node->_expr->accept(this);
+
+	double* slot = top();
+	slot[0] = apply_unary(node->_optype, slot[0]);
+	for(size_t k = 1; k < _stride; k++) slot[k] = -slot[k];
+}
+
+VISIT(GroupingNode)
+{
+	CHECK_BUDGET();
+
+	// just accept expr inside
+	node->_expr->accept(this);
+}
+
+VISIT(ConditionalNode)
+{
+	CHECK_BUDGET();
+
+	// only the taken branch is evaluated, and only its tangent counts
+	if(value(node->_cond) != 0) node->_then->accept(this);
+	else node->_else->accept(this);
+}
+
+VISIT(PolynomialNode)
+{
+	CHECK_BUDGET();
+	node->_var->accept(this);
+
+	// the derivative in Horner form alongside
+	double* slot = top();
+	double x = slot[0];
+	const vector<double>& coefs = node->_coefs;
+	double value = coefs.back(), derivative = 0;
+	for(size_t i = coefs.size() - 1; i-- > 0; )
+	{
+		derivative = derivative * x + value;
+		value = value * x + coefs[i];
+	}
+
+	slot[0] = horner(coefs, x);
+	for(size_t k = 1; k < _stride; k++) slot[k] *= derivative;
+}
+
+VISIT(NumberNode)
+{
+	CHECK_BUDGET();
+
+	// just push the node's value
+	push_constant(node->_value);
+}
+
+VISIT(VariableNode)
+{
+	CHECK_BUDGET();
+	Symbol* symbol = _budget.symbol;
+
+	if(node->_symbol->id >= 0)
+	{
+		double* memo = _memo_values.data() + node->_symbol->index * _stride;
+		uint64_t* epoch = strategy == STRATEGY_MEMO ? &_memo_epochs[node->_symbol->index] : nullptr;
+		if(epoch && *epoch == _epoch) { push_copy(memo); return; }
+
+		// parameterless symbols draw the same wherever they are used
+		uint32_t path = _path;
+		size_t element = _element;
+		_path = 0;
+		_element = 0;
+		if(_budget.enter(node->_symbol)) node->_symbol->body->accept(this);
+		else push_constant(NAN);
+		_path = path;
+		_element = element;
+
+		if(epoch)
+		{
+			memcpy(memo, top(), _stride * sizeof(double));
+			*epoch = _epoch;
+		}
+	}
+	else
+	{
+		size_t callee = _frame;
+		size_t param = -node->_symbol->id - 1;
+		size_t slot = _frames[callee].cache + param;
+		bool ready = !_frames[callee].args || (strategy != STRATEGY_LAZY && _arg_ready[slot]);
+		if(ready) { push_copy(&_arg_values[slot * _stride]); return; }
+
+		// arguments are evaluated in the frame of their call site
+		ExprNode* arg = (*_frames[callee].args)[param];
+		uint32_t path = _path;
+
+		_frame = _frames[callee].caller;
+		_path = _frames[callee].path;
+		if(_budget.enter(_frames[callee].caller_symbol)) arg->accept(this);
+		else push_constant(NAN);
+		_frame = callee;
+		_path = path;
+
+		if(strategy != STRATEGY_LAZY)
+		{
+			memcpy(&_arg_values[slot * _stride], top(), _stride * sizeof(double));
+			_arg_ready[slot] = 1;
+		}
+	}
+
+	_budget.nesting--;
+	_budget.symbol = symbol;
+}
+
+VISIT(CallNode)
+{
+	CHECK_BUDGET();
+	Symbol* symbol = _budget.symbol;
+
+	// set args
+	size_t caller = _frame;
+	size_t cache = _arg_ready.size();
+	_frames.push_back(Frame{&node->_args, caller, symbol, cache, _path});
+	_frame = _frames.size() - 1;
+	_path = call_path(_path, &node->_token);
+
+	if(strategy != STRATEGY_LAZY)
+	{
+		_arg_values.resize((cache + node->_args.size()) * _stride);
+		_arg_ready.resize(cache + node->_args.size(), 0);
+	}
+
+	// visit body
+	if(_budget.enter(node->_symbol)) node->_symbol->body->accept(this);
+	else push_constant(NAN);
+
+	if(strategy != STRATEGY_LAZY)
+	{
+		_arg_values.resize(cache * _stride);
+		_arg_ready.resize(cache);
+	}
+
+	_path = _frames.back().path;
+	_frames.pop_back();
+	_frame = caller;
+	_budget.nesting--;
+	_budget.symbol = symbol;
+}
+
+VISIT(ActionNode)
+{
+	CHECK_BUDGET();
+	const Action* action = node->_action;
+	if(action->partials) { differentiate(node); return; }
+
+	// integral actions are constant almost everywhere, the others have no derivative
+	if(action != _get && !action->integral)
+	{
+		ErrorDispatcher().error_at_token(&node->_token, "Runtime Error",
+			tools::fstr("Cannot differentiate @%s.", node->_action->name.c_str()).c_str());
+		ABORT(STATUS_SOLVE_ERROR);
+	}
+
+	size_t base = _action_args.size();
+	for(auto a : node->_args) _action_args.push_back(value(a));
+
+	// don't run handlers on the NaNs of an aborted solve
+	if(_budget.status != STATUS_SUCCESS) { _action_args.resize(base); push_constant(NAN); return; }
+
+	double* args = _action_args.data() + base;
+	_env->path = draw_path();
+	push_constant(call_action(node->_action, &node->_token, _env, args));
+
+	// reading one of the addresses starts its tangent
+	if(node->_action == _get && args[0] == (uint)args[0])
+	{
+		auto seed = _seeds.find((uint)args[0]);
+		if(seed != _seeds.end()) top()[1 + seed->second] = 1;
+	}
+	_action_args.resize(base);
+}
+
+// actions with partial derivatives combine the tangents of their arguments by them
+void GradientSolver::differentiate(ActionNode* node)
+{
+	size_t n = node->_args.size();
+	for(auto a : node->_args) a->accept(this);
+
+	// the arguments are slots in a row on the stack, the result replaces the first one, or a constant one without arguments
+	if(!n) push_constant(0);
+	double* slots = top(n ? n - 1 : 0);
+	size_t base = _action_args.size();
+	_action_args.resize(base + 2 * n);
+	double* args = _action_args.data() + base;
+	double* partials = args + n;
+	for(size_t i = 0; i < n; i++) args[i] = slots[i * _stride];
+
+	double value = NAN;
+	if(_budget.status == STATUS_SUCCESS)
+	{
+		_env->path = draw_path();
+		value = call_action(node->_action, &node->_token, _env, args);
+		node->_action->partials(args, value, partials);
+	}
+
+	// constant arguments add nothing, even where their partial is not finite
+	for(size_t k = 1; k < _stride; k++)
+	{
+		double sum = 0;
+		for(size_t i = 0; i < n; i++)
+		{
+			double dx = slots[i * _stride + k];
+			sum += dx != 0 ? partials[i] * dx : 0;
+		}
+		slots[k] = sum;
+	}
+
+	slots[0] = value;
+	for(size_t i = 1; i < n; i++) pop();
+	_action_args.resize(base);
+}
+
+VISIT(RootNode)
+{
+	CHECK_BUDGET();
+	double lo = value(node->_lo);
+	double hi = value(node->_hi);
+	uint32_t path = call_path(_path, &node->_token);
+	double root = search(node->_symbol, lo, hi, path);
+
+	// f(root) = 0 wherever the bound values move, so the root moves by -(df/da) / (df/dx)
+	if(!_seeds.empty() && !isnan(root))
+	{
+		root_stats.evaluations++;
+		call(node->_symbol, root, path, _element);
+		double* slot = top();
+		double slope = slot[_slope];
+		for(size_t k = 1; k < _stride; k++) slot[k] = -slot[k] / slope;
+
+		// f is a function of its parameter alone, which is not the parameter of an enclosing search
+		slot[0] = root;
+		slot[_slope] = 0;
+	}
+	else
+	{
+		push_constant(root);
+		if(isnan(root)) for(size_t k = 1; k < _stride; k++) top()[k] = NAN;
+	}
+}
+
+VISIT(MapNode)
+{
+	CHECK_BUDGET();
+	double array = value(node->_array);
+	if(_budget.status != STATUS_SUCCESS) { push_constant(NAN); return; }
+	BoundArray values = get_bound_array(&node->_token, _env, array);
+
+	// the values of the array are constants, the tangents of f by the bound values add up
+	uint32_t path = call_path(draw_path(), &node->_token);
+	push_constant(0);
+	for(size_t i = 0; i < values.size && _budget.status == STATUS_SUCCESS; i++)
+	{
+		call(node->_symbol, values.data[i], path, i + 1);
+		double* fx = top();
+		double* sum = top(1);
+		for(size_t k = 0; k < _stride; k++) if(k != _slope) sum[k] += fx[k];
+		pop();
+	}
+	if(_budget.status != STATUS_SUCCESS) top()[0] = NAN;
+}
+
+#undef VISIT
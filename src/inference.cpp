@@ -0,0 +1,220 @@
+#include "inference.hpp"
+#include "tracer.hpp"
+
+#include <cmath>
+
+// ==================================================
+
+static Range floating()
+{
+	//
+	return Range{TYPE_FLOAT, -INFINITY, INFINITY};
+}
+
+// an integral range, unless it is too wide to be proven free of overflow
+static Range integer(double lo, double hi)
+{
+	if(!(lo >= -TYPE_INT_LIMIT && hi <= TYPE_INT_LIMIT)) return floating();
+	return Range{TYPE_INT, lo, hi};
+}
+
+static Range boolean()
+{
+	//
+	return Range{TYPE_INT, 0, 1};
+}
+
+// integers have no negative zero, so -0 stays a float
+static bool whole(double value)
+{
+	//
+	return value == floor(value) && fabs(value) <= TYPE_INT_LIMIT && !signbit(value);
+}
+
+static bool has_zero(Range range)
+{
+	//
+	return range.lo <= 0 && range.hi >= 0;
+}
+
+// ==================================================
+
+void TypeInference::infer(Environment* env)
+{
+	TRACE_SCOPE("infer types");
+
+	_ranges.clear();
+	nodes = integral = 0;
+
+	// symbols only refer to symbols defined before them, or to themselves
+	for(auto s : env->symbols)
+	{
+		s->body->accept(this);
+		_ranges[s] = _result;
+	}
+
+	TRACE_COUNTER("integral nodes", integral);
+}
+
+// range of a referenced symbol, a float if the symbol refers to itself
+Range TypeInference::symbol_range(Symbol* symbol)
+{
+	auto it = _ranges.find(symbol);
+	return it != _ranges.end() ? it->second : floating();
+}
+
+void TypeInference::annotate(ExprNode* node, Range range)
+{
+	node->_type = range.type;
+	nodes++;
+	if(range.type == TYPE_INT) integral++;
+	_result = range;
+}
+
+// =========================================
+// All visit methods MUST annotate the node!
+
+#define VISIT(_node) void TypeInference::visit(_node* node)
+
+VISIT(AssignNode)
+{
+	// this kind of node should never be typed
+	THROW_INTERNAL_ERROR("during type inference");
+}
+
+VISIT(BinaryNode)
+{
+	node->_left->accept(this);
+	Range l = _result;
+	node->_right->accept(this);
+	Range r = _result;
+
+	bool ints = l.type == TYPE_INT && r.type == TYPE_INT;
+	switch(node->_optype)
+	{
+		case TOKEN_EQUAL_EQUAL:
+		case TOKEN_SLASH_EQUAL:
+		case TOKEN_GREATER_EQUAL:
+		case TOKEN_LESS_EQUAL:
+		case TOKEN_GREATER:
+		case TOKEN_LESS:
+			annotate(node, boolean());
+			return;
+
+		case TOKEN_PLUS:
+			annotate(node, ints ? integer(l.lo + r.lo, l.hi + r.hi) : floating());
+			return;
+
+		case TOKEN_MINUS:
+			annotate(node, ints ? integer(l.lo - r.hi, l.hi - r.lo) : floating());
+			return;
+
+		case TOKEN_STAR:
+		{
+			// zero times a negative number is -0
+			if(!ints || (has_zero(l) && r.lo < 0) || (has_zero(r) && l.lo < 0)) break;
+			double a = l.lo * r.lo, b = l.lo * r.hi, c = l.hi * r.lo, d = l.hi * r.hi;
+			annotate(node, integer(min(min(a, b), min(c, d)), max(max(a, b), max(c, d))));
+			return;
+		}
+
+		case TOKEN_CARET:
+		{
+			// only constant exponents, which keep the bounds at the bounds of the base
+			if(!ints || r.lo != r.hi || r.lo < 0 || r.lo > 64) break;
+			double a = pow(l.lo, r.lo), b = pow(l.hi, r.lo);
+			double lo = l.lo < 0 && l.hi > 0 ? min(min(a, b), 0.0) : min(a, b);
+			annotate(node, integer(lo, max(a, b)));
+			return;
+		}
+
+		default: break;
+	}
+
+	annotate(node, floating());
+}
+
+VISIT(LogicalNode)
+{
+	node->_left->accept(this);
+	node->_right->accept(this);
+	annotate(node, boolean());
+}
+
+VISIT(UnaryNode)
+{
+	node->_expr->accept(this);
+	Range range = _result;
+
+	// negating zero gives -0
+	if(range.type == TYPE_INT && !has_zero(range) && node->_optype == TOKEN_MINUS)
+		annotate(node, integer(-range.hi, -range.lo));
+	else annotate(node, floating());
+}
+
+VISIT(GroupingNode)
+{
+	node->_expr->accept(this);
+	annotate(node, _result);
+}
+
+VISIT(ConditionalNode)
+{
+	node->_cond->accept(this);
+	node->_then->accept(this);
+	Range then = _result;
+	node->_else->accept(this);
+	Range otherwise = _result;
+
+	if(then.type == TYPE_INT && otherwise.type == TYPE_INT)
+		annotate(node, integer(min(then.lo, otherwise.lo), max(then.hi, otherwise.hi)));
+	else annotate(node, floating());
+}
+
+VISIT(PolynomialNode)
+{
+	node->_var->accept(this);
+	annotate(node, floating());
+}
+
+VISIT(NumberNode)
+{
+	//
+	annotate(node, whole(node->_value) ? integer(node->_value, node->_value) : floating());
+}
+
+VISIT(VariableNode)
+{
+	// arguments are not typed per call
+	if(node->_symbol->id < 0) annotate(node, floating());
+	else annotate(node, symbol_range(node->_symbol));
+}
+
+VISIT(CallNode)
+{
+	for(auto a : node->_args) a->accept(this);
+	annotate(node, symbol_range(node->_symbol));
+}
+
+VISIT(ActionNode)
+{
+	for(auto a : node->_args) a->accept(this);
+
+	if(node->_action->integral) annotate(node, integer(INT32_MIN, INT32_MAX));
+	else annotate(node, floating());
+}
+
+VISIT(RootNode)
+{
+	node->_lo->accept(this);
+	node->_hi->accept(this);
+	annotate(node, floating());
+}
+
+VISIT(MapNode)
+{
+	node->_array->accept(this);
+	annotate(node, floating());
+}
+
+#undef VISIT
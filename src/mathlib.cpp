@@ -0,0 +1,110 @@
+#include "mathlib.hpp"
+
+// plain loops over the inline versions, which the compiler vectorizes
+#define COLUMNS_1(name) \
+	void mathlib::name(double* out, const double* const* args, size_t n) \
+	{ \
+		const double* x = args[0]; \
+		for(size_t i = 0; i < n; i++) out[i] = name(x[i]); \
+	}
+
+#define COLUMNS_2(name) \
+	void mathlib::name(double* out, const double* const* args, size_t n) \
+	{ \
+		const double* a = args[0]; \
+		const double* b = args[1]; \
+		for(size_t i = 0; i < n; i++) out[i] = name(a[i], b[i]); \
+	}
+
+COLUMNS_1(sqrt)
+COLUMNS_1(exp)
+COLUMNS_1(log)
+COLUMNS_1(abs)
+COLUMNS_1(floor)
+COLUMNS_2(pow)
+COLUMNS_2(min)
+COLUMNS_2(max)
+
+#undef COLUMNS_1
+#undef COLUMNS_2
+
+void mathlib::clamp(double* out, const double* const* args, size_t n)
+{
+	const double* x = args[0];
+	const double* lo = args[1];
+	const double* hi = args[2];
+	for(size_t i = 0; i < n; i++) out[i] = clamp(x[i], lo[i], hi[i]);
+}
+
+// the reduction for every value, then libm for the few beyond its limit in a second pass
+void mathlib::sin(double* out, const double* const* args, size_t n)
+{
+	const double* x = args[0];
+	for(size_t i = 0; i < n; i++) out[i] = trig(x[i], false);
+	for(size_t i = 0; i < n; i++)
+		if(fabs(x[i]) > MATHLIB_TRIG_LIMIT) out[i] = std::sin(x[i]);
+}
+
+void mathlib::cos(double* out, const double* const* args, size_t n)
+{
+	const double* x = args[0];
+	for(size_t i = 0; i < n; i++) out[i] = trig(x[i], true);
+	for(size_t i = 0; i < n; i++)
+		if(fabs(x[i]) > MATHLIB_TRIG_LIMIT) out[i] = std::cos(x[i]);
+}
+
+// ==================================================
+
+double mathlib::sum(const double* x, size_t n)
+{
+	double partial[MATHLIB_LANES] = {};
+	size_t i = 0;
+	for(; i + MATHLIB_LANES <= n; i += MATHLIB_LANES)
+		for(size_t l = 0; l < MATHLIB_LANES; l++) partial[l] += x[i + l];
+
+	double s = 0;
+	for(size_t l = 0; l < MATHLIB_LANES; l++) s += partial[l];
+	for(; i < n; i++) s += x[i];
+	return s;
+}
+
+double mathlib::dot(const double* a, const double* b, size_t n)
+{
+	double partial[MATHLIB_LANES] = {};
+	size_t i = 0;
+	for(; i + MATHLIB_LANES <= n; i += MATHLIB_LANES)
+		for(size_t l = 0; l < MATHLIB_LANES; l++) partial[l] += a[i + l] * b[i + l];
+
+	double s = 0;
+	for(size_t l = 0; l < MATHLIB_LANES; l++) s += partial[l];
+	for(; i < n; i++) s += a[i] * b[i];
+	return s;
+}
+
+double mathlib::minimum(const double* x, size_t n)
+{
+	double partial[MATHLIB_LANES];
+	for(size_t l = 0; l < MATHLIB_LANES; l++) partial[l] = INFINITY;
+	size_t i = 0;
+	for(; i + MATHLIB_LANES <= n; i += MATHLIB_LANES)
+		for(size_t l = 0; l < MATHLIB_LANES; l++) partial[l] = min(x[i + l], partial[l]);
+
+	double m = INFINITY;
+	for(size_t l = 0; l < MATHLIB_LANES; l++) m = min(partial[l], m);
+	for(; i < n; i++) m = min(x[i], m);
+	return m;
+}
+
+double mathlib::maximum(const double* x, size_t n)
+{
+	double partial[MATHLIB_LANES];
+	for(size_t l = 0; l < MATHLIB_LANES; l++) partial[l] = -INFINITY;
+	size_t i = 0;
+	for(; i + MATHLIB_LANES <= n; i += MATHLIB_LANES)
+		for(size_t l = 0; l < MATHLIB_LANES; l++) partial[l] = max(x[i + l], partial[l]);
+
+	double m = -INFINITY;
+	for(size_t l = 0; l < MATHLIB_LANES; l++) m = max(partial[l], m);
+	for(; i < n; i++) m = max(x[i], m);
+	return m;
+}
@@ -0,0 +1,130 @@
+#include "montecarlo.hpp"
+#include "tracer.hpp"
+
+#include <cfloat>
+
+void Summary::add(const double* values, size_t n)
+{
+	// the first finite values decide the range of the histogram
+	if(!_width)
+	{
+		double lo = INFINITY, hi = -INFINITY;
+		for(size_t i = 0; i < n; i++) if(isfinite(values[i]))
+		{
+			lo = ::min(lo, values[i]);
+			hi = ::max(hi, values[i]);
+		}
+
+		if(lo <= hi)
+		{
+			_lo = lo;
+			_width = hi > lo ? (hi - lo) / (SUMMARY_BINS - 1) : ::max(fabs(lo), 1.0) * DBL_EPSILON;
+		}
+	}
+
+	for(size_t i = 0; i < n; i++)
+	{
+		double x = values[i];
+		if(!isfinite(x)) { nonfinite++; continue; }
+
+		// Welford's update
+		count++;
+		double delta = x - mean;
+		mean += delta / count;
+		_m2 += delta * (x - mean);
+		min = ::min(min, x);
+		max = ::max(max, x);
+
+		if(x < _lo || x >= _lo + _width * SUMMARY_BINS) widen(x);
+		size_t b = (size_t)((x - _lo) / _width);
+		Bin& bin = _bins[b < SUMMARY_BINS ? b : SUMMARY_BINS - 1];
+		bin.count++;
+		bin.min = ::min(bin.min, x);
+		bin.max = ::max(bin.max, x);
+	}
+}
+
+// doubles the width of the bins until x is within their range, merging them in pairs
+void Summary::widen(double x)
+{
+	while(x < _lo || x >= _lo + _width * SUMMARY_BINS)
+	{
+		// the old range becomes the upper half if x is below it, the lower half otherwise
+		bool below = x < _lo;
+		size_t offset = below ? SUMMARY_BINS / 2 : 0;
+		vector<Bin> bins(SUMMARY_BINS, Bin{0, INFINITY, -INFINITY});
+		for(size_t i = 0; i < SUMMARY_BINS; i++)
+		{
+			Bin& bin = bins[offset + i / 2];
+			bin.count += _bins[i].count;
+			bin.min = ::min(bin.min, _bins[i].min);
+			bin.max = ::max(bin.max, _bins[i].max);
+		}
+
+		if(below) _lo -= _width * SUMMARY_BINS;
+		_width *= 2;
+		_bins.swap(bins);
+	}
+}
+
+double Summary::variance()
+{
+	//
+	return count > 1 ? _m2 / (count - 1) : NAN;
+}
+
+// linear within the bin that holds the quantile, so it is off by at most a bin's width
+double Summary::quantile(double p)
+{
+	if(!count) return NAN;
+
+	double rank = p * count;
+	uint64_t below = 0;
+	for(auto& bin : _bins)
+	{
+		if(!bin.count || below + bin.count < rank) { below += bin.count; continue; }
+		return bin.min + (bin.max - bin.min) * (rank - below) / bin.count;
+	}
+	return max;
+}
+
+// bars of equal width over the bins from the first to the last result
+vector<HistogramBar> Summary::histogram(size_t bars)
+{
+	vector<HistogramBar> histogram;
+	if(!count) return histogram;
+
+	size_t first = 0, last = SUMMARY_BINS - 1;
+	while(!_bins[first].count) first++;
+	while(!_bins[last].count) last--;
+
+	size_t per = (last - first + bars) / bars;
+	for(size_t i = first; i <= last; i += per)
+	{
+		HistogramBar bar = { _lo + i * _width, _lo + (i + per) * _width, 0 };
+		for(size_t j = i; j < i + per && j < SUMMARY_BINS; j++) bar.count += _bins[j].count;
+		histogram.push_back(bar);
+	}
+	return histogram;
+}
+
+// ==================================================
+
+template<typename T>
+Status simulate(Environment* env, Symbol* symbol, uint64_t samples, BatchSolver<T>& solver, Summary& summary)
+{
+	TRACE_SCOPE("monte carlo");
+
+	Batch chunk;
+	for(chunk.first = 0; chunk.first < samples; chunk.first += chunk.rows)
+	{
+		chunk.rows = ::min((uint64_t)MONTE_CARLO_CHUNK, samples - chunk.first);
+		Status status = solver.solve(env, symbol, chunk);
+		if(status != STATUS_SUCCESS) return status;
+		summary.add(solver.results.data(), chunk.rows);
+	}
+	return STATUS_SUCCESS;
+}
+
+template Status simulate(Environment* env, Symbol* symbol, uint64_t samples, BatchSolver<double>& solver, Summary& summary);
+template Status simulate(Environment* env, Symbol* symbol, uint64_t samples, BatchSolver<float>& solver, Summary& summary);
@@ -0,0 +1,873 @@
+#include "optimizer.hpp"
+#include "inference.hpp"
+#include "tracer.hpp"
+#include "perfcounters.hpp"
+#include "allocstats.hpp"
+#include "builtins.hpp"
+
+// ==================================================
+
+// counts the nodes of an expression and the references to the parameters of a symbol
+class NodeCounter: public Visitor
+{
+public:
+
+	Symbol* symbol;
+	const map<Symbol*, NodeCount>* counts;
+	NodeCount count;
+
+private:
+
+	#define VISIT(_node) void visit(_node* node)
+	#include "visits.def"
+	#undef VISIT
+
+	void reference(Symbol* s);
+};
+
+#define VISIT(_node) void NodeCounter::visit(_node* node)
+
+VISIT(AssignNode)
+{
+	// this kind of node should never be counted
+	THROW_INTERNAL_ERROR("during optimization");
+}
+
+VISIT(BinaryNode)
+{
+	count.nodes++;
+	node->_left->accept(this);
+	node->_right->accept(this);
+}
+
+VISIT(LogicalNode)
+{
+	count.nodes++;
+	node->_left->accept(this);
+	node->_right->accept(this);
+}
+
+VISIT(UnaryNode)
+{
+	count.nodes++;
+	node->_expr->accept(this);
+}
+
+VISIT(GroupingNode)
+{
+	count.nodes++;
+	node->_expr->accept(this);
+}
+
+VISIT(ConditionalNode)
+{
+	count.nodes++;
+	node->_cond->accept(this);
+	node->_then->accept(this);
+	node->_else->accept(this);
+}
+
+VISIT(PolynomialNode)
+{
+	count.nodes++;
+	node->_var->accept(this);
+}
+
+VISIT(NumberNode)
+{
+	//
+	count.nodes++;
+}
+
+VISIT(VariableNode)
+{
+	count.nodes++;
+	if(node->_symbol->id >= 0) reference(node->_symbol);
+
+	size_t param = -node->_symbol->id - 1;
+	if(node->_symbol->id < 0 && param < count.refs.size()) count.refs[param]++;
+}
+
+VISIT(CallNode)
+{
+	count.nodes++;
+	reference(node->_symbol);
+	for(auto a : node->_args) a->accept(this);
+}
+
+VISIT(ActionNode)
+{
+	count.nodes++;
+	if(!node->_action->pure) count.pure = false;
+	if(!node->_action->numeric) count.invariant = false;
+	if(node->_action->random) count.random = true;
+	for(auto a : node->_args) a->accept(this);
+}
+
+VISIT(RootNode)
+{
+	count.nodes++;
+	reference(node->_symbol);
+	node->_lo->accept(this);
+	node->_hi->accept(this);
+}
+
+VISIT(MapNode)
+{
+	// the values of the array are bound, so the map depends on bindings
+	count.nodes++;
+	count.invariant = false;
+	reference(node->_symbol);
+	node->_array->accept(this);
+}
+
+#undef VISIT
+
+// symbols without counts are assumed to be pure, but not invariant unless it is a recursion
+void NodeCounter::reference(Symbol* s)
+{
+	if(s == symbol) count.recursive = true;
+
+	bool known = counts && counts->count(s);
+	if(known && !counts->at(s).pure) count.pure = false;
+	if(known && counts->at(s).random) count.random = true;
+	if(s != symbol && (!known || !counts->at(s).invariant)) count.invariant = false;
+}
+
+// the symbol may be null if only the size is of interest, purity
+// is only known for references to symbols with counts
+NodeCount count_nodes(ExprNode* expr, Symbol* symbol, const map<Symbol*, NodeCount>* counts)
+{
+	NodeCounter counter = NodeCounter();
+	counter.symbol = symbol;
+	counter.counts = counts;
+	counter.count = NodeCount{0, vector<uint>(symbol ? symbol->target.params.size() : 0, 0), false, true, true, false};
+
+	expr->accept(&counter);
+	return counter.count;
+}
+
+// ==================================================
+
+// the expression without enclosing parentheses
+static ExprNode* strip(ExprNode* expr)
+{
+	GroupingNode* group;
+	while((group = dynamic_cast<GroupingNode*>(expr))) expr = group->_expr;
+	return expr;
+}
+
+static NumberNode* constant(ExprNode* expr)
+{
+	//
+	return dynamic_cast<NumberNode*>(strip(expr));
+}
+
+// integer arithmetic with results beyond 2^53 is left to the exact integral evaluation,
+// a folded double would be rounded
+static bool foldable(TokenType optype, double lhs, double rhs, double result)
+{
+	bool integers = lhs == floor(lhs) && rhs == floor(rhs);
+	bool arithmetic = optype == TOKEN_PLUS || optype == TOKEN_MINUS || optype == TOKEN_STAR || optype == TOKEN_CARET;
+	return !integers || !arithmetic || fabs(result) <= 9007199254740992.0 || fabs(result) > TYPE_INT_LIMIT;
+}
+
+// whether an expression is not printed as a single unit, which
+// includes negations and negative numbers as the base of a power
+static bool needs_parentheses(ExprNode* expr)
+{
+	NumberNode* number = dynamic_cast<NumberNode*>(expr);
+	if(number) return signbit(number->_value);
+
+	return dynamic_cast<BinaryNode*>(expr) || dynamic_cast<LogicalNode*>(expr)
+		|| dynamic_cast<UnaryNode*>(expr) || dynamic_cast<PolynomialNode*>(expr);
+}
+
+// ==================================================
+
+void Optimizer::optimize(Environment* env, Strategy strategy)
+{
+	TRACE_SCOPE("optimize");
+	PERF_SCOPE("optimize");
+	ALLOC_SCOPE("optimize");
+
+	_strategy = strategy;
+	_counts.clear();
+	_substitutes = nullptr;
+	stats = OptimizerStats{0, 0, 0, 0, 0, 0, 0, 0};
+	_env = env;
+
+	// callees are defined before their callers, so they are optimized first
+	for(auto s : env->symbols)
+	{
+		_symbol = s;
+		stats.nodes_before += count_nodes(s->body, s).nodes;
+
+		// rewrites may enable further rewrites, the body is only rebuilt if something changed
+		for(int pass = 0; pass < OPTIMIZER_MAX_PASSES; pass++)
+		{
+			s->body->accept(this);
+			if(_result == s->body) break;
+			s->body = _result;
+		}
+
+		_counts[s] = count_nodes(s->body, s, &_counts);
+		stats.nodes_after += _counts[s].nodes;
+	}
+
+	TRACE_COUNTER("calls inlined", stats.inlined);
+	TRACE_COUNTER("operations folded", stats.folded);
+	TRACE_COUNTER("nodes eliminated", stats.eliminated);
+	TRACE_COUNTER("polynomials", stats.polynomials);
+	TRACE_COUNTER("hoisted", stats.hoisted);
+}
+
+// returns the callee's body with the arguments substituted, or null if the call stays
+ExprNode* Optimizer::inline_call(CallNode* node, vector<ExprNode*>& args)
+{
+	// the callee has to be optimized already, which rules out recursive calls, and
+	// random draws keep their call site, it tells the draws of every call apart
+	auto it = _counts.find(node->_symbol);
+	if(!inline_budget || it == _counts.end() || it->second.recursive || it->second.random) return nullptr;
+	NodeCount& callee = it->second;
+
+	// roughly the number of nodes the caller grows by
+	long growth = (long)callee.nodes;
+	vector<ExprNode*> substitutes;
+	for(size_t j = 0; j < args.size(); j++)
+	{
+		if(!substitutable(args[j], callee.refs[j])) return nullptr;
+
+		// parenthesized, so that the arguments keep their precedence
+		substitutes.push_back(group(args[j]));
+		long nodes = (long)count_nodes(substitutes[j], nullptr).nodes;
+		growth += (long)callee.refs[j] * (nodes - 1) - nodes;
+	}
+	if(growth > (long)inline_budget) return nullptr;
+
+	const vector<ExprNode*>* outer = _substitutes;
+	_substitutes = &substitutes;
+	node->_symbol->body->accept(this);
+	_substitutes = outer;
+
+	stats.inlined++;
+	return group(_result);
+}
+
+// whether substituting an argument keeps how often it is evaluated
+bool Optimizer::substitutable(ExprNode* arg, uint refs)
+{
+	// by name, every reference evaluates the argument again anyway
+	if(_strategy == STRATEGY_LAZY || refs <= 1) return true;
+
+	// otherwise only if evaluating it again costs nothing
+	if(constant(arg)) return true;
+	VariableNode* var = dynamic_cast<VariableNode*>(arg);
+	return var && (var->_symbol->id < 0 || _strategy == STRATEGY_MEMO);
+}
+
+// parenthesizes an expression where that matters for printing
+ExprNode* Optimizer::group(ExprNode* expr)
+{
+	//
+	return needs_parentheses(expr) ? new GroupingNode(expr->_token, expr) : expr;
+}
+
+// =========================================
+// All visit methods MUST set _result!
+
+#define VISIT(_node) void Optimizer::visit(_node* node)
+
+VISIT(AssignNode)
+{
+	// this kind of node should never be optimized
+	THROW_INTERNAL_ERROR("during optimization");
+}
+
+VISIT(BinaryNode)
+{
+	node->_left->accept(this);
+	ExprNode* left = _result;
+	node->_right->accept(this);
+	ExprNode* right = _result;
+
+	NumberNode* lhs = constant(left);
+	NumberNode* rhs = constant(right);
+	double value = lhs && rhs ? apply_binary(node->_optype, lhs->_value, rhs->_value) : 0;
+
+	if(lhs && rhs && foldable(node->_optype, lhs->_value, rhs->_value, value))
+	{
+		stats.folded++;
+		_result = new NumberNode(node->_token, value);
+	}
+	else if(ExprNode* simpler = simplify(node, left, right)) _result = simpler;
+	else if(ExprNode* poly = polynomial(node, left, right)) _result = poly;
+	else if(left != node->_left || right != node->_right)
+		_result = new BinaryNode(node->_token, node->_optype, left, right);
+	else _result = node;
+}
+
+VISIT(LogicalNode)
+{
+	node->_left->accept(this);
+	ExprNode* left = _result;
+	node->_right->accept(this);
+	ExprNode* right = _result;
+
+	NumberNode* lhs = constant(left);
+	NumberNode* rhs = constant(right);
+
+	// a constant left operand may decide the result on its own
+	bool decided = lhs && (node->_optype == TOKEN_AND ? lhs->_value == 0 : lhs->_value != 0);
+
+	if(decided || (lhs && rhs))
+	{
+		stats.folded++;
+		double value = decided ? node->_optype == TOKEN_OR : rhs->_value != 0;
+		_result = new NumberNode(node->_token, value);
+	}
+	else if(left != node->_left || right != node->_right)
+		_result = new LogicalNode(node->_token, node->_optype, left, right);
+	else _result = node;
+}
+
+VISIT(UnaryNode)
+{
+	node->_expr->accept(this);
+	NumberNode* value = constant(_result);
+
+	if(value)
+	{
+		stats.folded++;
+		_result = new NumberNode(node->_token, apply_unary(node->_optype, value->_value));
+	}
+	else if(ExprNode* simpler = simplify(node, _result)) _result = simpler;
+	else if(_result != node->_expr) _result = new UnaryNode(node->_token, node->_optype, _result);
+	else _result = node;
+}
+
+VISIT(GroupingNode)
+{
+	node->_expr->accept(this);
+
+	// parentheses are only kept where they matter for printing
+	if(!needs_parentheses(_result)) return;
+	if(_result != node->_expr) _result = new GroupingNode(node->_token, _result);
+	else _result = node;
+}
+
+VISIT(ConditionalNode)
+{
+	node->_cond->accept(this);
+	ExprNode* cond = _result;
+
+	// a constant condition leaves only one branch
+	if(constant(cond))
+	{
+		stats.folded++;
+		if(constant(cond)->_value != 0) node->_then->accept(this);
+		else node->_else->accept(this);
+		return;
+	}
+
+	node->_then->accept(this);
+	ExprNode* then = _result;
+	node->_else->accept(this);
+	ExprNode* otherwise = _result;
+
+	if(cond != node->_cond || then != node->_then || otherwise != node->_else)
+		_result = new ConditionalNode(node->_token, cond, then, otherwise);
+	else _result = node;
+}
+
+VISIT(PolynomialNode)
+{
+	node->_var->accept(this);
+	NumberNode* value = constant(_result);
+
+	if(value)
+	{
+		stats.folded++;
+		_result = new NumberNode(node->_token, horner(node->_coefs, value->_value));
+	}
+	else if(_result != node->_var) _result = new PolynomialNode(node->_token, group(_result), node->_coefs);
+	else _result = node;
+}
+
+VISIT(NumberNode)
+{
+	//
+	_result = node;
+}
+
+VISIT(VariableNode)
+{
+	// parameters of an inlined callee are replaced by the arguments
+	if(node->_symbol->id < 0)
+	{
+		_result = _substitutes ? (*_substitutes)[-node->_symbol->id - 1] : node;
+		return;
+	}
+
+	// optimized symbols with a constant value are propagated
+	NumberNode* value = constant(node->_symbol->body);
+	if(value && _counts.count(node->_symbol))
+	{
+		stats.folded++;
+		_result = group(value);
+	}
+	else _result = node;
+}
+
+VISIT(CallNode)
+{
+	vector<ExprNode*> args;
+	bool changed = false;
+	for(auto a : node->_args)
+	{
+		a->accept(this);
+		args.push_back(_result);
+		changed |= _result != a;
+	}
+
+	ExprNode* inlined = inline_call(node, args);
+	if(inlined) _result = inlined;
+	else if(changed) _result = new CallNode(node->_token, node->_symbol, args);
+	else _result = node;
+
+	if(!inlined) if(ExprNode* value = hoisted(_result, args, node->_symbol)) _result = value;
+}
+
+VISIT(ActionNode)
+{
+	// only numeric actions are folded, the others may depend on bindings or have side effects
+	vector<ExprNode*> args;
+	vector<double> values;
+	bool changed = false;
+	for(auto a : node->_args)
+	{
+		a->accept(this);
+		args.push_back(_result);
+		changed |= _result != a;
+		if(NumberNode* c = constant(_result)) values.push_back(c->_value);
+	}
+
+	if(node->_action->numeric && values.size() == args.size())
+	{
+		stats.folded++;
+		_result = new NumberNode(node->_token, call_action(node->_action, &node->_token, nullptr, values.data()));
+	}
+	else if(hoist && node->_action == get_action("get") && values.size() == 1 && values[0] == (uint)values[0]
+		&& !varying.count(values[0]) && _env->bindings.count(values[0]) && _env->bindings[values[0]].type == BoundValue::NUMBER)
+	{
+		stats.hoisted++;
+		_result = new NumberNode(node->_token, _env->bindings[values[0]].as.num);
+	}
+	else _result = changed ? new ActionNode(node->_token, node->_action, args) : node;
+}
+
+VISIT(RootNode)
+{
+	// the search is only folded when hoisting, f is optimized on its own
+	node->_lo->accept(this);
+	ExprNode* lo = _result;
+	node->_hi->accept(this);
+	ExprNode* hi = _result;
+
+	if(lo != node->_lo || hi != node->_hi) _result = new RootNode(node->_token, node->_symbol, lo, hi);
+	else _result = node;
+
+	if(ExprNode* value = hoisted(_result, {lo, hi}, node->_symbol)) _result = value;
+}
+
+VISIT(MapNode)
+{
+	// f is optimized on its own
+	node->_array->accept(this);
+	_result = _result != node->_array ? new MapNode(node->_token, node->_symbol, _result) : node;
+}
+
+#undef VISIT
+
+// ==================================================
+// algebraic simplification
+
+// zeros only match zeros of the same sign
+static bool is_value(ExprNode* expr, double value)
+{
+	NumberNode* number = constant(expr);
+	return number && number->_value == value && signbit(number->_value) == signbit(value);
+}
+
+static bool is_zero(ExprNode* expr)
+{
+	//
+	return is_value(expr, 0) || is_value(expr, -0.0);
+}
+
+// the operand of a negation, or null
+static ExprNode* negated(ExprNode* expr)
+{
+	UnaryNode* unary = dynamic_cast<UnaryNode*>(strip(expr));
+	return unary && unary->_optype == TOKEN_MINUS ? unary->_expr : nullptr;
+}
+
+// splits an expression into a base and a positive integral exponent
+static double exponent(ExprNode* expr, ExprNode** base)
+{
+	BinaryNode* binary = dynamic_cast<BinaryNode*>(strip(expr));
+	NumberNode* n = binary && binary->_optype == TOKEN_CARET ? constant(binary->_right) : nullptr;
+	if(n && n->_value >= 1 && n->_value == floor(n->_value)) { *base = binary->_left; return n->_value; }
+
+	*base = expr;
+	return 1;
+}
+
+// the constant right operand of an operation, or null
+static NumberNode* constant_operand(ExprNode* expr, TokenType optype, ExprNode** left)
+{
+	BinaryNode* binary = dynamic_cast<BinaryNode*>(strip(expr));
+	if(!binary || binary->_optype != optype || !constant(binary->_right)) return nullptr;
+
+	*left = binary->_left;
+	return constant(binary->_right);
+}
+
+static size_t nodes(ExprNode* expr)
+{
+	//
+	return count_nodes(expr, nullptr).nodes;
+}
+
+// counts an applied rewrite
+ExprNode* Optimizer::rewrite(ExprNode* result, size_t eliminated)
+{
+	stats.simplified++;
+	stats.eliminated += eliminated;
+	return result;
+}
+
+// whether both expressions are written the same, so that they have the same value if pure
+bool Optimizer::same(ExprNode* a, ExprNode* b)
+{
+	a = strip(a);
+	b = strip(b);
+	if(a == b) return true;
+
+	if(NumberNode* x = dynamic_cast<NumberNode*>(a))
+	{
+		NumberNode* y = dynamic_cast<NumberNode*>(b);
+		return y && x->_value == y->_value && signbit(x->_value) == signbit(y->_value);
+	}
+	if(VariableNode* x = dynamic_cast<VariableNode*>(a))
+	{
+		VariableNode* y = dynamic_cast<VariableNode*>(b);
+		return y && x->_symbol == y->_symbol;
+	}
+	if(BinaryNode* x = dynamic_cast<BinaryNode*>(a))
+	{
+		BinaryNode* y = dynamic_cast<BinaryNode*>(b);
+		return y && x->_optype == y->_optype && same(x->_left, y->_left) && same(x->_right, y->_right);
+	}
+	if(LogicalNode* x = dynamic_cast<LogicalNode*>(a))
+	{
+		LogicalNode* y = dynamic_cast<LogicalNode*>(b);
+		return y && x->_optype == y->_optype && same(x->_left, y->_left) && same(x->_right, y->_right);
+	}
+	if(UnaryNode* x = dynamic_cast<UnaryNode*>(a))
+	{
+		UnaryNode* y = dynamic_cast<UnaryNode*>(b);
+		return y && x->_optype == y->_optype && same(x->_expr, y->_expr);
+	}
+	if(PolynomialNode* x = dynamic_cast<PolynomialNode*>(a))
+	{
+		PolynomialNode* y = dynamic_cast<PolynomialNode*>(b);
+		return y && x->_coefs == y->_coefs && same(x->_var, y->_var);
+	}
+	if(ConditionalNode* x = dynamic_cast<ConditionalNode*>(a))
+	{
+		ConditionalNode* y = dynamic_cast<ConditionalNode*>(b);
+		return y && same(x->_cond, y->_cond) && same(x->_then, y->_then) && same(x->_else, y->_else);
+	}
+	if(RootNode* x = dynamic_cast<RootNode*>(a))
+	{
+		RootNode* y = dynamic_cast<RootNode*>(b);
+		return y && x->_symbol == y->_symbol && same(x->_lo, y->_lo) && same(x->_hi, y->_hi);
+	}
+	if(MapNode* x = dynamic_cast<MapNode*>(a))
+	{
+		MapNode* y = dynamic_cast<MapNode*>(b);
+		return y && x->_symbol == y->_symbol && same(x->_array, y->_array);
+	}
+
+	const vector<ExprNode*>* xargs = nullptr;
+	const vector<ExprNode*>* yargs = nullptr;
+	if(CallNode* x = dynamic_cast<CallNode*>(a))
+	{
+		CallNode* y = dynamic_cast<CallNode*>(b);
+		if(!y || x->_symbol != y->_symbol) return false;
+		xargs = &x->_args;
+		yargs = &y->_args;
+	}
+	else if(ActionNode* x = dynamic_cast<ActionNode*>(a))
+	{
+		ActionNode* y = dynamic_cast<ActionNode*>(b);
+		if(!y || x->_action != y->_action) return false;
+		if(x->_action->random && x->_token.start != y->_token.start) return false; // draws of another stream
+		xargs = &x->_args;
+		yargs = &y->_args;
+	}
+	else return false;
+
+	for(size_t i = 0; i < xargs->size(); i++) if(!same((*xargs)[i], (*yargs)[i])) return false;
+	return true;
+}
+
+// whether evaluating the expression has no side effects
+bool Optimizer::pure(ExprNode* expr)
+{
+	//
+	return count_nodes(expr, nullptr, &_counts).pure;
+}
+
+// the value of a call or root search whose arguments are constants, solved once if its callee is
+// invariant, or null; it is solved as the body of the symbol being optimized, which is blamed for limits
+ExprNode* Optimizer::hoisted(ExprNode* node, const vector<ExprNode*>& args, Symbol* callee)
+{
+	if(!hoist || !_counts.count(callee) || !_counts[callee].invariant) return nullptr;
+	for(auto a : args) if(!constant(a)) return nullptr;
+
+	Symbol symbol = *_symbol;
+	symbol.body = node;
+	if(hoist->solve(_env, &symbol) != STATUS_SUCCESS) return nullptr;
+
+	stats.hoisted++;
+	return new NumberNode(node->_token, hoist->result);
+}
+
+// rewrites that are exact for all doubles, including NaN, the infinities and
+// signed zeros, are always applied, all others only with fast_math
+ExprNode* Optimizer::simplify(BinaryNode* node, ExprNode* left, ExprNode* right)
+{
+	Token tok = node->_token;
+	ExprNode* lneg = negated(left);
+	ExprNode* rneg = negated(right);
+	NumberNode* rhs = constant(right);
+	ExprNode* inner;
+
+	switch(node->_optype)
+	{
+		case TOKEN_PLUS:
+		{
+			// x + -0 = x, but x + 0 is not for x = -0
+			if(is_value(right, -0.0) || (fast_math && is_zero(right))) return rewrite(left, 2);
+			if(is_value(left, -0.0) || (fast_math && is_zero(left))) return rewrite(right, 2);
+
+			// x + -y = x - y, -x + y = y - x, which evaluates y first
+			if(rneg) return rewrite(new BinaryNode(tok, TOKEN_MINUS, left, rneg), 1);
+			if(lneg && pure(left) && pure(right)) return rewrite(new BinaryNode(tok, TOKEN_MINUS, right, lneg), 1);
+
+			// (x + a) + b = x + (a + b)
+			NumberNode* a = constant_operand(left, TOKEN_PLUS, &inner);
+			if(fast_math && rhs && a)
+				return rewrite(new BinaryNode(tok, TOKEN_PLUS, inner, new NumberNode(tok, a->_value + rhs->_value)), 2);
+			break;
+		}
+		case TOKEN_MINUS:
+		{
+			// x - 0 = x, but x - -0 is not for x = -0
+			if(is_value(right, 0) || (fast_math && is_zero(right))) return rewrite(left, 2);
+
+			// -0 - x = -x, but 0 - x is not for x = 0
+			if(is_value(left, -0.0) || (fast_math && is_zero(left)))
+				return rewrite(new UnaryNode(tok, TOKEN_MINUS, group(right)), 1);
+
+			// x - -y = x + y
+			if(rneg) return rewrite(new BinaryNode(tok, TOKEN_PLUS, left, rneg), 1);
+
+			// x - x = 0, but not for NaN and the infinities
+			if(fast_math && same(left, right) && pure(left))
+				return rewrite(new NumberNode(tok, 0), 2 * nodes(left));
+			break;
+		}
+		case TOKEN_STAR:
+		{
+			// x * 1 = x, x * -1 = -x
+			if(is_value(right, 1)) return rewrite(left, 2);
+			if(is_value(left, 1)) return rewrite(right, 2);
+			if(is_value(right, -1)) return rewrite(new UnaryNode(tok, TOKEN_MINUS, group(left)), 1);
+			if(is_value(left, -1)) return rewrite(new UnaryNode(tok, TOKEN_MINUS, group(right)), 1);
+
+			// -x * -y = x * y
+			if(lneg && rneg) return rewrite(new BinaryNode(tok, TOKEN_STAR, lneg, rneg), 2);
+
+			// 0 * x = 0, but not for NaN, the infinities and negative x
+			if(fast_math && (is_zero(left) || is_zero(right)) && pure(left) && pure(right))
+				return rewrite(new NumberNode(tok, 0), nodes(left) + nodes(right));
+
+			// x^a * x^b = x^(a + b), raising by squaring is only exact up to the cube
+			ExprNode* lbase;
+			ExprNode* rbase;
+			double a = exponent(left, &lbase);
+			double b = exponent(right, &rbase);
+			if((fast_math || a + b <= 3) && same(lbase, rbase) && pure(lbase))
+			{
+				ExprNode* result = new BinaryNode(tok, TOKEN_CARET, group(strip(lbase)), new NumberNode(tok, a + b));
+				return rewrite(result, nodes(left) + nodes(right) + 1 - nodes(result));
+			}
+
+			// (x * a) * b = x * (a * b)
+			NumberNode* c = constant_operand(left, TOKEN_STAR, &inner);
+			if(fast_math && rhs && c)
+				return rewrite(new BinaryNode(tok, TOKEN_STAR, inner, new NumberNode(tok, c->_value * rhs->_value)), 2);
+			break;
+		}
+		case TOKEN_SLASH:
+		{
+			// x / 1 = x, x / -1 = -x
+			if(is_value(right, 1)) return rewrite(left, 2);
+			if(is_value(right, -1)) return rewrite(new UnaryNode(tok, TOKEN_MINUS, group(left)), 1);
+
+			// -x / -y = x / y
+			if(lneg && rneg) return rewrite(new BinaryNode(tok, TOKEN_SLASH, lneg, rneg), 2);
+
+			// x / c = x * (1 / c), exact if c and 1 / c are powers of two
+			if(rhs && rhs->_value != 0 && isfinite(rhs->_value))
+			{
+				int exp;
+				double reciprocal = 1 / rhs->_value;
+				bool exact = fabs(frexp(rhs->_value, &exp)) == 0.5 && fabs(frexp(reciprocal, &exp)) == 0.5;
+				if(exact || (fast_math && reciprocal != 0 && isfinite(reciprocal)))
+					return rewrite(new BinaryNode(tok, TOKEN_STAR, left, new NumberNode(right->_token, reciprocal)), 0);
+			}
+
+			// x / x = 1, but not for 0, NaN and the infinities
+			if(fast_math && same(left, right) && pure(left))
+				return rewrite(new NumberNode(tok, 1), 2 * nodes(left));
+			break;
+		}
+		default: break;
+	}
+
+	return nullptr;
+}
+
+ExprNode* Optimizer::simplify(UnaryNode* node, ExprNode* expr)
+{
+	// -(-x) = x
+	ExprNode* inner = negated(expr);
+	if(node->_optype == TOKEN_MINUS && inner) return rewrite(inner, 2);
+
+	return nullptr;
+}
+
+// ==================================================
+// polynomials
+
+// splits a product of constants and powers of a single expression into coef * var^degree,
+// the first factor that is neither becomes the variable
+bool Optimizer::monomial(ExprNode* expr, ExprNode*& var, double& coef, size_t& degree)
+{
+	expr = strip(expr);
+	if(NumberNode* number = constant(expr))
+	{
+		coef = number->_value;
+		degree = 0;
+		return true;
+	}
+
+	UnaryNode* unary = dynamic_cast<UnaryNode*>(expr);
+	if(unary && unary->_optype == TOKEN_MINUS)
+	{
+		if(!monomial(unary->_expr, var, coef, degree)) return false;
+		coef = -coef;
+		return true;
+	}
+
+	BinaryNode* binary = dynamic_cast<BinaryNode*>(expr);
+	NumberNode* rhs = binary ? constant(binary->_right) : nullptr;
+	if(binary && binary->_optype == TOKEN_STAR)
+	{
+		double rcoef;
+		size_t rdegree;
+		if(!monomial(binary->_left, var, coef, degree) || !monomial(binary->_right, var, rcoef, rdegree)) return false;
+		coef *= rcoef;
+		degree += rdegree;
+		return degree <= OPTIMIZER_MAX_DEGREE;
+	}
+	if(binary && binary->_optype == TOKEN_SLASH && rhs)
+	{
+		if(!monomial(binary->_left, var, coef, degree)) return false;
+		coef /= rhs->_value;
+		return true;
+	}
+	if(binary && binary->_optype == TOKEN_CARET && rhs && rhs->_value >= 0
+		&& rhs->_value <= OPTIMIZER_MAX_DEGREE && rhs->_value == floor(rhs->_value))
+	{
+		if(!monomial(binary->_left, var, coef, degree)) return false;
+		coef = power(coef, rhs->_value);
+		degree *= (size_t)rhs->_value;
+		return degree <= OPTIMIZER_MAX_DEGREE;
+	}
+
+	// it is evaluated only once in Horner form
+	if(!var && pure(expr)) var = expr;
+	if(!var || !same(var, expr)) return false;
+
+	coef = 1;
+	degree = 1;
+	return true;
+}
+
+// adds the monomials of a sum to the coefficients, the sign applies to the whole sum
+bool Optimizer::collect(ExprNode* expr, double sign, ExprNode*& var, vector<double>& coefs, size_t& terms)
+{
+	expr = strip(expr);
+
+	BinaryNode* binary = dynamic_cast<BinaryNode*>(expr);
+	if(binary && (binary->_optype == TOKEN_PLUS || binary->_optype == TOKEN_MINUS))
+		return collect(binary->_left, sign, var, coefs, terms)
+			&& collect(binary->_right, binary->_optype == TOKEN_MINUS ? -sign : sign, var, coefs, terms);
+
+	// polynomials recognized in a part of the sum already
+	PolynomialNode* poly = dynamic_cast<PolynomialNode*>(expr);
+	if(poly && (!var || same(var, poly->_var)))
+	{
+		var = poly->_var;
+		if(coefs.size() < poly->_coefs.size()) coefs.resize(poly->_coefs.size(), 0);
+		for(size_t i = 0; i < poly->_coefs.size(); i++) coefs[i] += sign * poly->_coefs[i];
+		terms += poly->_coefs.size();
+		return true;
+	}
+
+	double coef;
+	size_t degree;
+	if(!monomial(expr, var, coef, degree)) return false;
+
+	if(coefs.size() <= degree) coefs.resize(degree + 1, 0);
+	coefs[degree] += sign * coef;
+	terms++;
+	return true;
+}
+
+// sums of at least two monomials of a single expression of degree two or more
+// become polynomials, combining the coefficients changes the rounding
+ExprNode* Optimizer::polynomial(BinaryNode* node, ExprNode* left, ExprNode* right)
+{
+	if(!fast_math || (node->_optype != TOKEN_PLUS && node->_optype != TOKEN_MINUS)) return nullptr;
+
+	ExprNode* var = nullptr;
+	vector<double> coefs;
+	size_t terms = 0;
+	if(!collect(left, 1, var, coefs, terms)) return nullptr;
+	if(!collect(right, node->_optype == TOKEN_MINUS ? -1 : 1, var, coefs, terms)) return nullptr;
+
+	while(coefs.size() > 1 && coefs.back() == 0) coefs.pop_back();
+	if(!var || terms < 2 || coefs.size() < 3) return nullptr;
+
+	ExprNode* result = new PolynomialNode(node->_token, group(strip(var)), coefs);
+	stats.polynomials++;
+
+	long eliminated = (long)(nodes(left) + nodes(right) + 1) - (long)nodes(result);
+	return rewrite(result, max(eliminated, 0L));
+}
@@ -1,5 +1,10 @@
 #include "parser.hpp"
 #include "tools.hpp"
+#include "tracer.hpp"
+#include "perfcounters.hpp"
+#include "allocstats.hpp"
+
+size_t ast_node_count = 0;
 
 // ====================== errors =======================
 
@@ -39,9 +44,9 @@ void Parser::error_at_current(string message)
 // displays note of declaration of token and line of token
 void Parser::note_declaration(string type, string name, Token* token)
 {
-	CCP msg = strdup((type + " '" + name + "' declared here:").c_str());
+	string msg = type + " '" + name + "' declared here:";
 
-	_error_dispatcher.note_at_token(token, msg);
+	_error_dispatcher.note_at_token(token, msg.c_str());
 	cerr << endl;
 	_error_dispatcher.print_token_marked(token, COLOR_GREEN);
 }
@@ -56,6 +61,7 @@ void Parser::advance(bool skip_terminator)
 	for (;;)
 	{
 		_current = _scanner.scanToken();
+		_token_count++;
 
 		if(_current.type == TOKEN_ERROR)
 			error_at_current(_current.start);
@@ -155,29 +161,33 @@ bool Parser::is_at_end()
 
 // ======================= state =======================
 
-void Parser::set_symbol(Symbol symbol)
+// ID the next symbol with the given name will get
+int Parser::next_id(string name)
 {
 	// find last symbol with same name and get its ID
-	if(symbol.id == 0)
-	{
-		for(auto s = _env.symbols.rbegin(); s != _env.symbols.rend(); s++)
-			if((*s)->target.name == symbol.target.name)
-			{
-				symbol.id = (*s)->id + 1;
-				break;
-			}
-	}
+	for(auto s = _env.symbols.rbegin(); s != _env.symbols.rend(); s++)
+		if((*s)->target.name == name) return (*s)->id + 1;
+	return 0;
+}
+
+void Parser::set_symbol(Symbol symbol)
+{
+	if(symbol.id == 0) symbol.id = next_id(symbol.target.name);
+	add_symbol(new Symbol(symbol));
+}
 
-	Symbol* symptr = new Symbol(symbol);
-	if(symbol.id >= 0) _env.symbols.push_back(symptr);
-	_current_scope.symbols[symbol.target.name] = symptr;
+void Parser::add_symbol(Symbol* symptr)
+{
+	symptr->index = _env.symbols.size();
+	if(symptr->id >= 0) _env.symbols.push_back(symptr);
+	_current_scope.symbols[symptr->target.name] = symptr;
 
 	#ifdef DEBUG
-	string msg = "set symbol '" + symbol.get_ident() + '\'';
-	if(symbol.target.has_params)
+	string msg = "set symbol '" + symptr->get_ident() + '\'';
+	if(symptr->target.has_params)
 	{
 		msg += " (";
-		for(auto p: symbol.target.params) msg += p + (p != symbol.target.params.back() ? ", " : "");
+		for(auto p: symptr->target.params) msg += p + (p != symptr->target.params.back() ? ", " : "");
 		msg += ')';
 	}
 	DEBUG_PRINT_F_MSG("%s", msg.c_str());
@@ -196,8 +206,14 @@ Symbol* Parser::get_symbol(string name, int id)
 			if (s->symbols.find(name) != s->symbols.end())
 				return s->symbols.at(name);
 	}
-	else for(auto s : _env.symbols)
-		if(s->id == id && s->target.name == name) return s;
+	else
+	{
+		// a symbol may refer to itself by its explicit ID
+		if(_defining && _defining->id == id && _defining->target.name == name) return _defining;
+
+		for(auto s : _env.symbols)
+			if(s->id == id && s->target.name == name) return s;
+	}
 
 	return nullptr;
 }
@@ -253,6 +269,27 @@ void Parser::bind()
 			val.as.str = strndup(_previous.start + 1, _previous.length - 2);
 			val.type = BoundValue::STRING;
 		}
+		else if(match(TOKEN_LEFT_B_BRACE))
+		{
+			vector<double> values;
+			if(!check(TOKEN_RIGHT_B_BRACE)) do
+			{
+				// the values are numbers, negative ones too
+				bool negative = match(TOKEN_MINUS);
+				if(!match(TOKEN_INTEGER) && !match(TOKEN_FLOAT)) { error_at_current("Expected number in array."); return; }
+
+				NumberNode* numnode = number();
+				values.push_back(negative ? -numnode->_value : numnode->_value);
+				delete numnode;
+			}
+			while(match(TOKEN_COMMA));
+			if(!consume(TOKEN_RIGHT_B_BRACE, "Expected ']' after array values.")) return;
+
+			val.as.arr.size = values.size();
+			val.as.arr.data = new double[values.size()];
+			copy(values.begin(), values.end(), val.as.arr.data);
+			val.type = BoundValue::ARRAY;
+		}
 		else error_at_current("Expected bindable value.");
 	}
 
@@ -261,13 +298,25 @@ void Parser::bind()
 
 void Parser::assignment()
 {
+	tracer::Scope trace_scope(nullptr, TRACE_SYMBOL_MIN_NS);
+
 	// get target
 	Target target = consume_target();
 	if(target.invalid || !consume(TOKEN_EQUAL, "Expected assignment.")) return;
+	if(tracer::enabled) trace_scope.rename(tracer::intern("parse " + target.name));
 
 	DEBUG_PRINT_NL();
 	scope_up();
 
+	// created up front, so that the body can refer to it for recursion
+	Symbol* symbol = new Symbol{
+		.target = target,
+		.id = next_id(target.name),
+		.body = nullptr,
+		.invalid = false,
+	};
+	_defining = symbol;
+
 	// add params as symbols
 	for(int i = 0; i < target.params.size(); i++)
 	{
@@ -288,14 +337,12 @@ void Parser::assignment()
 
 	// get expression
 	ExprNode* body = expression();
+	_defining = nullptr;
 
 	scope_down();
-	set_symbol(Symbol{
-		.target = target,
-		.id = 0,
-		.body = body,
-		.invalid = target.invalid || _panic_mode
-	});
+	symbol->body = body;
+	symbol->invalid = target.invalid || _panic_mode;
+	add_symbol(symbol);
 
 	DEBUG_PRINT_F_MSG("assigned '%s'", target.name.c_str());
 }
@@ -305,7 +352,35 @@ void Parser::assignment()
 ExprNode* Parser::expression()
 {
 	//
-	return equality();
+	return logic_or();
+}
+
+ExprNode* Parser::logic_or()
+{
+	ExprNode* expr = logic_and();
+
+	while(match(TOKEN_OR))
+	{
+		Token tok = _previous;
+		ExprNode* right = logic_and();
+		expr = new LogicalNode(tok, tok.type, expr, right);
+	}
+
+	return expr;
+}
+
+ExprNode* Parser::logic_and()
+{
+	ExprNode* expr = equality();
+
+	while(match(TOKEN_AND))
+	{
+		Token tok = _previous;
+		ExprNode* right = equality();
+		expr = new LogicalNode(tok, tok.type, expr, right);
+	}
+
+	return expr;
 }
 
 ExprNode* Parser::equality()
@@ -374,7 +449,22 @@ ExprNode* Parser::unary()
 		return new UnaryNode(tok, tok.type, expr);
 	}
 
-	return primary();
+	return exponent();
+}
+
+// right-associative and binding tighter than negation: -x ^ 2 ^ 3 is -(x ^ (2 ^ 3))
+ExprNode* Parser::exponent()
+{
+	ExprNode* expr = primary();
+
+	if(match(TOKEN_CARET))
+	{
+		Token tok = _previous;
+		ExprNode* right = unary();
+		expr = new BinaryNode(tok, tok.type, expr, right);
+	}
+
+	return expr;
 }
 
 ExprNode* Parser::primary()
@@ -497,38 +587,113 @@ CallNode* Parser::finish_call(Token tok, Symbol* symbol)
 	return symbol->invalid ? nullptr : new CallNode(tok, symbol, args);
 }
 
-ActionNode* Parser::action()
+ExprNode* Parser::action()
 {
 	CONSUME_OR_RET_NULL(TOKEN_IDENTIFIER, "Expected identifier after '@'.");
 	Token tok = _previous;
-	Action* action = get_action(PREV_TOKEN_STR);
 
-	if(!action) { error("Action does not exist."); return nullptr; }
+	// so do the root search and the map, which take a function instead of a value
+	if(PREV_TOKEN_STR == "root") return finish_root(tok);
+	if(PREV_TOKEN_STR == "map") return finish_map(tok);
+
+	// the conditional looks like an action, but only evaluates the taken branch
+	bool conditional = PREV_TOKEN_STR == "if";
+	Action* action = conditional ? nullptr : get_action(PREV_TOKEN_STR);
+
+	if(!action && !conditional) { error("Action does not exist."); return nullptr; }
+	uint arity = conditional ? 3 : action->arity;
 
 	CONSUME_OR_RET_NULL(TOKEN_LEFT_B_BRACE, "Expected '['.");
 
 	vector<ExprNode*> args;
 	if(!check(TOKEN_RIGHT_B_BRACE)) do args.push_back(expression()); while(match(TOKEN_COMMA));
 
-	if(args.size() != action->arity)
+	if(args.size() != arity)
 	{
 		error_at(&tok, tools::fstr("Expected %d argument%s, but %d were given.",
-			action->arity, action->arity == 1 ? "" : "s", args.size()));
+			arity, arity == 1 ? "" : "s", args.size()));
 		return nullptr;
 	}
 
 	CONSUME_OR_RET_NULL(TOKEN_RIGHT_B_BRACE, "Expected ']' after arguments.");
+
+	if(conditional) return new ConditionalNode(tok, args[0], args[1], args[2]);
 	return new ActionNode(tok, action, args);
 }
 
+// the function after the '[' of @root and @map, null on errors
+Symbol* Parser::unary_function()
+{
+	CONSUME_OR_RET_NULL(TOKEN_LEFT_B_BRACE, "Expected '['.");
+	CONSUME_OR_RET_NULL(TOKEN_IDENTIFIER, "Expected function after '['.");
+	Token ftok = _previous;
+	string name = PREV_TOKEN_STR;
+
+	// allow explicit ID
+	int id = -1;
+	if(match(TOKEN_DOT))
+	{
+		if(!consume(TOKEN_INTEGER, "Expect ID after '.'.")) return nullptr;
+		id = parse_prev_integer();
+	}
+
+	Symbol* symbol = get_symbol(name, id);
+	if(!symbol)
+	{
+		error_at(&ftok, "Symbol does not exist.");
+		return nullptr;
+	}
+
+	if(symbol->target.params.size() != 1)
+	{
+		HOLD_PANIC();
+		error_at(&ftok, "Expected a function of one parameter.");
+		if(!PANIC_HELD) note_declaration("Symbol", name, &symbol->target.token);
+		return nullptr;
+	}
+
+	CONSUME_OR_RET_NULL(TOKEN_COMMA, "Expected ',' after function.");
+	return symbol;
+}
+
+ExprNode* Parser::finish_root(Token tok)
+{
+	Symbol* symbol = unary_function();
+	if(!symbol) return nullptr;
+
+	ExprNode* lo = expression();
+	CONSUME_OR_RET_NULL(TOKEN_COMMA, "Expected ',' after lower bound.");
+	ExprNode* hi = expression();
+	CONSUME_OR_RET_NULL(TOKEN_RIGHT_B_BRACE, "Expected ']' after upper bound.");
+
+	return symbol->invalid ? nullptr : new RootNode(tok, symbol, lo, hi);
+}
+
+ExprNode* Parser::finish_map(Token tok)
+{
+	Symbol* symbol = unary_function();
+	if(!symbol) return nullptr;
+
+	ExprNode* array = expression();
+	CONSUME_OR_RET_NULL(TOKEN_RIGHT_B_BRACE, "Expected ']' after array.");
+
+	return symbol->invalid ? nullptr : new MapNode(tok, symbol, array);
+}
+
 // ======================= misc. =======================
 
 Status Parser::parse(string infile, CCP source, Environment* env)
 {
+	TRACE_SCOPE("parse");
+	PERF_SCOPE("parse");
+	ALLOC_SCOPE("parse");
+	size_t node_count = ast_node_count;
+
 	// set members
 	_scanner = Scanner(new string(infile), source);
 	_scope_stack = vector<Scope>();
 	_current_scope = Scope{map<string, Symbol*>()};
+	_defining = nullptr;
 
 	_env = {};
 
@@ -537,6 +702,7 @@ Status Parser::parse(string infile, CCP source, Environment* env)
 	_error_dispatcher = ErrorDispatcher();
 
 	_main_file = infile;
+	_token_count = 0;
 
 	advance();
 	while (!is_at_end())
@@ -548,6 +714,9 @@ Status Parser::parse(string infile, CCP source, Environment* env)
 
 	DEBUG_PRINT_NL();
 	DEBUG_PRINT_MSG("Parsing complete!");
+
+	TRACE_COUNTER("tokens scanned", _token_count);
+	TRACE_COUNTER("nodes allocated", ast_node_count - node_count);
 	
 	*env = _env;
 	return _had_error ? STATUS_PARSE_ERROR : STATUS_SUCCESS;
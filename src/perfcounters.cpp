@@ -0,0 +1,176 @@
+#include "perfcounters.hpp"
+#include "tools.hpp"
+
+#include <chrono>
+#include <mutex>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+// ==================================================
+
+typedef struct
+{
+	const char* phase;
+	uint runs;
+	perf::Sample total;
+} PhaseTotals;
+
+typedef struct
+{
+	uint tid;
+	int fds[perf::COUNTER_MAX];
+	vector<PhaseTotals> phases;
+} ThreadCounters;
+
+bool perf::enabled = false;
+
+static mutex registry_mutex;
+static vector<ThreadCounters*> registry;
+static string unavailable_reason;
+
+static thread_local ThreadCounters* local_counters = nullptr;
+
+static const char* counter_names[perf::COUNTER_MAX] = {
+	"cycles", "instructions", "branch-misses", "L1d-misses", "LLC-misses"
+};
+
+#ifdef __linux__
+static int open_counter(uint32_t type, uint64_t config)
+{
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	// this thread, any cpu
+	int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	if(fd < 0)
+	{
+		lock_guard<mutex> lock(registry_mutex);
+		if(unavailable_reason.empty()) unavailable_reason = strerror(errno);
+	}
+	return fd;
+}
+#endif
+
+static ThreadCounters* get_counters()
+{
+	if(local_counters) return local_counters;
+
+	ThreadCounters* c = new ThreadCounters();
+	for(int i = 0; i < perf::COUNTER_MAX; i++) c->fds[i] = -1;
+
+	#ifdef __linux__
+	#define CACHE_MISS(cache) (PERF_COUNT_HW_CACHE_##cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) \
+		| (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+	c->fds[perf::COUNTER_CYCLES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	c->fds[perf::COUNTER_INSTRUCTIONS] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+	c->fds[perf::COUNTER_BRANCH_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+	c->fds[perf::COUNTER_L1D_MISSES] = open_counter(PERF_TYPE_HW_CACHE, CACHE_MISS(L1D));
+	c->fds[perf::COUNTER_LLC_MISSES] = open_counter(PERF_TYPE_HW_CACHE, CACHE_MISS(LL));
+	#undef CACHE_MISS
+	#else
+	unavailable_reason = "not supported on " OS_NAME;
+	#endif
+
+	lock_guard<mutex> lock(registry_mutex);
+	c->tid = registry.size();
+	registry.push_back(c);
+	local_counters = c;
+	return c;
+}
+
+static void report_at_exit()
+{
+	//
+	perf::report();
+}
+
+// ==================================================
+
+void perf::enable()
+{
+	enabled = true;
+	atexit(report_at_exit);
+}
+
+perf::Sample perf::sample()
+{
+	ThreadCounters* c = get_counters();
+	Sample s;
+
+	for(int i = 0; i < COUNTER_MAX; i++)
+	{
+		s.counts[i] = 0;
+		#ifdef __linux__
+		uint64_t buf[3]; // value, time enabled, time running
+		if(c->fds[i] < 0 || read(c->fds[i], buf, sizeof(buf)) != sizeof(buf)) continue;
+
+		// scale if the counter was multiplexed
+		s.counts[i] = buf[2] && buf[2] < buf[1] ? (uint64_t)((double)buf[0] * buf[1] / buf[2]) : buf[0];
+		#endif
+	}
+
+	auto t = chrono::steady_clock::now().time_since_epoch();
+	s.time = chrono::duration_cast<chrono::nanoseconds>(t).count();
+	return s;
+}
+
+void perf::add(const char* phase, Sample& start, Sample& end)
+{
+	ThreadCounters* c = get_counters();
+
+	PhaseTotals* totals = nullptr;
+	for(auto& p : c->phases) if(p.phase == phase) { totals = &p; break; }
+	if(!totals)
+	{
+		c->phases.push_back(PhaseTotals{phase, 0, {}});
+		totals = &c->phases.back();
+	}
+
+	totals->runs++;
+	totals->total.time += end.time - start.time;
+	for(int i = 0; i < COUNTER_MAX; i++) totals->total.counts[i] += end.counts[i] - start.counts[i];
+}
+
+// print the totals per thread and phase
+void perf::report()
+{
+	if(!enabled) return;
+	enabled = false;
+
+	lock_guard<mutex> lock(registry_mutex);
+
+	bool any_counter = false;
+	for(auto c : registry) for(int i = 0; i < COUNTER_MAX; i++) any_counter |= c->fds[i] >= 0;
+
+	if(!any_counter) MSG("Hardware counters unavailable (" << unavailable_reason << "), timing only.");
+	MSG("Performance counters:");
+
+	for(auto c : registry)
+	{
+		for(auto& p : c->phases)
+		{
+			string msg = tools::fstr("    thread %u  %-12s %4u run%s %12.3f us",
+				c->tid, p.phase, p.runs, p.runs == 1 ? " " : "s", p.total.time / 1000.0);
+
+			for(int i = 0; i < COUNTER_MAX; i++) if(c->fds[i] >= 0)
+				msg += tools::fstr("  %s %llu", counter_names[i], (unsigned long long)p.total.counts[i]);
+
+			if(c->fds[COUNTER_CYCLES] >= 0 && c->fds[COUNTER_INSTRUCTIONS] >= 0 && p.total.counts[COUNTER_CYCLES])
+				msg += tools::fstr("  IPC %.2f", (double)p.total.counts[COUNTER_INSTRUCTIONS]
+					/ p.total.counts[COUNTER_CYCLES]);
+
+			MSG(msg);
+		}
+	}
+}
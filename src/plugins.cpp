@@ -0,0 +1,97 @@
+#include "symbol.hpp"
+#include "builtins.hpp"
+#include "plugin.hpp"
+#include "tools.hpp"
+
+#include <dlfcn.h>
+
+// plugin actions are called through these, so that their handlers fit the action table
+#define PLUGIN_ACTIONS 256
+
+static const PluginAction* plugin_actions[PLUGIN_ACTIONS];
+static size_t plugin_count = 0;
+
+template<size_t I> static double plugin_handler(Token* tok, Environment* env, double* args)
+{
+	//
+	return plugin_actions[I]->call(args);
+}
+
+template<size_t I> static void plugin_span(Token* tok, Environment* env, const double* const* args, double* out, size_t n)
+{
+	//
+	plugin_actions[I]->span(args, out, n);
+}
+
+typedef double (*Handler)(Token*, Environment*, double*);
+
+template<size_t... I> static Handler handler_at(size_t i, index_sequence<I...>)
+{
+	static const Handler handlers[] = { &plugin_handler<I>... };
+	return handlers[i];
+}
+
+template<size_t... I> static SpanHandler span_at(size_t i, index_sequence<I...>)
+{
+	static const SpanHandler spans[] = { &plugin_span<I>... };
+	return spans[i];
+}
+
+// ==================================================
+
+// the reason an action cannot be added, or an empty string
+static string refuse(const PluginAction& a)
+{
+	if(!a.name || !*a.name) return "an action has no name";
+	if(!a.call) return tools::fstr("@%s has no handler", a.name);
+
+	// plugins never replace actions, nor the conditional, the root search and the map
+	if(get_action(a.name) || !strcmp(a.name, "if") || !strcmp(a.name, "root") || !strcmp(a.name, "map"))
+		return tools::fstr("@%s already exists", a.name);
+	for(const char* c = a.name; *c; c++) if(!isalnum(*c) && *c != '_')
+		return tools::fstr("@%s is not a valid name", a.name);
+
+	if(a.span && !(a.flags & PLUGIN_PURE)) return tools::fstr("@%s has a span handler, but is not pure", a.name);
+	if(a.span && (a.flags & PLUGIN_INTEGRAL)) return tools::fstr("@%s has a span handler, but is integral", a.name);
+	if(plugin_count == PLUGIN_ACTIONS) return tools::fstr("more than %d plugin actions", PLUGIN_ACTIONS);
+	return "";
+}
+
+bool load_plugin(string path)
+{
+	// a path without a slash would be searched for in the library paths instead
+	if(path.find('/') == string::npos) path = "./" + path;
+
+	void* library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if(!library) { ERR("Cannot load plugin " << path << ": " << dlerror()); return false; }
+
+	auto entry = (const Plugin* (*)())dlsym(library, PLUGIN_ENTRY);
+	if(!entry) { ERR("Plugin " << path << " has no entry point " PLUGIN_ENTRY "()."); return false; }
+
+	const Plugin* plugin = entry();
+	if(!plugin || plugin->version != PLUGIN_VERSION)
+	{
+		ERR("Plugin " << path << " was built for interface version " << (plugin ? plugin->version : 0)
+			<< ", expected " << PLUGIN_VERSION << ".");
+		return false;
+	}
+
+	for(size_t i = 0; i < plugin->count; i++)
+	{
+		const PluginAction& a = plugin->actions[i];
+		string reason = refuse(a);
+		if(!reason.empty()) { ERR("Plugin " << plugin->name << ": " << reason << "."); return false; }
+
+		size_t slot = plugin_count++;
+		plugin_actions[slot] = &a;
+
+		Action action = { a.name, a.arity, (a.flags & PLUGIN_PURE) != 0, (a.flags & PLUGIN_INTEGRAL) != 0,
+			(a.flags & PLUGIN_NUMERIC) == PLUGIN_NUMERIC, handler_at(slot, make_index_sequence<PLUGIN_ACTIONS>()) };
+		if(a.span) action.span = span_at(slot, make_index_sequence<PLUGIN_ACTIONS>());
+		action.partials = a.partials;
+		actions.push_back(action);
+	}
+
+	// the library stays loaded, its actions are used until the end
+	return true;
+}
@@ -1,9 +1,16 @@
 #include "printer.hpp"
+#include "tracer.hpp"
+#include "allocstats.hpp"
 
 string Printer::print(Symbol* symbol)
 {
+	TRACE_SCOPE("print");
+	ALLOC_SCOPE("print");
+
 	_stream = stringstream();
-	_args_stack = stack<vector<ExprNode*>>();
+	_frames = {Frame{nullptr, 0, symbol}};
+	_frame = 0;
+	_symbol = symbol;
 
 	PRINT(symbol->get_ident() + " = ");
 	symbol->body->accept(this);
@@ -40,6 +47,21 @@ VISIT(BinaryNode)
 		case TOKEN_MINUS: 			PRINT(" - "); break;
 		case TOKEN_STAR:  			PRINT(" * "); break;
 		case TOKEN_SLASH:			PRINT(" / "); break;
+		case TOKEN_CARET:			PRINT(" ^ "); break;
+		default: THROW_INTERNAL_ERROR("during printing");
+	}
+
+	node->_right->accept(this);
+}
+
+VISIT(LogicalNode)
+{
+	node->_left->accept(this);
+
+	switch(node->_optype)
+	{
+		case TOKEN_AND:				PRINT(" and "); break;
+		case TOKEN_OR:				PRINT(" or "); break;
 		default: THROW_INTERNAL_ERROR("during printing");
 	}
 
@@ -63,6 +85,36 @@ VISIT(GroupingNode)
 	PRINT(")");
 }
 
+VISIT(ConditionalNode)
+{
+	PRINT("@if[");
+	node->_cond->accept(this);
+	PRINT(", ");
+	node->_then->accept(this);
+	PRINT(", ");
+	node->_else->accept(this);
+	PRINT("]");
+}
+
+VISIT(PolynomialNode)
+{
+	// as a sum of powers, without the zero terms
+	bool first = true;
+	for(size_t i = 0; i < node->_coefs.size(); i++)
+	{
+		if(node->_coefs[i] == 0) continue;
+		if(!first) PRINT(" + ");
+		first = false;
+
+		PRINT(node->_coefs[i]);
+		if(i == 0) continue;
+		PRINT(" * ");
+		node->_var->accept(this);
+		if(i > 1) PRINT(" ^ " << i);
+	}
+	if(first) PRINT(0);
+}
+
 VISIT(NumberNode)
 {
 	// just print the node's value
@@ -71,24 +123,60 @@ VISIT(NumberNode)
 
 VISIT(VariableNode)
 {
+	// recursive references are not expanded
+	if(node->_symbol == _symbol) { PRINT(node->_symbol->get_ident()); return; }
+	Symbol* symbol = _symbol;
+
 	PRINT("(");
-	if(node->_symbol->id >= 0) node->_symbol->body->accept(this);
-	else _args_stack.top()[-node->_symbol->id - 1]->accept(this);
+	if(node->_symbol->id >= 0)
+	{
+		_symbol = node->_symbol;
+		node->_symbol->body->accept(this);
+	}
+	else
+	{
+		// arguments are printed in the frame of their call site
+		size_t callee = _frame;
+		_frame = _frames[callee].caller;
+		_symbol = _frames[callee].caller_symbol;
+		(*_frames[callee].args)[-node->_symbol->id - 1]->accept(this);
+		_frame = callee;
+	}
 	PRINT(")");
+
+	_symbol = symbol;
 }
 
 VISIT(CallNode)
 {
+	// recursive calls are not expanded
+	if(node->_symbol == _symbol)
+	{
+		PRINT(node->_symbol->get_ident() + "(");
+		for(auto a : node->_args)
+		{
+			a->accept(this);
+			if(a != node->_args.back()) PRINT(", ");
+		}
+		PRINT(")");
+		return;
+	}
+	Symbol* symbol = _symbol;
+
 	// set args
-	_args_stack.push({});
-	for(auto a : node->_args) _args_stack.top().push_back(a);
+	size_t caller = _frame;
+	_frames.push_back(Frame{&node->_args, caller, symbol});
+	_frame = _frames.size() - 1;
 
 	// visit body
 	PRINT("(");
+	_symbol = node->_symbol;
 	node->_symbol->body->accept(this);
 	PRINT(")");
 
-	_args_stack.pop();
+	_frames.pop_back();
+	_frame = caller;
+	_symbol = symbol;
 }
 
 VISIT(ActionNode)
@@ -103,4 +191,21 @@ VISIT(ActionNode)
 	PRINT("]");
 }
 
+VISIT(RootNode)
+{
+	// the function is named, not expanded
+	PRINT("@root[" + node->_symbol->get_ident() + ", ");
+	node->_lo->accept(this);
+	PRINT(", ");
+	node->_hi->accept(this);
+	PRINT("]");
+}
+
+VISIT(MapNode)
+{
+	PRINT("@map[" + node->_symbol->get_ident() + ", ");
+	node->_array->accept(this);
+	PRINT("]");
+}
+
 #undef VISIT
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include "resolver.hpp"
+#include "tracer.hpp"
+#include "tools.hpp"
+#include "builtins.hpp"
+
+#include <algorithm>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+Resolver::~Resolver()
+{
+	//
+	if(_fd >= 0) close(_fd);
+}
+
+bool Resolver::connect(string path)
+{
+	TRACE_SCOPE("connect resolver");
+	_path = path;
+
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if(path.size() >= sizeof(address.sun_path)) { ERR("Resolver socket path \"" << path << "\" is too long."); return false; }
+	strcpy(address.sun_path, path.c_str());
+
+	_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(_fd < 0 || ::connect(_fd, (sockaddr*)&address, sizeof(address)))
+		{ ERR("Cannot connect to resolver \"" << path << "\": " << strerror(errno)); return false; }
+
+	// a service that stops answering fails the solve instead of hanging it
+	timeval timeout = {RESOLVER_TIMEOUT, 0};
+	setsockopt(_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+	return true;
+}
+
+void Resolver::fail(string what)
+{
+	ERR("Resolver \"" << _path << "\" " << what << ": " << (errno ? strerror(errno) : "connection closed") << ".");
+	ABORT(STATUS_SOLVE_ERROR);
+}
+
+// ==================================================
+
+void Resolver::send(const vector<uint>& addrs)
+{
+	uint32_t count = addrs.size();
+	static_assert(sizeof(uint) == sizeof(uint32_t), "addresses are sent as they are");
+	errno = 0;
+	if(!kv::write_all(_fd, &count, sizeof(count)) || !kv::write_all(_fd, addrs.data(), count * sizeof(uint32_t)))
+		fail("failed to take a request");
+
+	_pending.push_back(addrs);
+	stats.requests++;
+	stats.addresses += count;
+}
+
+// reads the answers to all requests sent so far
+void Resolver::receive()
+{
+	TRACE_SCOPE("resolve");
+
+	for(auto& addrs : _pending)
+	{
+		size_t n = addrs.size();
+		vector<double> values(n);
+		vector<uint8_t> found(n);
+		errno = 0;
+		if(!kv::read_all(_fd, values.data(), n * sizeof(double)) || !kv::read_all(_fd, found.data(), n))
+			fail("failed to answer");
+
+		for(size_t i = 0; i < n; i++)
+		{
+			_values[addrs[i]] = make_pair(found[i] != 0, values[i]);
+			stats.found += found[i] != 0;
+		}
+	}
+	_pending.clear();
+}
+
+// sends a request for addresses that are known before solving, its answer is read once a value is needed
+void Resolver::prefetch(const vector<uint>& addrs)
+{
+	lock_guard<mutex> lock(_mutex);
+	if(addrs.empty() || addrs.size() > KV_MAX_COUNT) return;
+
+	send(addrs);
+	stats.prefetched += addrs.size();
+}
+
+// fetches the values of all addresses that are not known yet in one request
+void Resolver::fetch(const vector<uint>& addrs)
+{
+	lock_guard<mutex> lock(_mutex);
+	if(!_pending.empty()) receive();
+
+	vector<uint> missing;
+	for(auto a : addrs) if(!_values.count(a)) missing.push_back(a);
+	sort(missing.begin(), missing.end());
+	missing.erase(unique(missing.begin(), missing.end()), missing.end());
+
+	for(size_t i = 0; i < missing.size(); i += KV_MAX_COUNT)
+		send(vector<uint>(missing.begin() + i, missing.begin() + min(missing.size(), i + KV_MAX_COUNT)));
+	receive();
+}
+
+bool Resolver::lookup(uint addr, double& value)
+{
+	lock_guard<mutex> lock(_mutex);
+	if(!_pending.empty()) receive();
+
+	auto it = _values.find(addr);
+	if(it == _values.end())
+	{
+		send({addr});
+		receive();
+		it = _values.find(addr);
+	}
+
+	value = it->second.second;
+	return it->second.first;
+}
+
+// ==================================================
+
+vector<uint> AddressCollector::collect(Symbol* symbol)
+{
+	_get = get_action("get");
+	_reached.clear();
+	_addrs.clear();
+	reach(symbol);
+	return vector<uint>(_addrs.begin(), _addrs.end());
+}
+
+void AddressCollector::reach(Symbol* symbol)
+{
+	//
+	if(_reached.insert(symbol).second) symbol->body->accept(this);
+}
+
+#define VISIT(_node) void AddressCollector::visit(_node* node)
+
+VISIT(AssignNode)
+{
+	// this kind of node should never be collected from
+	THROW_INTERNAL_ERROR("during resolving");
+}
+
+VISIT(BinaryNode)
+{
+	node->_left->accept(this);
+	node->_right->accept(this);
+}
+
+VISIT(LogicalNode)
+{
+	node->_left->accept(this);
+	node->_right->accept(this);
+}
+
+VISIT(UnaryNode)
+{
+	//
+	node->_expr->accept(this);
+}
+
+VISIT(GroupingNode)
+{
+	//
+	node->_expr->accept(this);
+}
+
+VISIT(ConditionalNode)
+{
+	// both branches may be taken
+	node->_cond->accept(this);
+	node->_then->accept(this);
+	node->_else->accept(this);
+}
+
+VISIT(PolynomialNode)
+{
+	//
+	node->_var->accept(this);
+}
+
+VISIT(NumberNode)
+{
+	// nothing to collect
+}
+
+VISIT(VariableNode)
+{
+	//
+	if(node->_symbol->id >= 0) reach(node->_symbol);
+}
+
+VISIT(CallNode)
+{
+	for(auto a : node->_args) a->accept(this);
+	reach(node->_symbol);
+}
+
+VISIT(ActionNode)
+{
+	for(auto a : node->_args) a->accept(this);
+
+	// the optimizer has folded constant addresses into numbers
+	ExprNode* addr = node->_action == _get ? node->_args[0] : nullptr;
+	while(GroupingNode* g = dynamic_cast<GroupingNode*>(addr)) addr = g->_expr;
+	NumberNode* number = dynamic_cast<NumberNode*>(addr);
+	if(number && number->_value == (uint)number->_value) _addrs.insert(number->_value);
+}
+
+VISIT(RootNode)
+{
+	node->_lo->accept(this);
+	node->_hi->accept(this);
+	reach(node->_symbol);
+}
+
+VISIT(MapNode)
+{
+	node->_array->accept(this);
+	reach(node->_symbol);
+}
+
+#undef VISIT
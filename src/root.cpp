@@ -0,0 +1,61 @@
+#include "root.hpp"
+
+// takes f and its slope at both bounds, the slopes may be NaN, returns true if done already
+bool RootSearch::start(double lo, double flo, double slo, double hi, double fhi, double shi, RootControls controls)
+{
+	if(lo > hi) { swap(lo, hi); swap(flo, fhi); swap(slo, shi); }
+
+	_controls = controls;
+	_iterations = 0;
+	_a = lo; _fa = flo;
+	_b = hi; _fb = fhi;
+	_step = _before = hi - lo;
+	root = NAN;
+
+	// the first step starts from the bound closer to the root
+	bool low = fabs(flo) < fabs(fhi);
+	_x = low ? lo : hi;
+	_fx = low ? flo : fhi;
+	_slope = low ? slo : shi;
+	if(!isfinite(_slope)) _slope = (fhi - flo) / (hi - lo);
+
+	if(flo == 0) { root = lo; return true; }
+	if(fhi == 0) { root = hi; return true; }
+
+	// without a sign change nothing is bracketed
+	return isnan(flo) || isnan(fhi) || signbit(flo) == signbit(fhi);
+}
+
+// the next point to evaluate f at
+double RootSearch::next()
+{
+	double x = _x - _fx / _slope;
+	double step = fabs(x - _x);
+
+	if(!(x > _a && x < _b) || step > _before / 2)
+	{
+		x = _a + (_b - _a) / 2;
+		step = (_b - _a) / 2;
+	}
+
+	_before = _step;
+	_step = step;
+	return x;
+}
+
+// takes f and its slope at the point returned by next(), the slope may be NaN, returns true once done
+bool RootSearch::update(double x, double fx, double slope)
+{
+	_iterations++;
+	if(isnan(fx)) return true;
+	if(fx == 0) { root = x; return true; }
+
+	if(signbit(fx) == signbit(_fa)) { _a = x; _fa = fx; }
+	else { _b = x; _fb = fx; }
+	_slope = isfinite(slope) ? slope : (fx - _fx) / (x - _x);
+	_x = x;
+	_fx = fx;
+
+	if(_step <= _controls.tolerance * max(1.0, fabs(x))) { root = x; return true; }
+	return _iterations >= _controls.max_iterations;
+}
@@ -150,7 +150,16 @@ Token Scanner::identifier()
 	while (isAlpha(peek()) || isDigit(peek())) advance();
 	while(peek() == '\'') advance();
 
-	return makeToken(TOKEN_IDENTIFIER);
+	return makeToken(identifierType());
+}
+
+TokenType Scanner::identifierType()
+{
+	int length = (int)(_current - _start);
+
+	if(length == 3 && !strncmp(_start, "and", 3)) return TOKEN_AND;
+	if(length == 2 && !strncmp(_start, "or", 2)) return TOKEN_OR;
+	return TOKEN_IDENTIFIER;
 }
 
 void Scanner::skipWhitespaces()
@@ -229,6 +238,7 @@ Token Scanner::scanToken()
 		
 		case '+': return makeToken(TOKEN_PLUS);
 		case '*': return makeToken(TOKEN_STAR);
+		case '^': return makeToken(TOKEN_CARET);
 
 		// two-character
 		case '=': return makeToken(match('=') ? TOKEN_EQUAL_EQUAL	: TOKEN_EQUAL);
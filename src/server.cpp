@@ -0,0 +1,197 @@
+#include "server.hpp"
+#include "bindfile.hpp"
+#include "tracer.hpp"
+#include "tools.hpp"
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <unistd.h>
+
+// the answers are the only output on stdout
+static ostream answers(nullptr);
+
+// unanswered bytes of stdin
+typedef struct
+{
+	vector<char> data = vector<char>(SERVER_READ_SIZE);
+	size_t begin = 0;
+	size_t end = 0;
+	bool lines; // a last line without a newline gets one
+	bool eof = false;
+} Input;
+
+// reads more input behind the unanswered bytes, false at its end
+static bool fill(Input& in)
+{
+	if(in.eof) return false;
+
+	// the unanswered bytes move to the front, a line longer than the buffer grows it
+	memmove(in.data.data(), in.data.data() + in.begin, in.end - in.begin);
+	in.end -= in.begin;
+	in.begin = 0;
+	if(in.end == in.data.size()) in.data.resize(in.data.size() * 2);
+
+	// everything read so far is answered, so the answers go out before waiting for more
+	answers.flush();
+
+	ssize_t n;
+	do n = read(STDIN_FILENO, in.data.data() + in.end, in.data.size() - in.end);
+	while(n < 0 && errno == EINTR);
+
+	if(n > 0) { in.end += n; return true; }
+
+	in.eof = true;
+	if(!in.lines || in.begin == in.end) return false;
+	in.data[in.end++] = '\n';
+	return true;
+}
+
+static void write_result(double result)
+{
+	char text[32];
+	int n = snprintf(text, sizeof(text), "%.17g\n", result);
+	answers.write(text, n);
+}
+
+// ==================================================
+
+// parses "ADDR -> VALUE" into a binding, false if the line is none
+static bool parse_binding(const char* line, uint& addr, double& value)
+{
+	char *end;
+	if(*line == '-') return false;
+	unsigned long long a = strtoull(line, &end, 0);
+	if(end == line || a > UINT_MAX) return false;
+
+	while(isspace(*end)) end++;
+	if(strncmp(end, "->", 2)) return false;
+	line = end + 2;
+
+	value = strtod(line, &end);
+	if(end == line || *end) return false;
+	addr = (uint)a;
+	return true;
+}
+
+static void answer_line(char* line, Environment* env, Symbol* symbol, Solver& solver)
+{
+	// surrounding whitespace and carriage returns are ignored, empty lines are no requests
+	size_t length = strlen(line);
+	while(length && isspace(line[length - 1])) line[--length] = '\0';
+	while(isspace(*line)) line++;
+	if(!*line) return;
+
+	if(!strcmp(line, "solve"))
+	{
+		refresh_shared(env);
+		Status status = solver.solve(env, symbol);
+		if(status == STATUS_SUCCESS) write_result(solver.result);
+		else answers << "error Solving failed with code " << status << ".\n";
+		return;
+	}
+
+	uint addr;
+	double value;
+	if(!parse_binding(line, addr, value)) { answers << "error Invalid request '" << line << "'.\n"; return; }
+
+	BoundValue& bound = env->bindings[addr];
+	bound.type = BoundValue::NUMBER;
+	bound.as.num = value;
+}
+
+static Status serve_text(Environment* env, Symbol* symbol, Solver& solver)
+{
+	Input in;
+	in.lines = true;
+
+	for(;;)
+	{
+		char* line = in.data.data() + in.begin;
+		char* newline = (char*)memchr(line, '\n', in.end - in.begin);
+		if(!newline)
+		{
+			if(!fill(in)) return STATUS_SUCCESS;
+			continue;
+		}
+
+		*newline = '\0';
+		in.begin = newline + 1 - in.data.data();
+		answer_line(line, env, symbol, solver);
+	}
+}
+
+// ==================================================
+
+#define REQUEST_BIND 'b'
+#define REQUEST_SOLVE 's'
+
+static Status serve_binary(Environment* env, Symbol* symbol, Solver& solver)
+{
+	Input in;
+	in.lines = false;
+
+	for(;;)
+	{
+		if(in.begin == in.end && !fill(in)) return STATUS_SUCCESS;
+
+		char request = in.data[in.begin];
+		size_t size = request == REQUEST_BIND ? 1 + sizeof(uint32_t) + sizeof(double) : 1;
+		while(in.end - in.begin < size) if(!fill(in))
+		{
+			ERR("Truncated request at the end of the input.");
+			return STATUS_CLI_ERROR;
+		}
+
+		const char* data = in.data.data() + in.begin;
+		in.begin += size;
+
+		if(request == REQUEST_BIND)
+		{
+			uint32_t addr;
+			double value;
+			memcpy(&addr, data + 1, sizeof(addr));
+			memcpy(&value, data + 1 + sizeof(addr), sizeof(value));
+
+			BoundValue& bound = env->bindings[addr];
+			bound.type = BoundValue::NUMBER;
+			bound.as.num = value;
+		}
+		else if(request == REQUEST_SOLVE)
+		{
+			// a failed solve is answered with NaN, its reason goes to stderr
+			refresh_shared(env);
+			double result = solver.solve(env, symbol) == STATUS_SUCCESS ? solver.result : nan("<failed>");
+			answers.write((const char*)&result, sizeof(result));
+		}
+		else
+		{
+			// the framing is lost, nothing after this byte can be read
+			ERR(tools::fstr("Unknown request 0x%02x.", (unsigned char)request));
+			return STATUS_CLI_ERROR;
+		}
+	}
+}
+
+void take_stdout()
+{
+	if(answers.rdbuf()) return;
+
+	// cout gets a buffer of its own, it is only flushed when waiting for input
+	ios::sync_with_stdio(false);
+
+	// the answers keep it, everything else printed from here on, by @print and
+	// @printb, the verbose messages or the reports at the end, goes to stderr
+	answers.rdbuf(cout.rdbuf());
+	cout.rdbuf(cerr.rdbuf());
+}
+
+Status serve(Environment* env, Symbol* symbol, Solver& solver, Framing framing)
+{
+	TRACE_SCOPE("serve");
+
+	take_stdout();
+	Status status = framing == FRAMING_BINARY ? serve_binary(env, symbol, solver) : serve_text(env, symbol, solver);
+	answers.flush();
+	return status;
+}
@@ -1,39 +1,278 @@
 #include "solver.hpp"
+#include "gradient.hpp"
+#include "batch.hpp"
+#include "tracer.hpp"
+#include "perfcounters.hpp"
+#include "allocstats.hpp"
+#include "error.hpp"
+#include "tools.hpp"
+#include "builtins.hpp"
+
+#include <chrono>
+
+uint64_t now_us()
+{
+	auto t = chrono::steady_clock::now().time_since_epoch();
+	return chrono::duration_cast<chrono::microseconds>(t).count();
+}
+
+// ==================================================
+
+void Budget::start(Limits limits, Symbol* symbol)
+{
+	// the periodic check is skipped entirely without limits
+	_limits = limits;
+	_max_nesting = limits.max_nesting ? limits.max_nesting : SIZE_MAX;
+	_stack_base = (uintptr_t)__builtin_frame_address(0);
+	_deadline = limits.timeout_us ? now_us() + limits.timeout_us : 0;
+	next_check = limits.max_steps || limits.timeout_us || limits.max_memory ? 0 : UINT64_MAX;
+	steps = 0;
+	nesting = 0;
+	this->symbol = symbol;
+	status = STATUS_SUCCESS;
+}
+
+// called every SOLVER_BUDGET_INTERVAL steps, returns false if a limit was exceeded
+bool Budget::check(size_t memory)
+{
+	if(status != STATUS_SUCCESS) return false;
+
+	if(_limits.max_steps && steps > _limits.max_steps)
+	{
+		exceed(tools::fstr("Step limit of %llu exceeded", (unsigned long long)_limits.max_steps));
+		return false;
+	}
+	if(_deadline && now_us() > _deadline)
+	{
+		exceed(tools::fstr("Deadline of %g ms exceeded", _limits.timeout_us / 1000.0));
+		return false;
+	}
+	if(_limits.max_memory && memory > _limits.max_memory)
+	{
+		exceed(tools::fstr("Memory limit of %zu bytes exceeded", _limits.max_memory));
+		return false;
+	}
+
+	next_check = steps + SOLVER_BUDGET_INTERVAL;
+	if(_limits.max_steps && next_check > _limits.max_steps + 1) next_check = _limits.max_steps + 1;
+	return true;
+}
+
+// returns false if entering the symbol nests too deep
+bool Budget::enter(Symbol* symbol)
+{
+	this->symbol = symbol;
+	size_t stack = _stack_base - (uintptr_t)__builtin_frame_address(0);
+	if(++nesting <= _max_nesting && stack < SOLVER_NATIVE_STACK_LIMIT) return true;
+
+	if(status != STATUS_SUCCESS) return false;
+	if(nesting > _max_nesting) exceed(tools::fstr("Nesting limit of %zu exceeded", _limits.max_nesting));
+	else exceed(tools::fstr("Native stack limit of %d bytes exceeded", SOLVER_NATIVE_STACK_LIMIT));
+	return false;
+}
+
+// abort the solve, every visit bails out from here on
+void Budget::exceed(string what)
+{
+	status = STATUS_LIMIT_ERROR;
+	next_check = 0;
+	_max_nesting = 0;
+
+	ErrorDispatcher dispatcher = ErrorDispatcher();
+	string msg = what + " while evaluating '" + symbol->get_ident() + "'.";
+	dispatcher.error_at_token(&symbol->target.token, "Limit Error", msg.c_str());
+	cerr << endl;
+	dispatcher.print_token_marked(&symbol->target.token, COLOR_RED);
+}
+
+// ==================================================
+
+Solver::Solver()
+{
+	// preallocate so that solving does not have to
+	_value_stack.reserve(SOLVER_VALUE_STACK_INIT);
+	_frames.reserve(SOLVER_FRAME_STACK_INIT);
+	_arg_values.reserve(SOLVER_FRAME_STACK_INIT);
+	_arg_ready.reserve(SOLVER_FRAME_STACK_INIT);
+}
+
+Solver::~Solver()
+{
+	delete _slopes;
+	delete _mapper;
+}
 
 Status Solver::solve(Environment* env, Symbol* symbol)
+{
+	TRACE_SCOPE("solve");
+	PERF_SCOPE("solve");
+	ALLOC_SCOPE("solve");
+
+	start(env, symbol);
+
+	result = value(symbol->body);
+	if(isnan(result)) result = nan("<NaN>");
+
+	TRACE_COUNTER("value stack depth", _max_depth);
+	TRACE_COUNTER("evaluation steps", _budget.steps);
+
+	return _budget.status;
+}
+
+// solves several symbols in the same epoch and on the same budget, so that with
+// STRATEGY_MEMO the symbols they share, and they themselves, are evaluated once
+Status Solver::solve(Environment* env, const vector<Symbol*>& symbols)
+{
+	TRACE_SCOPE("solve");
+	PERF_SCOPE("solve");
+	ALLOC_SCOPE("solve");
+
+	results.assign(symbols.size(), nan("<no result>"));
+	start(env, symbols[0]);
+
+	for(size_t i = 0; i < symbols.size() && _budget.status == STATUS_SUCCESS; i++)
+	{
+		results[i] = target(symbols[i]);
+		if(isnan(results[i])) results[i] = nan("<NaN>");
+	}
+	result = results[0];
+
+	TRACE_COUNTER("value stack depth", _max_depth);
+	TRACE_COUNTER("evaluation steps", _budget.steps);
+
+	return _budget.status;
+}
+
+void Solver::start(Environment* env, Symbol* symbol)
 {
 	// reset result real quick
 	result = nan("<no result>");
-	_args_stack = {};
-	_value_stack = {};
+	_value_stack.clear();
+	_frames.clear();
+	_arg_values.clear();
+	_arg_ready.clear();
+	_max_depth = 0;
 	_env = env;
 
-	symbol->body->accept(this);
-	result = pop();
-	if(isnan(result)) result = nan("<NaN>");
+	// top-level frame without arguments
+	_frames.push_back(Frame{nullptr, 0, symbol, 0, 0});
+	_frame = 0;
+	_path = 0;
 
-	return STATUS_SUCCESS;
+	// a new epoch invalidates all memoized symbols at once
+	_epoch++;
+	if(strategy == STRATEGY_MEMO && _memo_epochs.size() < env->symbols.size())
+	{
+		_memo_values.resize(env->symbols.size());
+		_memo_epochs.resize(env->symbols.size(), 0);
+	}
+
+	_budget.start(limits, symbol);
+}
+
+// the value of a symbol being solved for, memoized like the references to it
+double Solver::target(Symbol* symbol)
+{
+	_frames[0].caller_symbol = symbol;
+	_budget.symbol = symbol;
+	if(strategy != STRATEGY_MEMO) return value(symbol->body);
+
+	uint index = symbol->index;
+	if(_memo_epochs[index] != _epoch)
+	{
+		symbol->body->accept(this);
+		_memo_values[index] = pop();
+		_memo_epochs[index] = _epoch;
+	}
+	push(_memo_values[index]);
+	convert(symbol->body->_type, TYPE_FLOAT);
+	return pop();
+}
+
+RootStats Solver::root_stats()
+{
+	// roots are searched by the gradient solver, and by the batch solver inside of @map
+	RootStats stats = _slopes ? _slopes->root_stats : RootStats{0, 0, 0};
+	if(_mapper)
+	{
+		stats.roots += _mapper->root_stats.roots;
+		stats.failures += _mapper->root_stats.failures;
+		stats.evaluations += _mapper->root_stats.evaluations;
+	}
+	return stats;
+}
+
+size_t Solver::memory()
+{
+	//
+	return _value_stack.size() * sizeof(double) + _frames.size() * sizeof(Frame);
 }
 
 void Solver::push(double value)
 {
 	// just push the value
-	_value_stack.push(value);
+	_value_stack.push_back(value);
+	if(_value_stack.size() > _max_depth) _max_depth = _value_stack.size();
 }
 
 double Solver::pop()
 {
 	ASSERT_OR_THROW_INTERNAL_ERROR(!_value_stack.empty(), "during solving");
-	double value = _value_stack.top();
-	_value_stack.pop();
+	double value = _value_stack.back();
+	_value_stack.pop_back();
 	return value;
 }
 
+void Solver::push_int(int64_t value)
+{
+	double slot;
+	memcpy(&slot, &value, sizeof(slot));
+	push(slot);
+}
+
+int64_t Solver::pop_int()
+{
+	double slot = pop();
+	int64_t value;
+	memcpy(&value, &slot, sizeof(value));
+	return value;
+}
+
+// converts the value on top of the stack
+void Solver::convert(NumType from, NumType to)
+{
+	if(from == to) return;
+	if(to == TYPE_FLOAT) push((double)pop_int());
+	else push_int((int64_t)pop());
+}
+
+// pushes the value of an expression as the given type
+void Solver::evaluate(ExprNode* expr, NumType type)
+{
+	expr->accept(this);
+	convert(expr->_type, type);
+}
+
+double Solver::value(ExprNode* expr)
+{
+	evaluate(expr, TYPE_FLOAT);
+	return pop();
+}
+
+int64_t Solver::integer(ExprNode* expr)
+{
+	expr->accept(this);
+	return pop_int();
+}
+
 // =========================================
 // All visit methods MUST push a value!
 
 #define VISIT(_node) void Solver::visit(_node* node)
 
+// counts the step and bails out once a limit has been exceeded
+#define CHECK_BUDGET() if(++_budget.steps >= _budget.next_check && !_budget.check(memory())) { push(NAN); return; }
+
 VISIT(AssignNode)
 {
 	// this kind of node should never be solved for
@@ -42,81 +281,222 @@ VISIT(AssignNode)
 
 VISIT(BinaryNode)
 {
-	node->_left->accept(this);
-	double lhs = pop();
-	node->_right->accept(this);
-	double rhs = pop();
+	CHECK_BUDGET();
 
-	switch(node->_optype)
+	// integral operands are exact, the result is only rounded if it is a float
+	if(node->_left->_type == TYPE_INT && node->_right->_type == TYPE_INT)
 	{
-		case TOKEN_EQUAL_EQUAL:		push(lhs == rhs); break;
-		case TOKEN_SLASH_EQUAL:		push(lhs /= rhs); break;
-
-		case TOKEN_GREATER_EQUAL:	push(lhs >= rhs); break;
-		case TOKEN_LESS_EQUAL:		push(lhs <= rhs); break;
-		case TOKEN_GREATER:			push(lhs > rhs); break;
-		case TOKEN_LESS:			push(lhs < rhs); break;
-
-		case TOKEN_PLUS:  			push(lhs + rhs); break;
-		case TOKEN_MINUS: 			push(lhs - rhs); break;
-		case TOKEN_STAR:  			push(lhs * rhs); break;
-		case TOKEN_SLASH:			push(lhs / rhs); break;
-		default: THROW_INTERNAL_ERROR("during solving");
+		int64_t lhs = integer(node->_left);
+		int64_t rhs = integer(node->_right);
+		if(node->_type == TYPE_INT) push_int(apply_binary(node->_optype, lhs, rhs));
+		else push(apply_binary<double>(node->_optype, lhs, rhs));
+		return;
 	}
+
+	double lhs = value(node->_left);
+	double rhs = value(node->_right);
+
+	// comparisons are integral
+	push(apply_binary(node->_optype, lhs, rhs));
+	convert(TYPE_FLOAT, node->_type);
 }
 
-VISIT(UnaryNode)
+VISIT(LogicalNode)
 {
-	node->_expr->accept(this);
-	double val = pop();
+	CHECK_BUDGET();
+	double lhs = value(node->_left);
 
+	// the right operand is skipped if the left one decides the result
 	switch(node->_optype)
 	{
-		case TOKEN_MINUS:  	  	push(- val); break;
+		case TOKEN_AND: if(lhs == 0) { push_int(0); return; } break;
+		case TOKEN_OR:  if(lhs != 0) { push_int(1); return; } break;
 		default: THROW_INTERNAL_ERROR("during solving");
 	}
+
+	push_int(value(node->_right) != 0);
+}
+
+VISIT(UnaryNode)
+{
+	CHECK_BUDGET();
+
+	if(node->_type == TYPE_INT) push_int(apply_unary(node->_optype, integer(node->_expr)));
+	else push(apply_unary(node->_optype, value(node->_expr)));
 }
 
 VISIT(GroupingNode)
 {
+	CHECK_BUDGET();
+
 	// just accept expr inside
 	node->_expr->accept(this);
 }
 
+VISIT(ConditionalNode)
+{
+	CHECK_BUDGET();
+
+	// only the taken branch is evaluated
+	if(value(node->_cond) != 0) evaluate(node->_then, node->_type);
+	else evaluate(node->_else, node->_type);
+}
+
+VISIT(PolynomialNode)
+{
+	CHECK_BUDGET();
+	double x = value(node->_var);
+
+	push(horner(node->_coefs, x));
+}
+
 VISIT(NumberNode)
 {
+	CHECK_BUDGET();
+
 	// just push the node's value
-	push(node->_value);
+	if(node->_type == TYPE_INT) push_int((int64_t)node->_value);
+	else push(node->_value);
 }
 
 VISIT(VariableNode)
 {
-	if(node->_symbol->id >= 0) node->_symbol->body->accept(this);
-	else _args_stack.top()[-node->_symbol->id - 1]->accept(this);
+	CHECK_BUDGET();
+	Symbol* symbol = _budget.symbol;
+
+	if(node->_symbol->id >= 0)
+	{
+		// symbols referring to themselves are floats, even if their body is integral
+		uint index = node->_symbol->index;
+		NumType type = node->_symbol->body->_type;
+		if(strategy == STRATEGY_MEMO && _memo_epochs[index] == _epoch)
+			{ push(_memo_values[index]); convert(type, node->_type); return; }
+
+		// parameterless symbols draw the same wherever they are used
+		uint32_t path = _path;
+		_path = 0;
+		if(_budget.enter(node->_symbol)) node->_symbol->body->accept(this);
+		else push(NAN);
+		_path = path;
+
+		if(strategy == STRATEGY_MEMO)
+		{
+			_memo_values[index] = _value_stack.back();
+			_memo_epochs[index] = _epoch;
+		}
+		convert(type, node->_type);
+	}
+	else
+	{
+		size_t callee = _frame;
+		size_t param = -node->_symbol->id - 1;
+		size_t slot = _frames[callee].cache + param;
+		if(strategy != STRATEGY_LAZY && _arg_ready[slot]) { push(_arg_values[slot]); return; }
+
+		// arguments are evaluated in the frame of their call site
+		ExprNode* arg = (*_frames[callee].args)[param];
+		uint32_t path = _path;
+
+		_frame = _frames[callee].caller;
+		_path = _frames[callee].path;
+		if(_budget.enter(_frames[callee].caller_symbol)) evaluate(arg, TYPE_FLOAT);
+		else push(NAN);
+		_frame = callee;
+		_path = path;
+
+		if(strategy != STRATEGY_LAZY)
+		{
+			_arg_values[slot] = _value_stack.back();
+			_arg_ready[slot] = 1;
+		}
+	}
+
+	_budget.nesting--;
+	_budget.symbol = symbol;
 }
 
 VISIT(CallNode)
 {
+	CHECK_BUDGET();
+	Symbol* symbol = _budget.symbol;
+
 	// set args
-	_args_stack.push({});
-	for(auto a : node->_args) _args_stack.top().push_back(a);
+	size_t caller = _frame;
+	size_t cache = _arg_values.size();
+	_frames.push_back(Frame{&node->_args, caller, symbol, cache, _path});
+	_frame = _frames.size() - 1;
+	_path = call_path(_path, &node->_token);
+
+	if(strategy != STRATEGY_LAZY)
+	{
+		_arg_values.resize(cache + node->_args.size());
+		_arg_ready.resize(cache + node->_args.size(), 0);
+	}
 
 	// visit body
-	node->_symbol->body->accept(this);
+	if(_budget.enter(node->_symbol)) evaluate(node->_symbol->body, node->_type);
+	else push(NAN);
+
+	if(strategy != STRATEGY_LAZY)
+	{
+		_arg_values.resize(cache);
+		_arg_ready.resize(cache);
+	}
 
-	_args_stack.pop();
+	_path = _frames.back().path;
+	_frames.pop_back();
+	_frame = caller;
+	_budget.nesting--;
+	_budget.symbol = symbol;
 }
 
 VISIT(ActionNode)
 {
-	double* args = new double[node->_args.size()];
-	for(int i = 0; i < node->_args.size(); i++)
-	{
-		node->_args[i]->accept(this);
-		args[i] = pop();
-	}
+	CHECK_BUDGET();
+
+	// the arguments are passed to the handler right from the value stack
+	size_t base = _value_stack.size();
+	for(auto a : node->_args) evaluate(a, TYPE_FLOAT);
+
+	// don't run handlers on the NaNs of an aborted solve
+	if(_budget.status != STATUS_SUCCESS) { _value_stack.resize(base); push(NAN); return; }
+
+	_env->path = _path;
+	double value = call_action(node->_action, &node->_token, _env, _value_stack.data() + base);
+	_value_stack.resize(base);
+	push(value);
+	convert(TYPE_FLOAT, node->_type);
+}
+
+VISIT(RootNode)
+{
+	CHECK_BUDGET();
+	double lo = value(node->_lo);
+	double hi = value(node->_hi);
+	if(_budget.status != STATUS_SUCCESS) { push(NAN); return; }
+
+	// the search runs in a gradient solver, which has the slopes of f for Newton steps
+	if(!_slopes) _slopes = new GradientSolver();
+	_slopes->strategy = strategy;
+	_slopes->root_controls = root_controls;
+	_slopes->solve_root(_env, node->_symbol, lo, hi, call_path(_path, &node->_token), _budget);
+	push(_slopes->result);
+}
+
+VISIT(MapNode)
+{
+	CHECK_BUDGET();
+	double array = value(node->_array);
+	if(_budget.status != STATUS_SUCCESS) { push(NAN); return; }
+	BoundArray values = get_bound_array(&node->_token, _env, array);
 
-	push(node->_action->handler(&node->_token, _env, args));
+	// f is evaluated for a block of values at once in a batch solver
+	if(!_mapper) _mapper = new BatchSolver<double>();
+	_mapper->strategy = strategy;
+	_mapper->root_controls = root_controls;
+	double sum;
+	_mapper->map_sum(_env, node->_symbol, values, {}, _env->sample, call_path(_path, &node->_token), _budget, sum);
+	push(sum);
 }
 
 #undef VISIT
\ No newline at end of file
@@ -60,25 +60,24 @@ string tools::replacestr(string source, string oldstring, string newstring)
 string tools::fstr(string format, ...)
 {
     va_list args;
-    va_start(args, format.c_str());
+    va_start(args, format);
 
-    int smallSize = sizeof(char) * 1024;
-    char *smallBuffer = (char*)malloc(smallSize);
-
-    int size = vsnprintf(smallBuffer, smallSize, format.c_str(), args);
+    // try a buffer on the stack first
+    char smallBuffer[1024];
+    int size = vsnprintf(smallBuffer, sizeof(smallBuffer), format.c_str(), args);
 
     va_end(args);
 
-    if (size < sizeof smallBuffer) return string(smallBuffer);
+    if (size < 0) return string();
+    if (size < (int)sizeof(smallBuffer)) return string(smallBuffer, size);
 
-    int bigSize = sizeof(char) * (size + 1);
-    char *buffer = (char*)malloc(bigSize);
+    string buffer(size, '\0');
 
-    va_start(args, format.c_str());
-    vsnprintf(buffer, bigSize, format.c_str(), args);
+    va_start(args, format);
+    vsnprintf(&buffer[0], size + 1, format.c_str(), args);
     va_end(args);
 
-    return string(buffer);
+    return buffer;
 }
 
 // e.g. turns 'n' into an actual newline (returns -1 if invalid)
@@ -119,7 +118,13 @@ const char* tools::unescchr(char escchar)
         case '\'': return "\\\'";
         case '\"': return "\\\"";
 	case '\0': return "\\0";
-	default: return new char[2]{escchar, '\0'};
+	default:
+	{
+		static thread_local char buffer[2];
+		buffer[0] = escchar;
+		buffer[1] = '\0';
+		return buffer;
+	}
     }
 }
 
@@ -199,7 +204,9 @@ string tools::readf(string path)
     buffer[bytesRead] = '\0';
 
     fclose(file);
-    return buffer;
+    string contents(buffer, bytesRead);
+    free(buffer);
+    return contents;
 }
 
 // write string to file
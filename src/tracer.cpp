@@ -0,0 +1,144 @@
+#include "tracer.hpp"
+#include "tools.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <fstream>
+
+// ==================================================
+
+typedef struct
+{
+	uint tid;
+	const char* name;
+	uint64_t written; // total events ever recorded
+	tracer::Event events[TRACE_RING_SIZE];
+} RingBuffer;
+
+bool tracer::enabled = false;
+
+static string trace_path;
+static uint64_t trace_epoch = 0;
+
+static mutex registry_mutex;
+static vector<RingBuffer*> registry;
+static set<string> interned;
+
+static thread_local RingBuffer* local_buffer = nullptr;
+
+static RingBuffer* get_buffer()
+{
+	if(local_buffer) return local_buffer;
+
+	// first event on this thread, register a new ring
+	lock_guard<mutex> lock(registry_mutex);
+	local_buffer = new RingBuffer();
+	local_buffer->tid = registry.size();
+	local_buffer->name = nullptr;
+	local_buffer->written = 0;
+	registry.push_back(local_buffer);
+	return local_buffer;
+}
+
+static void record(tracer::Event event)
+{
+	RingBuffer* buf = get_buffer();
+	buf->events[buf->written++ % TRACE_RING_SIZE] = event;
+}
+
+static void write_at_exit()
+{
+	//
+	tracer::write();
+}
+
+// ==================================================
+
+void tracer::enable(string path)
+{
+	trace_path = path;
+	trace_epoch = 0;
+	trace_epoch = now();
+	enabled = true;
+
+	thread_name("main");
+	atexit(write_at_exit);
+}
+
+uint64_t tracer::now()
+{
+	auto t = chrono::steady_clock::now().time_since_epoch();
+	return chrono::duration_cast<chrono::nanoseconds>(t).count() - trace_epoch;
+}
+
+const char* tracer::intern(string name)
+{
+	lock_guard<mutex> lock(registry_mutex);
+	return interned.insert(name).first->c_str();
+}
+
+void tracer::span(const char* name, uint64_t start, uint64_t end)
+{
+	//
+	record(Event{name, 'X', start, end - start, 0});
+}
+
+void tracer::counter(const char* name, double value)
+{
+	//
+	record(Event{name, 'C', now(), 0, value});
+}
+
+void tracer::thread_name(const char* name)
+{
+	if(enabled) get_buffer()->name = name;
+}
+
+// dump all rings as trace-event json
+bool tracer::write()
+{
+	if(!enabled) return true;
+	enabled = false;
+
+	ofstream out(trace_path);
+	if(!out.is_open())
+	{
+		ERR("Could not write trace to \"" << trace_path << "\".");
+		return false;
+	}
+
+	lock_guard<mutex> lock(registry_mutex);
+	out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+
+	bool first = true;
+	#define SEP() { out << (first ? "" : ",\n"); first = false; }
+
+	for(auto buf : registry)
+	{
+		SEP();
+		out << tools::fstr("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+			"\"args\":{\"name\":\"%s\"}}", buf->tid, buf->name ? buf->name : "worker");
+
+		uint64_t count = buf->written < TRACE_RING_SIZE ? buf->written : TRACE_RING_SIZE;
+		for(uint64_t i = buf->written - count; i < buf->written; i++)
+		{
+			Event& e = buf->events[i % TRACE_RING_SIZE];
+			string name = tools::unescstr(e.name);
+			SEP();
+
+			if(e.phase == 'X') out << tools::fstr(
+				"{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				name.c_str(), buf->tid, e.ts / 1000.0, e.dur / 1000.0);
+
+			else out << tools::fstr(
+				"{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"value\":%g}}",
+				name.c_str(), buf->tid, e.ts / 1000.0, e.value);
+		}
+	}
+
+	#undef SEP
+	out << "\n]}" << endl;
+	out.close();
+	return true;
+}
@@ -1,6 +1,7 @@
 #include "visualizer.hpp"
 #include "parser.hpp"
 #include "tools.hpp"
+#include "tracer.hpp"
 
 #define ADD_NODE(name) (_stream << \
 	tools::fstr("\tnode%d [label=\"%s\"]\n", _nodecount, name), _nodecount++)
@@ -23,6 +24,9 @@ void ASTVisualizer::visualize(string path, Symbol* symbol)
 {
 	if(!symbol->body) return;
 
+	tracer::Scope trace_scope(nullptr, TRACE_SYMBOL_MIN_NS);
+	if(tracer::enabled) trace_scope.rename(tracer::intern("visualize " + symbol->get_ident()));
+
 	_path = path;
 
 	// generate name
@@ -46,6 +50,7 @@ void ASTVisualizer::finalize()
 	_stream << FOOTER << endl;
 
 	// write to file
+	TRACE_SCOPE("dot");
 	DEBUG_PRINT_MSG("Generating AST image...");
 	int status = system(tools::fstr("echo '%s' | dot -Tsvg > %s", _stream.str().c_str(), _path.c_str()).c_str());
 	if(status) cout << _stream.str() << endl;
@@ -82,6 +87,23 @@ VISIT(BinaryNode)
 		case TOKEN_MINUS: 			thisnode = ADD_NODE("-"); break;
 		case TOKEN_STAR:  			thisnode = ADD_NODE("*"); break;
 		case TOKEN_SLASH:			thisnode = ADD_NODE("/"); break;
+		case TOKEN_CARET:			thisnode = ADD_NODE("^"); break;
+		default: THROW_INTERNAL_ERROR("during AST visualization");
+	}
+
+	CONNECT_NODES(thisnode, _nodecount);
+	node->_left->accept(this);
+	CONNECT_NODES(thisnode, _nodecount);
+	node->_right->accept(this);
+}
+
+VISIT(LogicalNode)
+{
+	int thisnode = 0;
+	switch(node->_optype)
+	{
+		case TOKEN_AND:				thisnode = ADD_NODE("and"); break;
+		case TOKEN_OR:				thisnode = ADD_NODE("or"); break;
 		default: THROW_INTERNAL_ERROR("during AST visualization");
 	}
 
@@ -112,6 +134,28 @@ VISIT(GroupingNode)
 	node->_expr->accept(this);
 }
 
+VISIT(ConditionalNode)
+{
+	int thisnode = ADD_NODE("@if[]");
+
+	CONNECT_NODES(thisnode, _nodecount);
+	node->_cond->accept(this);
+	CONNECT_NODES_LABELED(thisnode, _nodecount, then);
+	node->_then->accept(this);
+	CONNECT_NODES_LABELED(thisnode, _nodecount, else);
+	node->_else->accept(this);
+}
+
+VISIT(PolynomialNode)
+{
+	string coefs;
+	for(auto c : node->_coefs) coefs += (coefs.empty() ? "" : ", ") + tools::fstr("%g", c);
+	int thisnode = ADD_NODE(("poly[" + coefs + "]").c_str());
+
+	CONNECT_NODES(thisnode, _nodecount);
+	node->_var->accept(this);
+}
+
 VISIT(NumberNode)
 {
 	ADD_NODE(tools::fstr("%g", node->_value).c_str());
@@ -146,6 +190,24 @@ VISIT(ActionNode)
 	}
 }
 
+VISIT(RootNode)
+{
+	int thisnode = ADD_NODE(("@root[" + node->_symbol->get_ident() + "]").c_str());
+
+	CONNECT_NODES_LABELED(thisnode, _nodecount, lo);
+	node->_lo->accept(this);
+	CONNECT_NODES_LABELED(thisnode, _nodecount, hi);
+	node->_hi->accept(this);
+}
+
+VISIT(MapNode)
+{
+	int thisnode = ADD_NODE(("@map[" + node->_symbol->get_ident() + "]").c_str());
+
+	CONNECT_NODES(thisnode, _nodecount);
+	node->_array->accept(this);
+}
+
 #undef ADD_NODE
 #undef CONNECT_NODES
 #undef VISIT
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "shm.hpp"
+
+#include <argp.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+
+// A stand-in writer of a shared-memory binding table, to try --bind-shm with.
+//
+//     make feed
+//     bin/solve-feed prices 4096 &
+//     bin/solve --bind-shm 0x1000=prices --serve file.slv
+//
+// Every line of stdin is one update of pairs of an index and a value, all of
+// which solves see at once. With --walk every value is set to the number of
+// the tick instead, as fast as it can or every --interval microseconds, so a
+// solve that sees different values for different indices saw a torn update.
+
+static char doc[] = "solve-feed -- writes the shared-memory binding table NAME of COUNT values.";
+static char args_doc[] = "NAME COUNT";
+
+struct arguments
+{
+	std::string name;
+	uint64_t count = 0;
+	uint64_t walk = 0;
+	uint64_t interval = 0;
+	bool keep = false;
+	int args = 0;
+};
+
+#define ARG_WALK 1
+#define ARG_INTERVAL 2
+#define ARG_KEEP 3
+
+static struct argp_option options[] =
+{
+	{"walk",		ARG_WALK,		"N",	0, "Write N ticks instead of reading updates from stdin."},
+	{"interval",	ARG_INTERVAL,	"US",	0, "Microseconds between the ticks of --walk (default 0)."},
+	{"keep",		ARG_KEEP,		0,		0, "Leave the table behind when done, instead of removing it."},
+
+	{0}
+};
+
+static error_t parse_opt(int key, char *arg, struct argp_state *state)
+{
+	struct arguments *arguments = (struct arguments*)state->input;
+
+	switch (key)
+	{
+	case ARG_WALK: arguments->walk = strtoull(arg, nullptr, 0); break;
+	case ARG_INTERVAL: arguments->interval = strtoull(arg, nullptr, 0); break;
+	case ARG_KEEP: arguments->keep = true; break;
+
+	case ARGP_KEY_ARG:
+		if(arguments->args == 0) arguments->name = arg[0] == '/' ? arg : std::string("/") + arg;
+		else if(arguments->args == 1) arguments->count = strtoull(arg, nullptr, 0);
+		else argp_usage(state);
+		arguments->args++;
+		break;
+	case ARGP_KEY_END:
+		if(arguments->args != 2 || !arguments->count) argp_usage(state);
+		break;
+	default: return ARGP_ERR_UNKNOWN;
+	}
+	return 0;
+}
+
+static struct argp argp = {options, parse_opt, args_doc, doc};
+
+// ==================================================
+
+// a new table of zeros, its magic is written last so that readers never see it half made
+static SharedTable* create(std::string name, uint64_t count)
+{
+	shm_unlink(name.c_str());
+	int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if(fd < 0) { perror("shm_open"); return nullptr; }
+
+	size_t bytes = shm::bytes(count);
+	if(ftruncate(fd, bytes)) { perror("ftruncate"); close(fd); return nullptr; }
+	void* mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(mapping == MAP_FAILED) { perror("mmap"); return nullptr; }
+
+	SharedTable* table = (SharedTable*)mapping;
+	table->count = count;
+	table->sequence.store(0);
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(table->magic, SHM_MAGIC, 8);
+	return table;
+}
+
+// applies the pairs of a line at once, false if it is malformed
+static bool update(SharedTable* table, const char* line)
+{
+	uint64_t indices[256];
+	double values[256];
+	size_t n = 0;
+
+	char* end;
+	for(;;)
+	{
+		while(isspace(*line)) line++;
+		if(!*line) break;
+		if(n == 256) return false;
+
+		indices[n] = strtoull(line, &end, 0);
+		if(end == line || indices[n] >= table->count) return false;
+		line = end;
+		values[n] = strtod(line, &end);
+		if(end == line) return false;
+		line = end;
+		n++;
+	}
+
+	shm::begin_write(table);
+	for(size_t i = 0; i < n; i++) shm::values(table)[indices[i]] = values[i];
+	shm::end_write(table);
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	struct arguments arguments;
+	argp_parse(&argp, argc, argv, 0, 0, &arguments);
+
+	SharedTable* table = create(arguments.name, arguments.count);
+	if(!table) return 1;
+
+	if(arguments.walk) for(uint64_t tick = 1; tick <= arguments.walk; tick++)
+	{
+		shm::begin_write(table);
+		for(uint64_t i = 0; i < arguments.count; i++) shm::values(table)[i] = tick;
+		shm::end_write(table);
+		if(arguments.interval) std::this_thread::sleep_for(std::chrono::microseconds(arguments.interval));
+	}
+	else
+	{
+		char line[4096];
+		while(fgets(line, sizeof(line), stdin))
+			if(!update(table, line)) fprintf(stderr, "solve-feed: invalid update '%s'\n", strtok(line, "\n"));
+	}
+
+	if(!arguments.keep) shm_unlink(arguments.name.c_str());
+	return 0;
+}
@@ -0,0 +1,148 @@
+#include "kv.hpp"
+
+#include <argp.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <vector>
+
+// A stand-in key-value service for --resolver, to try it with.
+//
+//     make kv
+//     bin/solve-kv /tmp/kv.sock values.txt &
+//     bin/solve --resolver /tmp/kv.sock file.slv
+//
+// The values are read from a file of "ADDR VALUE" lines, or with --identity
+// every address has itself as its value. --delay adds the latency of a remote
+// service to every request, --log prints the size of every request to stderr.
+
+static char doc[] = "solve-kv -- answers the requests of --resolver on the Unix socket SOCKET.";
+static char args_doc[] = "SOCKET [FILE]";
+
+struct arguments
+{
+	char *socket = nullptr;
+	char *file = nullptr;
+	bool identity = false;
+	uint64_t delay = 0;
+	bool log = false;
+};
+
+#define ARG_IDENTITY 1
+#define ARG_DELAY 2
+#define ARG_LOG 3
+
+static struct argp_option options[] =
+{
+	{"identity",	ARG_IDENTITY,	0,		0, "Answer every address with itself as its value."},
+	{"delay",		ARG_DELAY,		"US",	0, "Microseconds to wait before answering every request (default 0)."},
+	{"log",			ARG_LOG,		0,		0, "Print the number of addresses of every request to stderr."},
+
+	{0}
+};
+
+static error_t parse_opt(int key, char *arg, struct argp_state *state)
+{
+	struct arguments *arguments = (struct arguments*)state->input;
+
+	switch (key)
+	{
+	case ARG_IDENTITY: arguments->identity = true; break;
+	case ARG_DELAY: arguments->delay = strtoull(arg, nullptr, 0); break;
+	case ARG_LOG: arguments->log = true; break;
+
+	case ARGP_KEY_ARG:
+		if(!arguments->socket) arguments->socket = arg;
+		else if(!arguments->file) arguments->file = arg;
+		else argp_usage(state);
+		break;
+	case ARGP_KEY_END:
+		if(!arguments->socket || (!arguments->file && !arguments->identity)) argp_usage(state);
+		break;
+	default: return ARGP_ERR_UNKNOWN;
+	}
+	return 0;
+}
+
+static struct argp argp = {options, parse_opt, args_doc, doc};
+
+// ==================================================
+
+static struct arguments arguments;
+static std::map<uint32_t, double> values;
+
+static bool load(const char* path)
+{
+	FILE* file = fopen(path, "r");
+	if(!file) { perror(path); return false; }
+
+	char line[256];
+	while(fgets(line, sizeof(line), file))
+	{
+		char* end;
+		unsigned long long addr = strtoull(line, &end, 0);
+		if(end == line) continue;
+		while(*end == ' ' || *end == '\t' || *end == '-' || *end == '>') end++;
+		values[addr] = strtod(end, nullptr);
+	}
+	fclose(file);
+	return true;
+}
+
+// answers the requests of one client until it disconnects
+static void answer(int fd)
+{
+	std::vector<uint32_t> addrs;
+	std::vector<double> found_values;
+	std::vector<uint8_t> found;
+
+	uint32_t count;
+	while(kv::read_all(fd, &count, sizeof(count)) && count <= KV_MAX_COUNT)
+	{
+		addrs.resize(count);
+		if(!kv::read_all(fd, addrs.data(), count * sizeof(uint32_t))) break;
+		if(arguments.log) fprintf(stderr, "solve-kv: request of %u addresses\n", count);
+		if(arguments.delay) std::this_thread::sleep_for(std::chrono::microseconds(arguments.delay));
+
+		found_values.assign(count, 0);
+		found.assign(count, 0);
+		for(uint32_t i = 0; i < count; i++)
+		{
+			if(arguments.identity) { found_values[i] = addrs[i]; found[i] = 1; continue; }
+			auto it = values.find(addrs[i]);
+			if(it != values.end()) { found_values[i] = it->second; found[i] = 1; }
+		}
+
+		if(!kv::write_all(fd, found_values.data(), count * sizeof(double)) || !kv::write_all(fd, found.data(), count)) break;
+	}
+	close(fd);
+}
+
+int main(int argc, char **argv)
+{
+	argp_parse(&argp, argc, argv, 0, 0, &arguments);
+	if(arguments.file && !load(arguments.file)) return 1;
+
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if(strlen(arguments.socket) >= sizeof(address.sun_path)) { fprintf(stderr, "solve-kv: socket path too long\n"); return 1; }
+	strcpy(address.sun_path, arguments.socket);
+	unlink(arguments.socket);
+
+	int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(server < 0 || bind(server, (sockaddr*)&address, sizeof(address)) || listen(server, 64)) { perror("solve-kv"); return 1; }
+
+	// every client gets a thread of its own
+	for(;;)
+	{
+		int client = accept(server, nullptr, nullptr);
+		if(client < 0) { if(errno == EINTR) continue; perror("accept"); return 1; }
+		std::thread(answer, client).detach();
+	}
+}